@@ -16,6 +16,12 @@ typedef uint8_t enet_uint8;
 typedef unsigned char enet_uint8;
 typedef unsigned int  enet_uint32;
 
+#if defined(_WIN32)
+typedef uintptr_t ENetSocket;
+#else
+typedef int ENetSocket;
+#endif
+
 typedef struct _ENetAddress {
     enet_uint32 host;
     enet_uint16 port;
@@ -38,6 +44,15 @@ struct _ENetPacket {
     enet_uint32 flags;      /* optional, but harmless */
 };
 
+/* only the application data pointer and the RTT estimate are public, as in
+ * ENet. The RTT is smoothed from keepalive pings and reliable acks (RFC 6298)
+ * and stays 0 until the first sample. */
+struct _ENetPeer {
+    void *data;
+    enet_uint32 roundTripTime;         /* ms */
+    enet_uint32 roundTripTimeVariance; /* ms */
+};
+
 typedef struct _ENetPeer ENetPeer;
 typedef struct _ENetPacket ENetPacket;
 typedef struct _ENetHost ENetHost;
@@ -49,7 +64,14 @@ typedef struct _ENetEvent {
     enet_uint32 data;
 } ENetEvent;
 
+/* Reliable packets are retransmitted until acknowledged and delivered in
+ * order, unless also UNSEQUENCED; other packets go out once, untracked.
+ * Packets larger than a datagram are fragmented (up to about 74 KiB); an
+ * unreliable one is dropped whole if any fragment is lost, and a fragmented
+ * reliable one is always delivered in order. */
 #define ENET_PACKET_FLAG_RELIABLE 1
+#define ENET_PACKET_FLAG_UNSEQUENCED (1 << 1)
+#define ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT (1 << 3)
 
 int enet_initialize(void);
 void enet_deinitialize(void);
@@ -60,19 +82,129 @@ ENetHost *enet_host_create(const ENetAddress *address,
                            enet_uint32 incomingBandwidth,
                            enet_uint32 outgoingBandwidth);
 void enet_host_destroy(ENetHost *host);
-
+/* stub extension: a server host whose port is opened `shardCount` times with
+ * SO_REUSEPORT, each socket drained by its own receive thread. The kernel
+ * hashes every peer to one socket, and the threads queue what they read for
+ * enet_host_service, which still decodes and raises all events on the
+ * calling thread. enet_host_socket then returns an eventfd that becomes
+ * readable when datagrams are queued. Linux only; elsewhere, or for a
+ * client host, this is enet_host_create. */
+ENetHost *enet_host_create_sharded(const ENetAddress *address,
+                                   size_t peerCount,
+                                   size_t channelLimit,
+                                   enet_uint32 incomingBandwidth,
+                                   enet_uint32 outgoingBandwidth,
+                                   size_t shardCount);
+
+/* Also keeps connections alive: connected peers are pinged every 500 ms, and
+ * a peer silent for 32 retransmission timeouts (5 to 30 s) is dropped with a
+ * DISCONNECT event, as is a connection attempt nobody answers. */
 int enet_host_service(ENetHost *host, ENetEvent *event, enet_uint32 timeout_ms);
+/* sends may be queued until the next enet_host_service call; this sends
+ * them now, as in ENet */
+void enet_host_flush(ENetHost *host);
+/* stub extension: the host's UDP socket, for callers that wait on it
+ * themselves (ENet exposes this as host->socket) */
+ENetSocket enet_host_socket(const ENetHost *host);
 
 ENetPeer *enet_host_connect(ENetHost *host, const ENetAddress *address, size_t channelCount, enet_uint32 data);
 void enet_peer_disconnect(ENetPeer *peer, enet_uint32 data);
 void enet_peer_reset(ENetPeer *peer);
 
+/* takes ownership of the packet on success, as in ENet */
 int enet_peer_send(ENetPeer *peer, enet_uint8 channelID, ENetPacket *packet);
+/* stub extension: sends `header` followed by the packet data as one datagram
+ * without copying either, so one packet can be fanned out to many peers with
+ * a small per-peer header. The caller keeps ownership of the packet; reliable
+ * packets are copied since they may have to be sent again. */
+int enet_peer_send_with_header(ENetPeer *peer,
+                               enet_uint8 channelID,
+                               const void *header,
+                               size_t headerLength,
+                               ENetPacket *packet);
 void enet_host_broadcast(ENetHost *host, enet_uint8 channelID, ENetPacket *packet);
 
+/* stub extension: traces every datagram the host sends or receives to `path`.
+ * Records are appended to an in-memory buffer that is written out in large
+ * blocks (and at least once a second), so capturing costs a memcpy per
+ * datagram rather than a syscall.
+ *
+ * File: "SPTRACE1", then records of
+ *   [direction u8: 0 received, 1 sent][delta_us u32][peer u32][length u16][datagram]
+ * little endian; delta_us is the time since the previous record and peer is
+ * the stub peer id of the remote end (0 when unknown). Datagrams include the
+ * stub's leading message type byte. Sent datagrams are recorded before any
+ * network simulation (enet_host_simulate) delays or drops them. */
+int enet_host_capture_start(ENetHost *host, const char *path);
+void enet_host_capture_stop(ENetHost *host);
+
+/* stub extension: a host without a socket. Sends are discarded and incoming
+ * datagrams are supplied with enet_host_inject, e.g. from a capture trace;
+ * `peer` identifies the remote end the same way capture records do. */
+ENetHost *enet_host_create_offline(size_t peerCount);
+int enet_host_inject(ENetHost *host, enet_uint32 peer, const void *data, size_t dataLength);
+
+/* stub extension: network condition simulator. Every datagram the host sends
+ * is delayed by `latencyMs` plus jitter drawn from `jitterDistribution`
+ * (uniform over ±jitterMs, normal with standard deviation jitterMs, or a
+ * heavy-tailed Pareto tail with mean jitterMs), and may be lost, duplicated
+ * or held back by `reorderMs` (20 ms when 0) so that later datagrams
+ * overtake it.
+ * Probabilities are in [0, 1]; losses come in bursts of `lossBurst`
+ * datagrams on average (Gilbert-Elliott), 1 or less meaning independent.
+ * Jitter alone never reorders: a datagram does not leave before one sent
+ * earlier, so a delay spike also holds back those that follow it. Draws come from a generator seeded with `seed`, so a run can be
+ * repeated. Delayed datagrams go out from enet_host_service and
+ * enet_host_flush at 1 ms resolution; those still queued when the host is
+ * destroyed are lost. Shape both ends to simulate a round trip. */
+typedef enum _ENetSimulatorDistribution {
+    ENET_SIMULATOR_UNIFORM = 0,
+    ENET_SIMULATOR_NORMAL,
+    ENET_SIMULATOR_PARETO
+} ENetSimulatorDistribution;
+
+typedef struct _ENetSimulatorSettings {
+    enet_uint32 seed;
+    float latencyMs;
+    float jitterMs;
+    ENetSimulatorDistribution jitterDistribution;
+    float loss;
+    float lossBurst;
+    float duplicate;
+    float reorder;
+    float reorderMs;
+} ENetSimulatorSettings;
+
+typedef struct _ENetSimulatorStats {
+    uint64_t datagrams; /* handed to the simulator */
+    uint64_t dropped;   /* lost, or refused by a full delay queue */
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t queued;    /* waiting for their delay to elapse */
+} ENetSimulatorStats;
+
+/* NULL turns the simulation off and sends whatever is queued right away.
+ * Fails for offline hosts, which send nothing. */
+int enet_host_simulate(ENetHost *host, const ENetSimulatorSettings *settings);
+void enet_host_simulator_stats(const ENetHost *host, ENetSimulatorStats *stats);
+
+/* Packets come from per-host, size-classed freelists: enet_packet_create
+ * draws from the pool of the host last serviced on the calling thread and
+ * enet_packet_destroy hands the packet back to the pool it came from. As in
+ * ENet, a host and the packets it hands out belong to one thread at a time. */
 ENetPacket *enet_packet_create(const void *data, size_t dataLength, enet_uint32 flags);
 void enet_packet_destroy(ENetPacket *packet);
 
+/* stub extension: packet pool counters. A miss is an allocation the pool
+ * could not serve from a freelist; `pooled` packets sit free in the pool. */
+typedef struct _ENetPacketPoolStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t outstanding;
+    uint64_t pooled;
+} ENetPacketPoolStats;
+void enet_host_packet_pool_stats(const ENetHost *host, ENetPacketPoolStats *stats);
+
 enet_uint32 enet_time_get(void);
 
 #ifdef __cplusplus
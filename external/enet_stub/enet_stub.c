@@ -1,3 +1,17 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#    define _GNU_SOURCE /* recvmmsg / sendmmsg */
+#endif
+
+/* receive threads sharing one port through SO_REUSEPORT, which only Linux
+ * balances across sockets for UDP */
+#ifndef ENET_STUB_RECEIVE_SHARDS
+#    if defined(__linux__)
+#        define ENET_STUB_RECEIVE_SHARDS 1
+#    else
+#        define ENET_STUB_RECEIVE_SHARDS 0
+#    endif
+#endif
+
 #include "enet.h"
 
 #if defined(_WIN32)
@@ -8,6 +22,7 @@
 #else
 #    include <sys/types.h>
 #    include <sys/socket.h>
+#    include <sys/uio.h>
 #    include <arpa/inet.h>
 #    include <netinet/in.h>
 #    include <netdb.h>
@@ -15,12 +30,19 @@
 #    include <fcntl.h>
 #    include <sys/time.h>
 #    include <errno.h>
+#    if ENET_STUB_RECEIVE_SHARDS
+#        include <poll.h>
+#        include <pthread.h>
+#        include <stdatomic.h>
+#        include <sys/eventfd.h>
+#    endif
 typedef int SOCKET;
 #    define INVALID_SOCKET (-1)
 #    define SOCKET_ERROR (-1)
 #    define closesocket close
 #endif
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -29,31 +51,334 @@ typedef int SOCKET;
 #define ENET_STUB_MSG_HELLO_ACK 0x02
 #define ENET_STUB_MSG_PAYLOAD 0x03
 #define ENET_STUB_MSG_DISCONNECT 0x04
+/* [type][sequence u16][ack][flags u8][data] */
+#define ENET_STUB_MSG_RELIABLE 0x05
+/* [type][ack], sent when no other traffic carried a pending ack */
+#define ENET_STUB_MSG_ACK 0x06
+/* [type][ack][data]: an unreliable payload with an ack piggybacked */
+#define ENET_STUB_MSG_PAYLOAD_ACK 0x07
+/* [type][fragment header][data]: one piece of an unreliable packet too large
+ * for a single datagram */
+#define ENET_STUB_MSG_FRAGMENT 0x08
+/* [type][timestamp u32]: keepalive, answered right away by a PONG carrying
+ * the same timestamp, which gives the sender an RTT sample */
+#define ENET_STUB_MSG_PING 0x09
+#define ENET_STUB_MSG_PONG 0x0A
+
+/* ack: [cumulative u16][selective u32]; everything up to and including
+ * `cumulative` arrived, and bit i of `selective` marks cumulative + 2 + i */
+#define ENET_STUB_ACK_SIZE 6
+#define ENET_STUB_RELIABLE_HEADER (1 + 2 + ENET_STUB_ACK_SIZE + 1)
+#define ENET_STUB_RELIABLE_ORDERED 0x01
+/* the reliable payload is [fragment header][data] */
+#define ENET_STUB_RELIABLE_FRAGMENT 0x02
+
+/* fragment header: [group u16][index u8][count u8] */
+#define ENET_STUB_FRAGMENT_HEADER 4
+/* every fragment but the last carries exactly this much, which is what fits
+ * behind the reliable header */
+#define ENET_STUB_FRAGMENT_SIZE (ENET_STUB_MAX_PACKET - ENET_STUB_RELIABLE_HEADER - ENET_STUB_FRAGMENT_HEADER)
+#define ENET_STUB_MAX_FRAGMENTS 64
+/* unreliable groups reassembled at once per peer; a new group evicts the
+ * oldest when they are all taken */
+#define ENET_STUB_REASSEMBLY_SLOTS 4
+/* an unreliable group still incomplete after this long lost a fragment */
+#define ENET_STUB_REASSEMBLY_TIMEOUT_MS 500u
+/* internal: marks queued reliable packets that hold one fragment */
+#define ENET_STUB_PACKET_FLAG_FRAGMENT (1u << 31)
+
+/* reliable packets in flight per peer; the selective ack covers the window */
+#define ENET_STUB_WINDOW 32
+/* reliable packets waiting for a window slot, per peer */
+#define ENET_STUB_SEND_QUEUE 256
+/* ordered packets released together by one arrival */
+#define ENET_STUB_EVENT_QUEUE 128
+#define ENET_STUB_INITIAL_RTO_MS 200.0f
+#define ENET_STUB_MIN_RTO_MS 50.0f
+#define ENET_STUB_MAX_RTO_MS 2000.0f
+#define ENET_STUB_ACK_DELAY_MS 5u
+/* later sequences acknowledged before an unacked packet is resent early */
+#define ENET_STUB_FAST_RETRANSMIT 3
+#define ENET_STUB_HELLO_RETRY_MS 250u
+#define ENET_STUB_PING_INTERVAL_MS 500u
+/* a peer silent for 32 retransmission timeouts is gone, within these bounds */
+#define ENET_STUB_TIMEOUT_LIMIT 32.0f
+#define ENET_STUB_TIMEOUT_MIN_MS 5000.0f
+#define ENET_STUB_TIMEOUT_MAX_MS 30000.0f
 
 #ifndef ENET_STUB_MAX_PACKET
 #    define ENET_STUB_MAX_PACKET 1200
 #endif
 
+#define ENET_STUB_CAPTURE_MAGIC "SPTRACE1"
+#define ENET_STUB_CAPTURE_RECEIVED 0
+#define ENET_STUB_CAPTURE_SENT 1
+#define ENET_STUB_CAPTURE_RECORD_HEADER 11
+#ifndef ENET_STUB_CAPTURE_BUFFER
+#    define ENET_STUB_CAPTURE_BUFFER (256 * 1024)
+#endif
+/* a process that is killed loses at most this much of its trace */
+#define ENET_STUB_CAPTURE_FLUSH_US 1000000ULL
+#define ENET_STUB_INBOX_CAPACITY 64
+
+/* Linux moves datagrams in batches: recvmmsg drains the socket into a ring
+ * that events are then served from, and sends are queued and handed to one
+ * sendmmsg per service call or enet_host_flush. */
+#if !defined(ENET_STUB_BATCHED_IO)
+#    if defined(__linux__)
+#        define ENET_STUB_BATCHED_IO 1
+#    else
+#        define ENET_STUB_BATCHED_IO 0
+#    endif
+#endif
+#define ENET_STUB_IO_BATCH 64
+
+#if ENET_STUB_RECEIVE_SHARDS && !ENET_STUB_BATCHED_IO
+#    error "receive shards need the batched socket I/O (recvmmsg)"
+#endif
+#define ENET_STUB_MAX_SHARDS 16
+/* datagrams a receive thread may queue ahead of the host; a power of two */
+#define ENET_STUB_SHARD_QUEUE 512
+
+/* packet pool size classes: small messages, one datagram, then multiples of
+ * it up to the largest fragmented packet */
+#define ENET_STUB_POOL_CLASSES 6
+
+/* network simulator: a hashed timing wheel of 1 ms ticks. A datagram due
+ * more than a turn ahead waits in its slot for the turn it is due in. */
+#define ENET_STUB_SIM_WHEEL_SLOTS 1024 /* a power of two */
+#define ENET_STUB_SIM_QUEUE 8192
+#define ENET_STUB_SIM_MAX_DELAY_MS 10000.0f
+#define ENET_STUB_SIM_REORDER_MS 20.0f
+#define ENET_STUB_SIM_PARETO_SHAPE 3.0f
+
+#if defined(_MSC_VER)
+#    define ENET_STUB_THREAD_LOCAL __declspec(thread)
+#else
+#    define ENET_STUB_THREAD_LOCAL _Thread_local
+#endif
+
 
 struct _ENetHost;
 
+typedef struct ENetStubOutgoing {
+    ENetPacket *packet; /* NULL once acknowledged */
+    enet_uint16 sequence;
+    enet_uint8 flags;
+    enet_uint32 transmissions;
+    enet_uint32 sent_ms;
+    float timeout_ms;
+} ENetStubOutgoing;
+
+typedef struct ENetStubIncoming {
+    int received;
+    enet_uint8 flags;
+    ENetPacket *packet; /* ordered packets waiting for earlier sequences */
+} ENetStubIncoming;
+
+typedef struct ENetStubReassembly {
+    ENetPacket *packet; /* NULL when the slot is free */
+    enet_uint16 group;
+    enet_uint8 count;
+    enet_uint8 received_count;
+    uint64_t received;
+    size_t last_length;
+    enet_uint32 started_ms;
+} ENetStubReassembly;
+
 typedef struct ENetPeerImpl {
+    struct _ENetPeer base; /* must stay first: ENetPeer* aliases ENetPeerImpl* */
     int in_use;
+    int indexed; /* listed in the host's address index */
     int connected;
     struct sockaddr_in address;
     enet_uint32 id;
     struct _ENetHost *host;
+    /* reliable channel, sending side */
+    enet_uint16 next_sequence;
+    enet_uint16 send_base;
+    ENetStubOutgoing in_flight[ENET_STUB_WINDOW];
+    ENetPacket **queued;
+    size_t queued_head;
+    size_t queued_count;
+    /* reliable channel, receiving side */
+    enet_uint16 next_expected;
+    ENetStubIncoming incoming[ENET_STUB_WINDOW];
+    int ack_pending;
+    enet_uint32 ack_pending_since;
+    /* fragmentation; reliable fragments are delivered in order, so one
+     * group at a time is enough for them */
+    enet_uint16 next_fragment_group;
+    ENetStubReassembly reassembly[ENET_STUB_REASSEMBLY_SLOTS];
+    ENetStubReassembly reliable_reassembly;
+    /* retransmission timeout from smoothed RTT samples */
+    int has_rtt;
+    float srtt_ms;
+    float rttvar_ms;
+    float rto_ms;
+    /* keepalive */
+    enet_uint32 last_receive_ms;
+    enet_uint32 last_ping_ms;
+    enet_uint32 hello_sent_ms;
 } ENetPeerImpl;
 
+typedef struct ENetStubCapture {
+    FILE *file;
+    enet_uint8 *buffer;
+    size_t size;
+    unsigned long long last_us;
+    unsigned long long flushed_us;
+} ENetStubCapture;
+
+typedef struct ENetStubDatagram {
+    enet_uint32 peer;
+    size_t length;
+    enet_uint8 data[ENET_STUB_MAX_PACKET];
+} ENetStubDatagram;
+
+#if ENET_STUB_BATCHED_IO
+/* datagrams for one recvmmsg / sendmmsg call; entry i always points at
+ * addresses[i] and data[i] */
+typedef struct ENetStubIoBatch {
+    struct mmsghdr messages[ENET_STUB_IO_BATCH];
+    struct iovec buffers[ENET_STUB_IO_BATCH];
+    struct sockaddr_in addresses[ENET_STUB_IO_BATCH];
+    enet_uint8 data[ENET_STUB_IO_BATCH][ENET_STUB_MAX_PACKET];
+    size_t head;
+    size_t count;
+} ENetStubIoBatch;
+#endif
+
+#if ENET_STUB_RECEIVE_SHARDS
+typedef struct ENetStubShardSlot {
+    struct sockaddr_in from;
+    size_t length;
+    enet_uint8 data[ENET_STUB_MAX_PACKET];
+} ENetStubShardSlot;
+
+/* One SO_REUSEPORT socket and the thread that drains it. The datagrams it
+ * read wait in a single-producer single-consumer ring: the receive thread
+ * only advances `tail`, the host's thread only advances `head`. Decoding
+ * stays on the host's thread, which owns all peer state. */
+typedef struct ENetStubShard {
+    struct _ENetHost *host;
+    SOCKET socket;
+    pthread_t thread;
+    int thread_started;
+    atomic_size_t head;
+    char head_padding[64 - sizeof(atomic_size_t)];
+    atomic_size_t tail;
+    char tail_padding[64 - sizeof(atomic_size_t)];
+    struct mmsghdr messages[ENET_STUB_IO_BATCH];
+    struct iovec buffers[ENET_STUB_IO_BATCH];
+    ENetStubShardSlot slots[ENET_STUB_SHARD_QUEUE];
+} ENetStubShard;
+#endif
+
+/* a datagram the network simulator is holding back */
+typedef struct ENetStubDelayed {
+    struct ENetStubDelayed *next;
+    enet_uint32 due_ms;
+    struct sockaddr_in address;
+    size_t length;
+    enet_uint8 data[ENET_STUB_MAX_PACKET];
+} ENetStubDelayed;
+
+typedef struct ENetStubWheelSlot {
+    ENetStubDelayed *head;
+    ENetStubDelayed *tail;
+} ENetStubWheelSlot;
+
+typedef struct ENetStubSimulator {
+    ENetSimulatorSettings settings;
+    ENetSimulatorStats stats;
+    uint64_t random;
+    /* Gilbert-Elliott loss: every datagram sent during a burst is lost */
+    int in_loss_burst;
+    float burst_enter;
+    float burst_exit;
+    enet_uint32 wheel_ms;    /* last tick released */
+    enet_uint32 last_due_ms; /* keeps jittered datagrams in order */
+    ENetStubWheelSlot wheel[ENET_STUB_SIM_WHEEL_SLOTS];
+    ENetStubDelayed *free_entries;
+} ENetStubSimulator;
+
+typedef struct ENetStubPacketPool ENetStubPacketPool;
+
+/* A packet and its payload are one allocation: [block][payload]. */
+typedef struct ENetStubPacketBlock {
+    ENetStubPacketPool *pool; /* NULL for packets allocated outside any pool */
+    struct ENetStubPacketBlock *next;
+    int size_class;
+    ENetPacket packet;
+} ENetStubPacketBlock;
+
+/* Per-host freelists. A host only ever runs on one thread at a time, so the
+ * pool needs no locking. It outlives its host while packets it handed out
+ * are still alive. */
+struct ENetStubPacketPool {
+    ENetStubPacketBlock *free_blocks[ENET_STUB_POOL_CLASSES];
+    size_t free_counts[ENET_STUB_POOL_CLASSES];
+    int orphaned;
+    ENetPacketPoolStats stats;
+};
+
+static const size_t g_enet_stub_pool_class_sizes[ENET_STUB_POOL_CLASSES] = {
+    64,
+    256,
+    ENET_STUB_MAX_PACKET,
+    4 * ENET_STUB_MAX_PACKET,
+    16 * ENET_STUB_MAX_PACKET,
+    ENET_STUB_MAX_FRAGMENTS * ENET_STUB_FRAGMENT_SIZE,
+};
+
+/* free blocks kept per class; the rest go back to the heap */
+static const size_t g_enet_stub_pool_class_limits[ENET_STUB_POOL_CLASSES] = {512, 512, 512, 64, 16, 4};
+
+/* pool of the host last serviced on this thread; enet_packet_create has no
+ * host to go by */
+static ENET_STUB_THREAD_LOCAL ENetStubPacketPool *g_enet_stub_current_pool = NULL;
+
 struct _ENetHost {
     SOCKET socket;
     int is_server;
     ENetPeerImpl *peers;
     size_t peer_count;
+    /* open-addressing (linear probing) index of in-use peers by address;
+     * entries are peer index + 1, 0 marks an empty slot */
+    enet_uint32 *peer_table;
+    size_t peer_table_mask;
+    /* indices of unused peers, popped from the end */
+    enet_uint32 *free_peers;
+    size_t free_peer_count;
     ENetAddress address;
     enet_uint32 next_peer_id;
     struct sockaddr_in server_addr;
     ENetPeerImpl *server_peer;
+    ENetStubCapture *capture;
+    ENetStubSimulator *simulator; /* NULL unless enet_host_simulate is on */
+    /* offline hosts: injected datagrams waiting for enet_host_service */
+    int offline;
+    ENetStubDatagram *inbox;
+    size_t inbox_head;
+    size_t inbox_count;
+#if ENET_STUB_BATCHED_IO
+    ENetStubIoBatch *receive_batch;
+    ENetStubIoBatch *send_batch;
+#endif
+#if ENET_STUB_RECEIVE_SHARDS
+    /* sharded servers: shards[0] reads `socket`, which also does all sends */
+    ENetStubShard *shards[ENET_STUB_MAX_SHARDS];
+    size_t shard_count;
+    size_t next_shard;
+    int wake_fd; /* eventfd the receive threads signal when a ring fills up from empty */
+    int stop_fd; /* eventfd that tells the receive threads to exit */
+#endif
+    /* receive events not yet handed out by enet_host_service */
+    ENetEvent events[ENET_STUB_EVENT_QUEUE];
+    size_t event_head;
+    size_t event_count;
+    ENetStubPacketPool *pool;
 };
 
 static int g_enet_init_refcount = 0;
@@ -107,248 +432,1552 @@ void enet_deinitialize(void)
     enet_stub_cleanup();
 }
 
-static void enet_stub_address_to_sockaddr(const ENetAddress *address, struct sockaddr_in *out)
+static void enet_stub_pool_release(ENetStubPacketPool *pool)
 {
-    memset(out, 0, sizeof(*out));
-    out->sin_family = AF_INET;
-    if (address) {
-        out->sin_port = htons(address->port);
-        if (address->host == 0) {
-            out->sin_addr.s_addr = htonl(INADDR_ANY);
-        } else {
-            out->sin_addr.s_addr = htonl(address->host);
+    for (int size_class = 0; size_class < ENET_STUB_POOL_CLASSES; ++size_class) {
+        while (pool->free_blocks[size_class]) {
+            ENetStubPacketBlock *block = pool->free_blocks[size_class];
+            pool->free_blocks[size_class] = block->next;
+            free(block);
         }
-    } else {
-        out->sin_port = 0;
-        out->sin_addr.s_addr = htonl(INADDR_ANY);
+        pool->free_counts[size_class] = 0;
     }
 }
 
-static ENetPeerImpl *enet_stub_find_peer(ENetHost *host, const struct sockaddr_in *addr)
+/* Detaches the pool from its host; it is freed once its last packet is. */
+static void enet_stub_pool_orphan(ENetStubPacketPool *pool)
 {
-    if (!host || !addr) {
-        return NULL;
+    if (!pool) {
+        return;
     }
-    for (size_t i = 0; i < host->peer_count; ++i) {
-        ENetPeerImpl *peer = &host->peers[i];
-        if (!peer->in_use) {
-            continue;
-        }
-        if (peer->address.sin_addr.s_addr == addr->sin_addr.s_addr &&
-            peer->address.sin_port == addr->sin_port) {
-            return peer;
-        }
+    if (g_enet_stub_current_pool == pool) {
+        g_enet_stub_current_pool = NULL;
+    }
+    enet_stub_pool_release(pool);
+    pool->orphaned = 1;
+    if (pool->stats.outstanding == 0) {
+        free(pool);
     }
-    return NULL;
 }
 
-static ENetPeerImpl *enet_stub_alloc_peer(ENetHost *host)
+static ENetPacket *enet_stub_packet_alloc(ENetStubPacketPool *pool, const void *data, size_t length, enet_uint32 flags)
 {
-    if (!host) {
-        return NULL;
+    int size_class = -1;
+    for (int i = 0; i < ENET_STUB_POOL_CLASSES; ++i) {
+        if (length <= g_enet_stub_pool_class_sizes[i]) {
+            size_class = i;
+            break;
+        }
     }
-    for (size_t i = 0; i < host->peer_count; ++i) {
-        ENetPeerImpl *peer = &host->peers[i];
-        if (!peer->in_use) {
-            memset(peer, 0, sizeof(*peer));
-            peer->in_use = 1;
-            peer->connected = 0;
-            peer->id = ++host->next_peer_id;
-            peer->host = host;
-            return peer;
+
+    ENetStubPacketBlock *block = NULL;
+    if (pool && size_class >= 0 && pool->free_blocks[size_class]) {
+        block = pool->free_blocks[size_class];
+        pool->free_blocks[size_class] = block->next;
+        --pool->free_counts[size_class];
+        pool->stats.hits += 1;
+    } else {
+        size_t capacity = (size_class >= 0) ? g_enet_stub_pool_class_sizes[size_class] : length;
+        block = (ENetStubPacketBlock *)malloc(sizeof(ENetStubPacketBlock) + capacity);
+        if (!block) {
+            return NULL;
+        }
+        block->size_class = size_class;
+        if (pool) {
+            pool->stats.misses += 1;
         }
     }
-    return NULL;
+
+    block->pool = (size_class >= 0) ? pool : NULL;
+    block->next = NULL;
+    if (block->pool) {
+        block->pool->stats.outstanding += 1;
+    }
+
+    ENetPacket *packet = &block->packet;
+    packet->data = (enet_uint8 *)(block + 1);
+    packet->dataLength = length;
+    packet->flags = flags;
+    if (data && length > 0) {
+        memcpy(packet->data, data, length);
+    }
+    return packet;
 }
 
-static int enet_stub_set_nonblocking(SOCKET sock)
+static unsigned long long enet_stub_time_us(void)
 {
 #if defined(_WIN32)
-    u_long nb = 1;
-    return ioctlsocket(sock, FIONBIO, &nb);
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (unsigned long long)(counter.QuadPart / freq.QuadPart) * 1000000ULL +
+           (unsigned long long)((counter.QuadPart % freq.QuadPart) * 1000000LL / freq.QuadPart);
 #else
-    int flags = fcntl(sock, F_GETFL, 0);
-    if (flags < 0) {
-        return -1;
-    }
-    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
-        return -1;
-    }
-    return 0;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (unsigned long long)tv.tv_sec * 1000000ULL + (unsigned long long)tv.tv_usec;
 #endif
 }
 
-ENetHost *enet_host_create(const ENetAddress *address,
-                           size_t peerCount,
-                           size_t channelLimit,
-                           enet_uint32 incomingBandwidth,
-                           enet_uint32 outgoingBandwidth)
+static enet_uint32 enet_stub_time_ms(void)
 {
-    (void)channelLimit;
-    (void)incomingBandwidth;
-    (void)outgoingBandwidth;
+    return (enet_uint32)(enet_stub_time_us() / 1000ULL);
+}
 
-    if (peerCount == 0) {
-        peerCount = 1;
+static void enet_stub_capture_flush(ENetStubCapture *capture)
+{
+    if (capture->size > 0) {
+        fwrite(capture->buffer, 1, capture->size, capture->file);
+        capture->size = 0;
     }
+    capture->flushed_us = capture->last_us;
+}
 
-    ENetHost *host = (ENetHost *)calloc(1, sizeof(ENetHost));
-    if (!host) {
-        return NULL;
+/* Appends one record; the datagram may come in up to three pieces so sends
+ * can be traced without first gathering them. */
+static void enet_stub_capture_record(ENetHost *host,
+                                     enet_uint8 direction,
+                                     enet_uint32 peer,
+                                     const enet_uint8 *a,
+                                     size_t a_length,
+                                     const enet_uint8 *b,
+                                     size_t b_length,
+                                     const enet_uint8 *c,
+                                     size_t c_length)
+{
+    ENetStubCapture *capture = host->capture;
+    if (!capture) {
+        return;
     }
 
-    if (enet_stub_startup() != 0) {
-        free(host);
-        return NULL;
+    size_t length = a_length + b_length + c_length;
+    if (length > 0xFFFF) {
+        return;
     }
-
-    host->peers = (ENetPeerImpl *)calloc(peerCount, sizeof(ENetPeerImpl));
-    if (!host->peers) {
-        free(host);
-        enet_stub_cleanup();
-        return NULL;
+    if (capture->size + ENET_STUB_CAPTURE_RECORD_HEADER + length > ENET_STUB_CAPTURE_BUFFER) {
+        enet_stub_capture_flush(capture);
     }
-    host->peer_count = peerCount;
 
-    host->socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (host->socket == INVALID_SOCKET) {
-        free(host->peers);
-        free(host);
-        enet_stub_cleanup();
-        return NULL;
+    unsigned long long now = enet_stub_time_us();
+    unsigned long long delta = now > capture->last_us ? now - capture->last_us : 0;
+    if (delta > 0xFFFFFFFFULL) {
+        delta = 0xFFFFFFFFULL;
     }
+    capture->last_us = now;
 
-#if defined(_WIN32)
-    int opt = 1;
-    setsockopt(host->socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
-#else
-    int opt = 1;
-    setsockopt(host->socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-#endif
+    enet_uint8 *out = capture->buffer + capture->size;
+    out[0] = direction;
+    for (int i = 0; i < 4; ++i) {
+        out[1 + i] = (enet_uint8)((delta >> (8 * i)) & 0xFF);
+        out[5 + i] = (enet_uint8)((peer >> (8 * i)) & 0xFF);
+    }
+    out[9] = (enet_uint8)(length & 0xFF);
+    out[10] = (enet_uint8)((length >> 8) & 0xFF);
+    out += ENET_STUB_CAPTURE_RECORD_HEADER;
+    if (a_length > 0) {
+        memcpy(out, a, a_length);
+        out += a_length;
+    }
+    if (b_length > 0) {
+        memcpy(out, b, b_length);
+        out += b_length;
+    }
+    if (c_length > 0) {
+        memcpy(out, c, c_length);
+    }
+    capture->size += ENET_STUB_CAPTURE_RECORD_HEADER + length;
 
-    if (address) {
-        struct sockaddr_in bind_addr;
-        enet_stub_address_to_sockaddr(address, &bind_addr);
-        if (bind(host->socket, (const struct sockaddr *)&bind_addr, sizeof(bind_addr)) != 0) {
-            closesocket(host->socket);
-            free(host->peers);
-            free(host);
-            enet_stub_cleanup();
-            return NULL;
-        }
-        host->is_server = 1;
-        host->address = *address;
-    } else {
-        host->is_server = 0;
-        host->address.host = 0;
-        host->address.port = 0;
+    if (now - capture->flushed_us >= ENET_STUB_CAPTURE_FLUSH_US) {
+        enet_stub_capture_flush(capture);
     }
+}
 
-    if (enet_stub_set_nonblocking(host->socket) != 0) {
-        closesocket(host->socket);
-        free(host->peers);
-        free(host);
-        enet_stub_cleanup();
-        return NULL;
+int enet_host_capture_start(ENetHost *host, const char *path)
+{
+    if (!host || !path) {
+        return -1;
     }
+    enet_host_capture_stop(host);
 
-    host->next_peer_id = 1;
+    ENetStubCapture *capture = (ENetStubCapture *)calloc(1, sizeof(ENetStubCapture));
+    if (!capture) {
+        return -1;
+    }
+    capture->buffer = (enet_uint8 *)malloc(ENET_STUB_CAPTURE_BUFFER);
+    capture->file = fopen(path, "wb");
+    if (!capture->buffer || !capture->file) {
+        if (capture->file) {
+            fclose(capture->file);
+        }
+        free(capture->buffer);
+        free(capture);
+        return -1;
+    }
+    /* we already write whole blocks; stdio buffering would only add a copy */
+    setvbuf(capture->file, NULL, _IONBF, 0);
 
-    return host;
+    memcpy(capture->buffer, ENET_STUB_CAPTURE_MAGIC, 8);
+    capture->size = 8;
+    capture->last_us = enet_stub_time_us();
+    capture->flushed_us = capture->last_us;
+    host->capture = capture;
+    return 0;
 }
 
-void enet_host_destroy(ENetHost *host)
+void enet_host_capture_stop(ENetHost *host)
 {
-    if (!host) {
+    if (!host || !host->capture) {
         return;
     }
+    enet_stub_capture_flush(host->capture);
+    fclose(host->capture->file);
+    free(host->capture->buffer);
+    free(host->capture);
+    host->capture = NULL;
+}
 
-    if (host->socket != INVALID_SOCKET) {
-        closesocket(host->socket);
-    }
-    free(host->peers);
-    free(host);
-    enet_stub_cleanup();
+/* Offline hosts key peers by a made-up address derived from the trace's peer id. */
+static void enet_stub_offline_address(enet_uint32 peer, struct sockaddr_in *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    out->sin_addr.s_addr = htonl(0x0A000000u | (peer & 0x00FFFFFFu));
+    out->sin_port = htons((unsigned short)(1u + (peer >> 24)));
 }
 
-static void enet_stub_send_control(ENetHost *host, ENetPeerImpl *peer, enet_uint8 type)
+static void enet_stub_address_to_sockaddr(const ENetAddress *address, struct sockaddr_in *out)
 {
-    if (!host || !peer) {
-        return;
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    if (address) {
+        out->sin_port = htons(address->port);
+        if (address->host == 0) {
+            out->sin_addr.s_addr = htonl(INADDR_ANY);
+        } else {
+            out->sin_addr.s_addr = htonl(address->host);
+        }
+    } else {
+        out->sin_port = 0;
+        out->sin_addr.s_addr = htonl(INADDR_ANY);
     }
-    enet_uint8 buffer[1] = {type};
-    sendto(host->socket,
-           (const char *)buffer,
-           1,
-           0,
-           (const struct sockaddr *)&peer->address,
-           sizeof(peer->address));
 }
 
-ENetPeer *enet_host_connect(ENetHost *host, const ENetAddress *address, size_t channelCount, enet_uint32 data)
+static size_t enet_stub_peer_hash(const ENetHost *host, const struct sockaddr_in *addr)
 {
-    (void)channelCount;
-    (void)data;
-    if (!host || host->is_server) {
-        return NULL;
-    }
+    uint64_t key = ((uint64_t)addr->sin_addr.s_addr << 16) | addr->sin_port;
+    return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & host->peer_table_mask;
+}
 
-    ENetPeerImpl *peer = enet_stub_alloc_peer(host);
-    if (!peer) {
-        return NULL;
+static int enet_stub_init_peers(ENetHost *host, size_t peerCount)
+{
+    size_t table_size = 16;
+    while (table_size < peerCount * 2) {
+        table_size *= 2;
     }
 
-    struct sockaddr_in addr;
-    enet_stub_address_to_sockaddr(address, &addr);
-    peer->address = addr;
-    peer->connected = 0;
-    host->server_addr = addr;
-    host->server_peer = peer;
-
-    enet_stub_send_control(host, peer, ENET_STUB_MSG_HELLO);
+    host->peers = (ENetPeerImpl *)calloc(peerCount, sizeof(ENetPeerImpl));
+    host->peer_table = (enet_uint32 *)calloc(table_size, sizeof(enet_uint32));
+    host->free_peers = (enet_uint32 *)malloc(sizeof(enet_uint32) * peerCount);
+    if (!host->peers || !host->peer_table || !host->free_peers) {
+        free(host->peers);
+        free(host->peer_table);
+        free(host->free_peers);
+        return -1;
+    }
+    host->peer_count = peerCount;
+    host->peer_table_mask = table_size - 1;
+    /* lowest index on top, so peers are handed out in order */
+    for (size_t i = 0; i < peerCount; ++i) {
+        host->free_peers[i] = (enet_uint32)(peerCount - 1 - i);
+    }
+    host->free_peer_count = peerCount;
+    return 0;
+}
 
-    return (ENetPeer *)peer;
+static void enet_stub_free_peers(ENetHost *host)
+{
+    free(host->peers);
+    free(host->peer_table);
+    free(host->free_peers);
 }
 
-void enet_peer_disconnect(ENetPeer *peer_ptr, enet_uint32 data)
+static ENetPeerImpl *enet_stub_find_peer(ENetHost *host, const struct sockaddr_in *addr)
 {
-    (void)data;
-    ENetPeerImpl *peer = (ENetPeerImpl *)peer_ptr;
-    if (!peer || !peer->in_use) {
-        return;
+    if (!host || !addr) {
+        return NULL;
+    }
+    for (size_t slot = enet_stub_peer_hash(host, addr);; slot = (slot + 1) & host->peer_table_mask) {
+        enet_uint32 entry = host->peer_table[slot];
+        if (entry == 0) {
+            return NULL;
+        }
+        ENetPeerImpl *peer = &host->peers[entry - 1];
+        if (peer->address.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            peer->address.sin_port == addr->sin_port) {
+            return peer;
+        }
     }
-    enet_stub_send_control(peer->host, peer, ENET_STUB_MSG_DISCONNECT);
-    peer->connected = 0;
 }
 
-void enet_peer_reset(ENetPeer *peer_ptr)
+/* Makes the peer findable by its address; call once the address is set. */
+static void enet_stub_index_peer(ENetHost *host, ENetPeerImpl *peer)
 {
-    ENetPeerImpl *peer = (ENetPeerImpl *)peer_ptr;
-    if (!peer) {
-        return;
+    size_t slot = enet_stub_peer_hash(host, &peer->address);
+    while (host->peer_table[slot] != 0) {
+        slot = (slot + 1) & host->peer_table_mask;
     }
-    peer->in_use = 0;
-    peer->connected = 0;
+    host->peer_table[slot] = (enet_uint32)(peer - host->peers) + 1;
+    peer->indexed = 1;
 }
 
-static ENetPacket *enet_stub_packet_from_buffer(const enet_uint8 *buffer, size_t length)
+/* Removes the peer from the address index, shifting later entries of the
+ * probe run back so lookups never need tombstones. */
+static void enet_stub_unindex_peer(ENetHost *host, ENetPeerImpl *peer)
 {
-    if (length == 0) {
+    if (!peer->indexed) {
+        return;
+    }
+    peer->indexed = 0;
+
+    enet_uint32 entry = (enet_uint32)(peer - host->peers) + 1;
+    size_t hole = enet_stub_peer_hash(host, &peer->address);
+    while (host->peer_table[hole] != entry) {
+        hole = (hole + 1) & host->peer_table_mask;
+    }
+    host->peer_table[hole] = 0;
+
+    for (size_t next = (hole + 1) & host->peer_table_mask; host->peer_table[next] != 0;
+         next = (next + 1) & host->peer_table_mask) {
+        size_t home = enet_stub_peer_hash(host, &host->peers[host->peer_table[next] - 1].address);
+        /* the entry may move into the hole unless its home lies between them */
+        if (((next - home) & host->peer_table_mask) >= ((next - hole) & host->peer_table_mask)) {
+            host->peer_table[hole] = host->peer_table[next];
+            host->peer_table[next] = 0;
+            hole = next;
+        }
+    }
+}
+
+/* Frees every packet the peer's reliable channel still holds. */
+static void enet_stub_release_channel(ENetPeerImpl *peer)
+{
+    for (int i = 0; i < ENET_STUB_WINDOW; ++i) {
+        enet_packet_destroy(peer->in_flight[i].packet);
+        peer->in_flight[i].packet = NULL;
+        enet_packet_destroy(peer->incoming[i].packet);
+        peer->incoming[i].packet = NULL;
+        peer->incoming[i].received = 0;
+    }
+    for (size_t i = 0; i < peer->queued_count; ++i) {
+        enet_packet_destroy(peer->queued[(peer->queued_head + i) % ENET_STUB_SEND_QUEUE]);
+    }
+    free(peer->queued);
+    peer->queued = NULL;
+    peer->queued_head = 0;
+    peer->queued_count = 0;
+    for (int i = 0; i < ENET_STUB_REASSEMBLY_SLOTS; ++i) {
+        enet_packet_destroy(peer->reassembly[i].packet);
+        peer->reassembly[i].packet = NULL;
+    }
+    enet_packet_destroy(peer->reliable_reassembly.packet);
+    peer->reliable_reassembly.packet = NULL;
+}
+
+static ENetPeerImpl *enet_stub_alloc_peer(ENetHost *host)
+{
+    if (!host || host->free_peer_count == 0) {
+        return NULL;
+    }
+    ENetPeerImpl *peer = &host->peers[host->free_peers[--host->free_peer_count]];
+    enet_stub_release_channel(peer);
+    memset(peer, 0, sizeof(*peer));
+    peer->in_use = 1;
+    peer->connected = 0;
+    peer->id = ++host->next_peer_id;
+    peer->host = host;
+    peer->rto_ms = ENET_STUB_INITIAL_RTO_MS;
+    peer->last_receive_ms = enet_stub_time_ms();
+    peer->last_ping_ms = peer->last_receive_ms;
+    return peer;
+}
+
+/* Returns an in-use peer to the free list. */
+static void enet_stub_free_peer(ENetHost *host, ENetPeerImpl *peer)
+{
+    if (!peer->in_use) {
+        return;
+    }
+    enet_stub_unindex_peer(host, peer);
+    enet_stub_release_channel(peer);
+    peer->in_use = 0;
+    peer->connected = 0;
+    host->free_peers[host->free_peer_count++] = (enet_uint32)(peer - host->peers);
+}
+
+#if ENET_STUB_BATCHED_IO
+static ENetStubIoBatch *enet_stub_create_batch(void)
+{
+    ENetStubIoBatch *batch = (ENetStubIoBatch *)calloc(1, sizeof(ENetStubIoBatch));
+    if (!batch) {
+        return NULL;
+    }
+    for (size_t i = 0; i < ENET_STUB_IO_BATCH; ++i) {
+        batch->buffers[i].iov_base = batch->data[i];
+        batch->buffers[i].iov_len = sizeof(batch->data[i]);
+        batch->messages[i].msg_hdr.msg_name = &batch->addresses[i];
+        batch->messages[i].msg_hdr.msg_namelen = sizeof(batch->addresses[i]);
+        batch->messages[i].msg_hdr.msg_iov = &batch->buffers[i];
+        batch->messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    return batch;
+}
+
+/* Refills the receive ring; returns the number of datagrams read. */
+static int enet_stub_receive_batch(ENetHost *host)
+{
+    ENetStubIoBatch *batch = host->receive_batch;
+    for (size_t i = 0; i < ENET_STUB_IO_BATCH; ++i) {
+        batch->buffers[i].iov_len = sizeof(batch->data[i]);
+        batch->messages[i].msg_hdr.msg_namelen = sizeof(batch->addresses[i]);
+    }
+    int received = recvmmsg(host->socket, batch->messages, ENET_STUB_IO_BATCH, MSG_DONTWAIT, NULL);
+    batch->head = 0;
+    batch->count = (received > 0) ? (size_t)received : 0;
+    return received;
+}
+
+static void enet_stub_flush_sends(ENetHost *host)
+{
+    ENetStubIoBatch *batch = host->send_batch;
+    if (!batch || batch->count == 0) {
+        return;
+    }
+
+    size_t sent = 0;
+    while (sent < batch->count) {
+        int result = sendmmsg(host->socket, batch->messages + sent, (unsigned int)(batch->count - sent), 0);
+        if (result < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                /* dropped, as a full socket buffer would anyway */
+                break;
+            }
+            /* skip the datagram that failed and keep going */
+            result = 1;
+        }
+        sent += (size_t)result;
+    }
+    batch->count = 0;
+}
+#else
+static void enet_stub_flush_sends(ENetHost *host)
+{
+    (void)host;
+}
+#endif
+
+/* Sends one assembled datagram, through the send batch when there is one. */
+static void enet_stub_send_raw(ENetHost *host, const struct sockaddr_in *address, const enet_uint8 *data, size_t length)
+{
+#if ENET_STUB_BATCHED_IO
+    ENetStubIoBatch *batch = host->send_batch;
+    if (batch->count == ENET_STUB_IO_BATCH) {
+        enet_stub_flush_sends(host);
+    }
+    size_t slot = batch->count++;
+    memcpy(batch->data[slot], data, length);
+    batch->buffers[slot].iov_len = length;
+    batch->addresses[slot] = *address;
+    batch->messages[slot].msg_hdr.msg_namelen = sizeof(*address);
+#else
+    sendto(host->socket, (const char *)data, (int)length, 0, (const struct sockaddr *)address, (int)sizeof(*address));
+#endif
+}
+
+/* xorshift64*, uniform in [0, 1) */
+static float enet_stub_sim_random(ENetStubSimulator *sim)
+{
+    uint64_t x = sim->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sim->random = x;
+    return (float)((x * 0x2545F4914F6CDD1DULL) >> 40) * (1.0f / 16777216.0f);
+}
+
+static float enet_stub_sim_delay(ENetStubSimulator *sim)
+{
+    const ENetSimulatorSettings *settings = &sim->settings;
+    float delay = settings->latencyMs;
+    if (settings->jitterMs > 0.0f) {
+        switch (settings->jitterDistribution) {
+        case ENET_SIMULATOR_NORMAL: {
+            /* Box-Muller */
+            float u = 1.0f - enet_stub_sim_random(sim);
+            float v = enet_stub_sim_random(sim);
+            delay += settings->jitterMs * sqrtf(-2.0f * logf(u)) * cosf(6.28318531f * v);
+            break;
+        }
+        case ENET_SIMULATOR_PARETO: {
+            /* Pareto shifted to start at 0 (Lomax), scaled to a mean of jitterMs */
+            float u = 1.0f - enet_stub_sim_random(sim);
+            float scale = settings->jitterMs * (ENET_STUB_SIM_PARETO_SHAPE - 1.0f);
+            delay += scale * (powf(u, -1.0f / ENET_STUB_SIM_PARETO_SHAPE) - 1.0f);
+            break;
+        }
+        default:
+            delay += settings->jitterMs * (2.0f * enet_stub_sim_random(sim) - 1.0f);
+            break;
+        }
+    }
+    if (delay < 0.0f) {
+        return 0.0f;
+    }
+    return (delay > ENET_STUB_SIM_MAX_DELAY_MS) ? ENET_STUB_SIM_MAX_DELAY_MS : delay;
+}
+
+/* Adds an entry to the wheel slot of `due_ms`, or returns NULL when the
+ * queue is full. */
+static ENetStubDelayed *enet_stub_sim_queue(ENetStubSimulator *sim, enet_uint32 due_ms)
+{
+    if (sim->stats.queued >= ENET_STUB_SIM_QUEUE) {
+        return NULL;
+    }
+    ENetStubDelayed *entry = sim->free_entries;
+    if (entry) {
+        sim->free_entries = entry->next;
+    } else {
+        entry = (ENetStubDelayed *)malloc(sizeof(ENetStubDelayed));
+        if (!entry) {
+            return NULL;
+        }
+    }
+
+    /* ticks up to wheel_ms have been released already */
+    if ((int32_t)(due_ms - sim->wheel_ms) <= 0) {
+        due_ms = sim->wheel_ms + 1;
+    }
+    entry->due_ms = due_ms;
+    entry->next = NULL;
+    ENetStubWheelSlot *slot = &sim->wheel[due_ms & (ENET_STUB_SIM_WHEEL_SLOTS - 1)];
+    if (slot->tail) {
+        slot->tail->next = entry;
+    } else {
+        slot->head = entry;
+    }
+    slot->tail = entry;
+    ++sim->stats.queued;
+    return entry;
+}
+
+/* Decides the fate of an outgoing datagram and queues its copies, if any. */
+static void enet_stub_sim_send(ENetHost *host,
+                               const struct sockaddr_in *address,
+                               const enet_uint8 *prefix,
+                               size_t prefix_length,
+                               const enet_uint8 *header,
+                               size_t header_length,
+                               const enet_uint8 *data,
+                               size_t data_length)
+{
+    ENetStubSimulator *sim = host->simulator;
+    const ENetSimulatorSettings *settings = &sim->settings;
+    ++sim->stats.datagrams;
+
+    int lost = 0;
+    if (sim->burst_exit > 0.0f) {
+        float u = enet_stub_sim_random(sim);
+        if (sim->in_loss_burst) {
+            sim->in_loss_burst = (u >= sim->burst_exit);
+        } else {
+            sim->in_loss_burst = (u < sim->burst_enter);
+        }
+        lost = sim->in_loss_burst;
+    } else if (settings->loss > 0.0f) {
+        lost = (enet_stub_sim_random(sim) < settings->loss);
+    }
+    if (lost) {
+        ++sim->stats.dropped;
+        return;
+    }
+
+    int copies = 1;
+    if (settings->duplicate > 0.0f && enet_stub_sim_random(sim) < settings->duplicate) {
+        copies = 2;
+        ++sim->stats.duplicated;
+    }
+
+    enet_uint32 now = enet_stub_time_ms();
+    for (int copy = 0; copy < copies; ++copy) {
+        enet_uint32 due_ms = now + (enet_uint32)(enet_stub_sim_delay(sim) + 0.5f);
+        if ((int32_t)(sim->last_due_ms - due_ms) > 0) {
+            due_ms = sim->last_due_ms;
+        }
+        if (settings->reorder > 0.0f && enet_stub_sim_random(sim) < settings->reorder) {
+            /* held back behind what is sent after it */
+            due_ms += (enet_uint32)(settings->reorderMs + 0.5f);
+            ++sim->stats.reordered;
+        } else {
+            sim->last_due_ms = due_ms;
+        }
+
+        ENetStubDelayed *entry = enet_stub_sim_queue(sim, due_ms);
+        if (!entry) {
+            ++sim->stats.dropped;
+            continue;
+        }
+        entry->address = *address;
+        entry->length = prefix_length + header_length + data_length;
+        memcpy(entry->data, prefix, prefix_length);
+        if (header_length > 0) {
+            memcpy(entry->data + prefix_length, header, header_length);
+        }
+        if (data_length > 0) {
+            memcpy(entry->data + prefix_length + header_length, data, data_length);
+        }
+    }
+}
+
+/* Sends the delayed datagrams that are due, or all of them. Each tick since
+ * the last call visits one slot, so the cost is the elapsed milliseconds
+ * plus the datagrams in those slots, however many are queued. */
+static void enet_stub_sim_release(ENetHost *host, int all)
+{
+    ENetStubSimulator *sim = host->simulator;
+    if (!sim) {
+        return;
+    }
+
+    enet_uint32 now = enet_stub_time_ms();
+    enet_uint32 ticks = all ? ENET_STUB_SIM_WHEEL_SLOTS : now - sim->wheel_ms;
+    if (ticks > ENET_STUB_SIM_WHEEL_SLOTS) {
+        ticks = ENET_STUB_SIM_WHEEL_SLOTS;
+    }
+    for (enet_uint32 tick = 1; tick <= ticks && sim->stats.queued > 0; ++tick) {
+        ENetStubWheelSlot *slot = &sim->wheel[(sim->wheel_ms + tick) & (ENET_STUB_SIM_WHEEL_SLOTS - 1)];
+        ENetStubDelayed *previous = NULL;
+        ENetStubDelayed *entry = slot->head;
+        while (entry) {
+            ENetStubDelayed *next = entry->next;
+            if (!all && (int32_t)(entry->due_ms - now) > 0) {
+                /* due in a later turn */
+                previous = entry;
+                entry = next;
+                continue;
+            }
+            if (previous) {
+                previous->next = next;
+            } else {
+                slot->head = next;
+            }
+            if (slot->tail == entry) {
+                slot->tail = previous;
+            }
+            enet_stub_send_raw(host, &entry->address, entry->data, entry->length);
+            entry->next = sim->free_entries;
+            sim->free_entries = entry;
+            --sim->stats.queued;
+            entry = next;
+        }
+    }
+    sim->wheel_ms = now;
+}
+
+static void enet_stub_sim_free(ENetStubSimulator *sim)
+{
+    if (!sim) {
+        return;
+    }
+    for (size_t i = 0; i < ENET_STUB_SIM_WHEEL_SLOTS; ++i) {
+        while (sim->wheel[i].head) {
+            ENetStubDelayed *next = sim->wheel[i].head->next;
+            free(sim->wheel[i].head);
+            sim->wheel[i].head = next;
+        }
+    }
+    while (sim->free_entries) {
+        ENetStubDelayed *next = sim->free_entries->next;
+        free(sim->free_entries);
+        sim->free_entries = next;
+    }
+    free(sim);
+}
+
+static int enet_stub_set_nonblocking(SOCKET sock)
+{
+#if defined(_WIN32)
+    u_long nb = 1;
+    return ioctlsocket(sock, FIONBIO, &nb);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+/* Opens a non-blocking UDP socket, bound to `address` when there is one. */
+static SOCKET enet_stub_open_socket(const ENetAddress *address, int reuse_port)
+{
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    if (address) {
+        /* only for the bound port: an auto-bound client socket with
+         * SO_REUSEADDR can be handed an ephemeral port another client
+         * already uses, and the server would see the two as one peer */
+#if defined(_WIN32)
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
+#else
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+#endif
+#if ENET_STUB_RECEIVE_SHARDS
+        if (reuse_port && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
+            closesocket(sock);
+            return INVALID_SOCKET;
+        }
+#else
+        (void)reuse_port;
+#endif
+        struct sockaddr_in bind_addr;
+        enet_stub_address_to_sockaddr(address, &bind_addr);
+        if (bind(sock, (const struct sockaddr *)&bind_addr, sizeof(bind_addr)) != 0) {
+            closesocket(sock);
+            return INVALID_SOCKET;
+        }
+    }
+
+    if (enet_stub_set_nonblocking(sock) != 0) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+#if ENET_STUB_RECEIVE_SHARDS
+static void *enet_stub_shard_thread(void *param)
+{
+    ENetStubShard *shard = (ENetStubShard *)param;
+    struct pollfd fds[2];
+    fds[0].fd = shard->socket;
+    fds[0].events = POLLIN;
+    fds[1].fd = shard->host->stop_fd;
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        size_t tail = atomic_load_explicit(&shard->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&shard->head, memory_order_acquire);
+        size_t space = ENET_STUB_SHARD_QUEUE - (tail - head);
+        if (space == 0) {
+            /* the host is behind; leave the rest in the socket buffer */
+            if (poll(&fds[1], 1, 1) > 0) {
+                break;
+            }
+            continue;
+        }
+
+        unsigned int count = (unsigned int)(space < ENET_STUB_IO_BATCH ? space : ENET_STUB_IO_BATCH);
+        for (unsigned int i = 0; i < count; ++i) {
+            ENetStubShardSlot *slot = &shard->slots[(tail + i) & (ENET_STUB_SHARD_QUEUE - 1)];
+            shard->buffers[i].iov_base = slot->data;
+            shard->buffers[i].iov_len = sizeof(slot->data);
+            shard->messages[i].msg_hdr.msg_name = &slot->from;
+            shard->messages[i].msg_hdr.msg_namelen = sizeof(slot->from);
+            shard->messages[i].msg_hdr.msg_iov = &shard->buffers[i];
+            shard->messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = recvmmsg(shard->socket, shard->messages, count, MSG_DONTWAIT, NULL);
+        if (received <= 0) {
+            if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                /* e.g. ECONNREFUSED left by an ICMP error; already cleared */
+                continue;
+            }
+            if (poll(fds, 2, -1) > 0 && (fds[1].revents & POLLIN)) {
+                break;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < received; ++i) {
+            shard->slots[(tail + (size_t)i) & (ENET_STUB_SHARD_QUEUE - 1)].length = shard->messages[i].msg_len;
+        }
+        atomic_store(&shard->tail, tail + (size_t)received);
+        /* wake the host only if it may have found the ring empty */
+        if (atomic_load(&shard->head) == tail) {
+            uint64_t one = 1;
+            ssize_t written = write(shard->host->wake_fd, &one, sizeof(one));
+            (void)written;
+        }
+    }
+    return NULL;
+}
+
+static void enet_stub_stop_shards(ENetHost *host)
+{
+    if (host->stop_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(host->stop_fd, &one, sizeof(one));
+        (void)written;
+    }
+    for (size_t i = 0; i < host->shard_count; ++i) {
+        ENetStubShard *shard = host->shards[i];
+        if (shard->thread_started) {
+            pthread_join(shard->thread, NULL);
+        }
+        if (i > 0 && shard->socket != INVALID_SOCKET) {
+            closesocket(shard->socket);
+        }
+        free(shard);
+        host->shards[i] = NULL;
+    }
+    host->shard_count = 0;
+    if (host->wake_fd >= 0) {
+        close(host->wake_fd);
+    }
+    if (host->stop_fd >= 0) {
+        close(host->stop_fd);
+    }
+    host->wake_fd = -1;
+    host->stop_fd = -1;
+}
+
+/* Opens the other sockets on the host's port and starts one receive thread
+ * per socket, the host's own included. */
+static int enet_stub_start_shards(ENetHost *host, size_t shard_count)
+{
+    host->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    host->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (host->wake_fd < 0 || host->stop_fd < 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < shard_count; ++i) {
+        ENetStubShard *shard = (ENetStubShard *)calloc(1, sizeof(ENetStubShard));
+        if (!shard) {
+            return -1;
+        }
+        shard->host = host;
+        atomic_init(&shard->head, 0);
+        atomic_init(&shard->tail, 0);
+        host->shards[host->shard_count++] = shard;
+        shard->socket = (i == 0) ? host->socket : enet_stub_open_socket(&host->address, 1);
+        if (shard->socket == INVALID_SOCKET) {
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < host->shard_count; ++i) {
+        ENetStubShard *shard = host->shards[i];
+        if (pthread_create(&shard->thread, NULL, enet_stub_shard_thread, shard) != 0) {
+            return -1;
+        }
+        shard->thread_started = 1;
+    }
+    return 0;
+}
+
+/* The next queued datagram, taken round robin across the shards; NULL when
+ * every ring is empty. Hand the shard back to enet_stub_shard_release once
+ * the datagram has been handled. */
+static ENetStubShard *enet_stub_shard_peek(ENetHost *host, struct sockaddr_in *from, const enet_uint8 **buffer, int *length)
+{
+    for (size_t n = 0; n < host->shard_count; ++n) {
+        ENetStubShard *shard = host->shards[host->next_shard];
+        host->next_shard = (host->next_shard + 1) % host->shard_count;
+
+        size_t head = atomic_load_explicit(&shard->head, memory_order_relaxed);
+        if (atomic_load(&shard->tail) != head) {
+            const ENetStubShardSlot *slot = &shard->slots[head & (ENET_STUB_SHARD_QUEUE - 1)];
+            *from = slot->from;
+            *buffer = slot->data;
+            *length = (int)slot->length;
+            return shard;
+        }
+    }
+    return NULL;
+}
+
+static void enet_stub_shard_release(ENetStubShard *shard)
+{
+    atomic_store(&shard->head, atomic_load_explicit(&shard->head, memory_order_relaxed) + 1);
+}
+
+/* Clears the wake-up signal once the rings are found empty, so a caller
+ * waiting on enet_host_socket sleeps until more datagrams are queued. */
+static void enet_stub_shard_clear_wake(ENetHost *host)
+{
+    uint64_t value;
+    ssize_t result = read(host->wake_fd, &value, sizeof(value));
+    (void)result;
+}
+#endif
+
+static ENetHost *enet_stub_create_host(const ENetAddress *address, size_t peerCount, size_t shardCount)
+{
+    if (peerCount == 0) {
+        peerCount = 1;
+    }
+
+    ENetHost *host = (ENetHost *)calloc(1, sizeof(ENetHost));
+    if (!host) {
+        return NULL;
+    }
+
+    if (enet_stub_startup() != 0) {
+        free(host);
+        return NULL;
+    }
+
+    if (enet_stub_init_peers(host, peerCount) != 0) {
+        free(host);
+        enet_stub_cleanup();
+        return NULL;
+    }
+    host->pool = (ENetStubPacketPool *)calloc(1, sizeof(ENetStubPacketPool));
+    if (!host->pool) {
+        enet_stub_free_peers(host);
+        free(host);
+        enet_stub_cleanup();
+        return NULL;
+    }
+
+    host->socket = enet_stub_open_socket(address, shardCount > 1);
+    if (host->socket == INVALID_SOCKET) {
+        enet_stub_free_peers(host);
+        free(host->pool);
+        free(host);
+        enet_stub_cleanup();
+        return NULL;
+    }
+
+    if (address) {
+        host->is_server = 1;
+        host->address = *address;
+    } else {
+        host->is_server = 0;
+        host->address.host = 0;
+        host->address.port = 0;
+    }
+
+#if ENET_STUB_BATCHED_IO
+    host->receive_batch = enet_stub_create_batch();
+    host->send_batch = enet_stub_create_batch();
+    if (!host->receive_batch || !host->send_batch) {
+        free(host->receive_batch);
+        free(host->send_batch);
+        closesocket(host->socket);
+        enet_stub_free_peers(host);
+        free(host->pool);
+        free(host);
+        enet_stub_cleanup();
+        return NULL;
+    }
+#endif
+
+    host->next_peer_id = 1;
+
+#if ENET_STUB_RECEIVE_SHARDS
+    host->wake_fd = -1;
+    host->stop_fd = -1;
+    if (shardCount > 1 && enet_stub_start_shards(host, shardCount) != 0) {
+        enet_host_destroy(host);
+        return NULL;
+    }
+#endif
+
+    return host;
+}
+
+ENetHost *enet_host_create(const ENetAddress *address,
+                           size_t peerCount,
+                           size_t channelLimit,
+                           enet_uint32 incomingBandwidth,
+                           enet_uint32 outgoingBandwidth)
+{
+    (void)channelLimit;
+    (void)incomingBandwidth;
+    (void)outgoingBandwidth;
+    return enet_stub_create_host(address, peerCount, 1);
+}
+
+ENetHost *enet_host_create_sharded(const ENetAddress *address,
+                                   size_t peerCount,
+                                   size_t channelLimit,
+                                   enet_uint32 incomingBandwidth,
+                                   enet_uint32 outgoingBandwidth,
+                                   size_t shardCount)
+{
+    (void)channelLimit;
+    (void)incomingBandwidth;
+    (void)outgoingBandwidth;
+#if ENET_STUB_RECEIVE_SHARDS
+    if (!address) {
+        shardCount = 1;
+    }
+    if (shardCount > ENET_STUB_MAX_SHARDS) {
+        shardCount = ENET_STUB_MAX_SHARDS;
+    }
+#else
+    shardCount = 1;
+#endif
+    return enet_stub_create_host(address, peerCount, shardCount);
+}
+
+ENetHost *enet_host_create_offline(size_t peerCount)
+{
+    if (peerCount == 0) {
+        peerCount = 1;
+    }
+
+    ENetHost *host = (ENetHost *)calloc(1, sizeof(ENetHost));
+    if (!host) {
         return NULL;
     }
-    ENetPacket *packet = (ENetPacket *)calloc(1, sizeof(ENetPacket));
-    if (!packet) {
+
+    if (enet_stub_startup() != 0) {
+        free(host);
+        return NULL;
+    }
+
+    if (enet_stub_init_peers(host, peerCount) != 0) {
+        free(host);
+        enet_stub_cleanup();
         return NULL;
     }
-    packet->data = (enet_uint8 *)malloc(length);
-    if (!packet->data) {
-        free(packet);
+    host->inbox = (ENetStubDatagram *)malloc(sizeof(ENetStubDatagram) * ENET_STUB_INBOX_CAPACITY);
+    host->pool = (ENetStubPacketPool *)calloc(1, sizeof(ENetStubPacketPool));
+    if (!host->inbox || !host->pool) {
+        enet_stub_free_peers(host);
+        free(host->inbox);
+        free(host->pool);
+        free(host);
+        enet_stub_cleanup();
         return NULL;
     }
-    memcpy(packet->data, buffer, length);
-    packet->dataLength = length;
-    packet->flags = 0;
-    return packet;
+    host->socket = INVALID_SOCKET;
+    host->is_server = 1;
+    host->offline = 1;
+    host->next_peer_id = 1;
+#if ENET_STUB_RECEIVE_SHARDS
+    host->wake_fd = -1;
+    host->stop_fd = -1;
+#endif
+    return host;
+}
+
+int enet_host_inject(ENetHost *host, enet_uint32 peer, const void *data, size_t dataLength)
+{
+    if (!host || !host->offline || !data || dataLength == 0 || dataLength > ENET_STUB_MAX_PACKET) {
+        return -1;
+    }
+    if (host->inbox_count == ENET_STUB_INBOX_CAPACITY) {
+        return -1;
+    }
+
+    ENetStubDatagram *slot = &host->inbox[(host->inbox_head + host->inbox_count) % ENET_STUB_INBOX_CAPACITY];
+    slot->peer = peer;
+    slot->length = dataLength;
+    memcpy(slot->data, data, dataLength);
+    ++host->inbox_count;
+    return 0;
+}
+
+void enet_host_destroy(ENetHost *host)
+{
+    if (!host) {
+        return;
+    }
+
+    enet_host_flush(host);
+    enet_stub_sim_free(host->simulator);
+    enet_host_capture_stop(host);
+#if ENET_STUB_RECEIVE_SHARDS
+    enet_stub_stop_shards(host);
+#endif
+    if (host->socket != INVALID_SOCKET) {
+        closesocket(host->socket);
+    }
+#if ENET_STUB_BATCHED_IO
+    free(host->receive_batch);
+    free(host->send_batch);
+#endif
+    for (size_t i = 0; i < host->peer_count; ++i) {
+        enet_stub_release_channel(&host->peers[i]);
+    }
+    while (host->event_count > 0) {
+        enet_packet_destroy(host->events[host->event_head].packet);
+        host->event_head = (host->event_head + 1) % ENET_STUB_EVENT_QUEUE;
+        --host->event_count;
+    }
+    enet_stub_pool_orphan(host->pool);
+    free(host->inbox);
+    enet_stub_free_peers(host);
+    free(host);
+    enet_stub_cleanup();
+}
+
+static void enet_stub_write_u16(enet_uint8 *out, enet_uint16 value)
+{
+    out[0] = (enet_uint8)(value & 0xFF);
+    out[1] = (enet_uint8)((value >> 8) & 0xFF);
+}
+
+static enet_uint16 enet_stub_read_u16(const enet_uint8 *in)
+{
+    return (enet_uint16)(in[0] | ((enet_uint16)in[1] << 8));
+}
+
+/* Writes the peer's current ack and clears the pending flag, since whatever
+ * datagram carries it acknowledges everything received so far. */
+static void enet_stub_write_ack(ENetPeerImpl *peer, enet_uint8 *out)
+{
+    enet_uint16 cumulative = (enet_uint16)(peer->next_expected - 1);
+    enet_uint32 selective = 0;
+    for (int i = 0; i < ENET_STUB_WINDOW - 1; ++i) {
+        enet_uint16 sequence = (enet_uint16)(peer->next_expected + 1 + i);
+        if (peer->incoming[sequence % ENET_STUB_WINDOW].received) {
+            selective |= 1u << i;
+        }
+    }
+    enet_stub_write_u16(out, cumulative);
+    out[2] = (enet_uint8)(selective & 0xFF);
+    out[3] = (enet_uint8)((selective >> 8) & 0xFF);
+    out[4] = (enet_uint8)((selective >> 16) & 0xFF);
+    out[5] = (enet_uint8)((selective >> 24) & 0xFF);
+    peer->ack_pending = 0;
+}
+
+/* Writes [prefix][header][data] as one datagram, queued for the next batch
+ * or sent right away with scatter/gather I/O. */
+static int enet_stub_send_datagram(ENetPeerImpl *peer,
+                                   const enet_uint8 *prefix,
+                                   size_t prefix_length,
+                                   const enet_uint8 *header,
+                                   size_t header_length,
+                                   const enet_uint8 *data,
+                                   size_t data_length)
+{
+    size_t total = prefix_length + header_length + data_length;
+    if (total > ENET_STUB_MAX_PACKET) {
+        return -1;
+    }
+
+    enet_stub_capture_record(peer->host, ENET_STUB_CAPTURE_SENT, peer->id, prefix, prefix_length, header, header_length, data, data_length);
+    if (peer->host->offline) {
+        return 0;
+    }
+    if (peer->host->simulator) {
+        enet_stub_sim_send(peer->host, &peer->address, prefix, prefix_length, header, header_length, data, data_length);
+        return 0;
+    }
+
+#if ENET_STUB_BATCHED_IO
+    ENetStubIoBatch *batch = peer->host->send_batch;
+    if (batch->count == ENET_STUB_IO_BATCH) {
+        enet_stub_flush_sends(peer->host);
+    }
+    size_t slot = batch->count++;
+    enet_uint8 *out = batch->data[slot];
+    memcpy(out, prefix, prefix_length);
+    if (header_length > 0) {
+        memcpy(out + prefix_length, header, header_length);
+    }
+    if (data_length > 0) {
+        memcpy(out + prefix_length + header_length, data, data_length);
+    }
+    batch->buffers[slot].iov_len = total;
+    batch->addresses[slot] = peer->address;
+    batch->messages[slot].msg_hdr.msg_namelen = sizeof(peer->address);
+    return 0;
+#elif defined(_WIN32)
+    WSABUF buffers[3];
+    DWORD buffer_count = 0;
+    buffers[buffer_count].buf = (CHAR *)prefix;
+    buffers[buffer_count].len = (ULONG)prefix_length;
+    ++buffer_count;
+    if (header_length > 0) {
+        buffers[buffer_count].buf = (CHAR *)header;
+        buffers[buffer_count].len = (ULONG)header_length;
+        ++buffer_count;
+    }
+    if (data_length > 0) {
+        buffers[buffer_count].buf = (CHAR *)data;
+        buffers[buffer_count].len = (ULONG)data_length;
+        ++buffer_count;
+    }
+
+    DWORD sent = 0;
+    if (WSASendTo(peer->host->socket,
+                  buffers,
+                  buffer_count,
+                  &sent,
+                  0,
+                  (const struct sockaddr *)&peer->address,
+                  (int)sizeof(peer->address),
+                  NULL,
+                  NULL) != 0) {
+        return -1;
+    }
+    return ((size_t)sent == total) ? 0 : -1;
+#else
+    struct iovec buffers[3];
+    size_t buffer_count = 0;
+    buffers[buffer_count].iov_base = (void *)prefix;
+    buffers[buffer_count].iov_len = prefix_length;
+    ++buffer_count;
+    if (header_length > 0) {
+        buffers[buffer_count].iov_base = (void *)header;
+        buffers[buffer_count].iov_len = header_length;
+        ++buffer_count;
+    }
+    if (data_length > 0) {
+        buffers[buffer_count].iov_base = (void *)data;
+        buffers[buffer_count].iov_len = data_length;
+        ++buffer_count;
+    }
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_name = &peer->address;
+    message.msg_namelen = sizeof(peer->address);
+    message.msg_iov = buffers;
+    message.msg_iovlen = buffer_count;
+
+    ssize_t sent = sendmsg(peer->host->socket, &message, 0);
+    return (sent >= 0 && (size_t)sent == total) ? 0 : -1;
+#endif
+}
+
+static void enet_stub_send_control(ENetHost *host, ENetPeerImpl *peer, enet_uint8 type)
+{
+    if (!host || !peer) {
+        return;
+    }
+    enet_uint8 buffer[1] = {type};
+    enet_stub_send_datagram(peer, buffer, 1, NULL, 0, NULL, 0);
+}
+
+static void enet_stub_write_fragment_header(enet_uint8 *out, enet_uint16 group, size_t index, size_t count)
+{
+    enet_stub_write_u16(out, group);
+    out[2] = (enet_uint8)index;
+    out[3] = (enet_uint8)count;
+}
+
+static size_t enet_stub_fragment_count(size_t length)
+{
+    return (length + ENET_STUB_FRAGMENT_SIZE - 1) / ENET_STUB_FRAGMENT_SIZE;
+}
+
+/* Sends [header][data] as unreliable fragments straight from the caller's
+ * buffers. The receiver drops the whole group if any fragment is lost. */
+static int enet_stub_send_fragments(ENetPeerImpl *peer,
+                                    const enet_uint8 *header,
+                                    size_t header_length,
+                                    const enet_uint8 *data,
+                                    size_t data_length)
+{
+    size_t length = header_length + data_length;
+    size_t count = enet_stub_fragment_count(length);
+    if (count > ENET_STUB_MAX_FRAGMENTS) {
+        return -1;
+    }
+
+    enet_uint16 group = peer->next_fragment_group++;
+    for (size_t index = 0; index < count; ++index) {
+        size_t begin = index * ENET_STUB_FRAGMENT_SIZE;
+        size_t end = (begin + ENET_STUB_FRAGMENT_SIZE < length) ? begin + ENET_STUB_FRAGMENT_SIZE : length;
+
+        enet_uint8 prefix[1 + ENET_STUB_FRAGMENT_HEADER];
+        prefix[0] = ENET_STUB_MSG_FRAGMENT;
+        enet_stub_write_fragment_header(prefix + 1, group, index, count);
+
+        /* a fragment may straddle the header and the data */
+        const enet_uint8 *a = NULL;
+        size_t a_length = 0;
+        const enet_uint8 *b = NULL;
+        size_t b_length = 0;
+        if (begin < header_length) {
+            a = header + begin;
+            a_length = ((end < header_length) ? end : header_length) - begin;
+        }
+        if (end > header_length) {
+            size_t from = (begin > header_length) ? begin - header_length : 0;
+            b = data + from;
+            b_length = end - header_length - from;
+        }
+
+        if (enet_stub_send_datagram(peer, prefix, sizeof(prefix), a, a_length, b, b_length) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Unreliable sends cost nothing extra unless an ack is waiting to go out. */
+static int enet_stub_send_unreliable(ENetPeerImpl *peer,
+                                     const enet_uint8 *header,
+                                     size_t header_length,
+                                     const enet_uint8 *data,
+                                     size_t data_length)
+{
+    size_t length = header_length + data_length;
+    if (1 + length > ENET_STUB_MAX_PACKET) {
+        return enet_stub_send_fragments(peer, header, header_length, data, data_length);
+    }
+
+    enet_uint8 prefix[1 + ENET_STUB_ACK_SIZE];
+    size_t prefix_length = 1;
+    prefix[0] = ENET_STUB_MSG_PAYLOAD;
+    if (peer->ack_pending && 1 + ENET_STUB_ACK_SIZE + length <= ENET_STUB_MAX_PACKET) {
+        prefix[0] = ENET_STUB_MSG_PAYLOAD_ACK;
+        enet_stub_write_ack(peer, prefix + 1);
+        prefix_length += ENET_STUB_ACK_SIZE;
+    }
+    return enet_stub_send_datagram(peer, prefix, prefix_length, header, header_length, data, data_length);
+}
+
+static void enet_stub_transmit_reliable(ENetPeerImpl *peer, ENetStubOutgoing *outgoing, enet_uint32 now)
+{
+    enet_uint8 prefix[ENET_STUB_RELIABLE_HEADER];
+    prefix[0] = ENET_STUB_MSG_RELIABLE;
+    enet_stub_write_u16(prefix + 1, outgoing->sequence);
+    enet_stub_write_ack(peer, prefix + 3);
+    prefix[3 + ENET_STUB_ACK_SIZE] = outgoing->flags;
+
+    /* a failed send is simply retried when the timeout fires */
+    enet_stub_send_datagram(peer, prefix, sizeof(prefix), NULL, 0, outgoing->packet->data, outgoing->packet->dataLength);
+    outgoing->transmissions += 1;
+    outgoing->sent_ms = now;
+}
+
+/* Moves queued packets into free window slots and sends them. */
+static void enet_stub_fill_window(ENetPeerImpl *peer, enet_uint32 now)
+{
+    while (peer->queued_count > 0 && (enet_uint16)(peer->next_sequence - peer->send_base) < ENET_STUB_WINDOW) {
+        ENetPacket *packet = peer->queued[peer->queued_head];
+        peer->queued_head = (peer->queued_head + 1) % ENET_STUB_SEND_QUEUE;
+        --peer->queued_count;
+
+        ENetStubOutgoing *outgoing = &peer->in_flight[peer->next_sequence % ENET_STUB_WINDOW];
+        outgoing->packet = packet;
+        outgoing->sequence = peer->next_sequence++;
+        outgoing->flags = (packet->flags & ENET_PACKET_FLAG_UNSEQUENCED) ? 0 : ENET_STUB_RELIABLE_ORDERED;
+        if (packet->flags & ENET_STUB_PACKET_FLAG_FRAGMENT) {
+            outgoing->flags |= ENET_STUB_RELIABLE_FRAGMENT;
+        }
+        outgoing->transmissions = 0;
+        outgoing->timeout_ms = peer->rto_ms;
+        enet_stub_transmit_reliable(peer, outgoing, now);
+    }
+}
+
+/* Returns 0 when the send queue has room for `count` more packets. */
+static int enet_stub_reserve_queue(ENetPeerImpl *peer, size_t count)
+{
+    if (!peer->queued) {
+        peer->queued = (ENetPacket **)malloc(sizeof(ENetPacket *) * ENET_STUB_SEND_QUEUE);
+        if (!peer->queued) {
+            return -1;
+        }
+    }
+    return (peer->queued_count + count <= ENET_STUB_SEND_QUEUE) ? 0 : -1;
+}
+
+static void enet_stub_enqueue(ENetPeerImpl *peer, ENetPacket *packet)
+{
+    peer->queued[(peer->queued_head + peer->queued_count) % ENET_STUB_SEND_QUEUE] = packet;
+    ++peer->queued_count;
+}
+
+/* Splits an oversized reliable packet into reliable fragments, all queued or
+ * none. Fragments always travel ordered so the receiver only ever has one
+ * group to put back together. */
+static int enet_stub_send_reliable_fragments(ENetPeerImpl *peer, ENetPacket *packet)
+{
+    size_t count = enet_stub_fragment_count(packet->dataLength);
+    if (count > ENET_STUB_MAX_FRAGMENTS || enet_stub_reserve_queue(peer, count) != 0) {
+        return -1;
+    }
+
+    ENetPacket *fragments[ENET_STUB_MAX_FRAGMENTS];
+    enet_uint16 group = peer->next_fragment_group;
+    for (size_t index = 0; index < count; ++index) {
+        size_t begin = index * ENET_STUB_FRAGMENT_SIZE;
+        size_t piece = packet->dataLength - begin;
+        if (piece > ENET_STUB_FRAGMENT_SIZE) {
+            piece = ENET_STUB_FRAGMENT_SIZE;
+        }
+        fragments[index] = enet_stub_packet_alloc(peer->host->pool,
+                                                  NULL,
+                                                  ENET_STUB_FRAGMENT_HEADER + piece,
+                                                  ENET_PACKET_FLAG_RELIABLE | ENET_STUB_PACKET_FLAG_FRAGMENT);
+        if (!fragments[index]) {
+            for (size_t i = 0; i < index; ++i) {
+                enet_packet_destroy(fragments[i]);
+            }
+            return -1;
+        }
+        enet_stub_write_fragment_header(fragments[index]->data, group, index, count);
+        memcpy(fragments[index]->data + ENET_STUB_FRAGMENT_HEADER, packet->data + begin, piece);
+    }
+
+    ++peer->next_fragment_group;
+    for (size_t index = 0; index < count; ++index) {
+        enet_stub_enqueue(peer, fragments[index]);
+    }
+    enet_packet_destroy(packet);
+    enet_stub_fill_window(peer, enet_stub_time_ms());
+    return 0;
+}
+
+/* Takes ownership of the packet on success. */
+static int enet_stub_send_reliable(ENetPeerImpl *peer, ENetPacket *packet)
+{
+    if (packet->dataLength + ENET_STUB_RELIABLE_HEADER > ENET_STUB_MAX_PACKET) {
+        return enet_stub_send_reliable_fragments(peer, packet);
+    }
+    if (enet_stub_reserve_queue(peer, 1) != 0) {
+        return -1;
+    }
+
+    enet_stub_enqueue(peer, packet);
+    enet_stub_fill_window(peer, enet_stub_time_ms());
+    return 0;
+}
+
+/* RTT estimate (RFC 6298) from pongs and unambiguous (first transmission)
+ * acks; the timeout is srtt + 4 * rttvar as in TCP. */
+static void enet_stub_update_rtt(ENetPeerImpl *peer, float sample_ms)
+{
+    if (!peer->has_rtt) {
+        peer->srtt_ms = sample_ms;
+        peer->rttvar_ms = sample_ms * 0.5f;
+        peer->has_rtt = 1;
+    } else {
+        float error = peer->srtt_ms - sample_ms;
+        peer->rttvar_ms = 0.75f * peer->rttvar_ms + 0.25f * (error < 0.0f ? -error : error);
+        peer->srtt_ms = 0.875f * peer->srtt_ms + 0.125f * sample_ms;
+    }
+    peer->base.roundTripTime = (enet_uint32)(peer->srtt_ms + 0.5f);
+    peer->base.roundTripTimeVariance = (enet_uint32)(peer->rttvar_ms + 0.5f);
+    float rto = peer->srtt_ms + 4.0f * peer->rttvar_ms + (float)ENET_STUB_ACK_DELAY_MS;
+    if (rto < ENET_STUB_MIN_RTO_MS) {
+        rto = ENET_STUB_MIN_RTO_MS;
+    } else if (rto > ENET_STUB_MAX_RTO_MS) {
+        rto = ENET_STUB_MAX_RTO_MS;
+    }
+    peer->rto_ms = rto;
+}
+
+static void enet_stub_process_ack(ENetPeerImpl *peer, const enet_uint8 *ack, enet_uint32 now)
+{
+    enet_uint16 cumulative = enet_stub_read_u16(ack);
+    enet_uint32 selective = (enet_uint32)ack[2] | ((enet_uint32)ack[3] << 8) | ((enet_uint32)ack[4] << 16) |
+                            ((enet_uint32)ack[5] << 24);
+
+    int highest_acked = -1;
+    for (enet_uint16 sequence = peer->send_base; sequence != peer->next_sequence; ++sequence) {
+        ENetStubOutgoing *outgoing = &peer->in_flight[sequence % ENET_STUB_WINDOW];
+        if (!outgoing->packet) {
+            continue;
+        }
+
+        int acked = (int16_t)(enet_uint16)(sequence - cumulative) <= 0;
+        if (!acked) {
+            enet_uint16 bit = (enet_uint16)(sequence - cumulative - 2);
+            acked = bit < ENET_STUB_WINDOW - 1 && (selective & (1u << bit)) != 0;
+        }
+        if (!acked) {
+            continue;
+        }
+
+        if (outgoing->transmissions == 1) {
+            enet_stub_update_rtt(peer, (float)(enet_uint32)(now - outgoing->sent_ms));
+        }
+        enet_packet_destroy(outgoing->packet);
+        outgoing->packet = NULL;
+        highest_acked = (enet_uint16)(sequence - peer->send_base);
+    }
+
+    /* fast retransmit: a packet several sequences behind one that got through
+     * is most likely lost, so resend it without waiting for its timeout (at
+     * most once per round trip) */
+    float holdoff_ms = peer->has_rtt ? peer->srtt_ms : peer->rto_ms * 0.5f;
+    for (int offset = 0; offset + ENET_STUB_FAST_RETRANSMIT <= highest_acked; ++offset) {
+        ENetStubOutgoing *outgoing = &peer->in_flight[(enet_uint16)(peer->send_base + offset) % ENET_STUB_WINDOW];
+        if (outgoing->packet && (float)(enet_uint32)(now - outgoing->sent_ms) >= holdoff_ms) {
+            enet_stub_transmit_reliable(peer, outgoing, now);
+        }
+    }
+
+    while (peer->send_base != peer->next_sequence && !peer->in_flight[peer->send_base % ENET_STUB_WINDOW].packet) {
+        ++peer->send_base;
+    }
+    enet_stub_fill_window(peer, now);
+}
+
+ENetPeer *enet_host_connect(ENetHost *host, const ENetAddress *address, size_t channelCount, enet_uint32 data)
+{
+    (void)channelCount;
+    (void)data;
+    if (!host || host->is_server) {
+        return NULL;
+    }
+
+    ENetPeerImpl *peer = enet_stub_alloc_peer(host);
+    if (!peer) {
+        return NULL;
+    }
+
+    struct sockaddr_in addr;
+    enet_stub_address_to_sockaddr(address, &addr);
+    peer->address = addr;
+    peer->connected = 0;
+    enet_stub_index_peer(host, peer);
+    host->server_addr = addr;
+    host->server_peer = peer;
+
+    enet_stub_send_control(host, peer, ENET_STUB_MSG_HELLO);
+    peer->hello_sent_ms = enet_stub_time_ms();
+
+    return (ENetPeer *)peer;
+}
+
+void enet_peer_disconnect(ENetPeer *peer_ptr, enet_uint32 data)
+{
+    (void)data;
+    ENetPeerImpl *peer = (ENetPeerImpl *)peer_ptr;
+    if (!peer || !peer->in_use) {
+        return;
+    }
+    enet_stub_send_control(peer->host, peer, ENET_STUB_MSG_DISCONNECT);
+    peer->connected = 0;
+}
+
+void enet_peer_reset(ENetPeer *peer_ptr)
+{
+    ENetPeerImpl *peer = (ENetPeerImpl *)peer_ptr;
+    if (!peer) {
+        return;
+    }
+    enet_stub_free_peer(peer->host, peer);
+}
+
+static ENetPacket *enet_stub_packet_from_buffer(ENetHost *host, const enet_uint8 *buffer, size_t length)
+{
+    if (length == 0) {
+        return NULL;
+    }
+    return enet_stub_packet_alloc(host->pool, buffer, length, 0);
 }
 
 static void enet_stub_fill_event(ENetEvent *event, ENetEventType type, ENetPeerImpl *peer, ENetPacket *packet)
@@ -362,21 +1991,236 @@ static void enet_stub_fill_event(ENetEvent *event, ENetEventType type, ENetPeerI
     event->data = 0;
 }
 
-static int enet_stub_process_incoming(ENetHost *host, ENetEvent *event)
+static void enet_stub_push_event(ENetHost *host, ENetEventType type, ENetPeerImpl *peer, ENetPacket *packet)
 {
-    enet_uint8 buffer[ENET_STUB_MAX_PACKET];
-    struct sockaddr_in from;
-    socklen_t from_len = sizeof(from);
-    int len = (int)recvfrom(host->socket,
-                            (char *)buffer,
-                            (int)sizeof(buffer),
-                            0,
-                            (struct sockaddr *)&from,
-                            &from_len);
-    if (len <= 0) {
+    if (host->event_count == ENET_STUB_EVENT_QUEUE) {
+        enet_packet_destroy(packet);
+        return;
+    }
+    ENetEvent *event = &host->events[(host->event_head + host->event_count) % ENET_STUB_EVENT_QUEUE];
+    enet_stub_fill_event(event, type, peer, packet);
+    ++host->event_count;
+}
+
+static int enet_stub_pop_event(ENetHost *host, ENetEvent *event)
+{
+    if (host->event_count == 0) {
+        return 0;
+    }
+    *event = host->events[host->event_head];
+    host->event_head = (host->event_head + 1) % ENET_STUB_EVENT_QUEUE;
+    --host->event_count;
+    return 1;
+}
+
+/* Adds one fragment ([fragment header][data]) to its group among `slots` and
+ * returns the whole packet once every fragment is in, NULL otherwise. A new
+ * group takes a free slot or evicts the oldest one, whose packet is then
+ * lost as a whole. Malformed fragments are ignored. */
+static ENetPacket *enet_stub_reassemble(ENetStubPacketPool *pool,
+                                        ENetStubReassembly *slots,
+                                        size_t slot_count,
+                                        const enet_uint8 *fragment,
+                                        size_t length,
+                                        enet_uint32 now)
+{
+    if (length <= ENET_STUB_FRAGMENT_HEADER) {
+        return NULL;
+    }
+    enet_uint16 group = enet_stub_read_u16(fragment);
+    enet_uint8 index = fragment[2];
+    enet_uint8 count = fragment[3];
+    size_t piece = length - ENET_STUB_FRAGMENT_HEADER;
+    if (count == 0 || count > ENET_STUB_MAX_FRAGMENTS || index >= count || piece > ENET_STUB_FRAGMENT_SIZE ||
+        (index + 1 < count && piece != ENET_STUB_FRAGMENT_SIZE)) {
+        return NULL;
+    }
+
+    ENetStubReassembly *slot = NULL;
+    ENetStubReassembly *free_slot = NULL;
+    ENetStubReassembly *oldest = NULL;
+    for (size_t i = 0; i < slot_count; ++i) {
+        ENetStubReassembly *candidate = &slots[i];
+        if (!candidate->packet) {
+            if (!free_slot) {
+                free_slot = candidate;
+            }
+        } else if (candidate->group == group && candidate->count == count) {
+            slot = candidate;
+            break;
+        } else if (!oldest || (int32_t)(candidate->started_ms - oldest->started_ms) < 0) {
+            oldest = candidate;
+        }
+    }
+
+    if (!slot) {
+        slot = free_slot ? free_slot : oldest;
+        enet_packet_destroy(slot->packet);
+        slot->packet = enet_stub_packet_alloc(pool, NULL, (size_t)count * ENET_STUB_FRAGMENT_SIZE, 0);
+        if (!slot->packet) {
+            return NULL;
+        }
+        slot->group = group;
+        slot->count = count;
+        slot->received_count = 0;
+        slot->received = 0;
+        slot->last_length = 0;
+        slot->started_ms = now;
+    }
+
+    uint64_t bit = (uint64_t)1 << index;
+    if (slot->received & bit) {
+        return NULL;
+    }
+    memcpy(slot->packet->data + (size_t)index * ENET_STUB_FRAGMENT_SIZE, fragment + ENET_STUB_FRAGMENT_HEADER, piece);
+    slot->received |= bit;
+    ++slot->received_count;
+    if (index + 1 == count) {
+        slot->last_length = piece;
+    }
+    if (slot->received_count < count) {
+        return NULL;
+    }
+
+    ENetPacket *packet = slot->packet;
+    packet->dataLength = (size_t)(count - 1) * ENET_STUB_FRAGMENT_SIZE + slot->last_length;
+    slot->packet = NULL;
+    return packet;
+}
+
+static int enet_stub_receive_fragment(ENetPeerImpl *peer, const enet_uint8 *buffer, size_t length, ENetEvent *event)
+{
+    ENetPacket *packet = enet_stub_reassemble(peer->host->pool,
+                                              peer->reassembly,
+                                              ENET_STUB_REASSEMBLY_SLOTS,
+                                              buffer + 1,
+                                              length - 1,
+                                              enet_stub_time_ms());
+    if (!packet) {
+        return 0;
+    }
+    enet_stub_fill_event(event, ENET_EVENT_TYPE_RECEIVE, peer, packet);
+    return 1;
+}
+
+/* Handles RELIABLE, ACK and PAYLOAD_ACK datagrams from a known peer. Reliable
+ * packets are acked, deduplicated and, when ordered, held back until every
+ * earlier sequence has been delivered. */
+static int enet_stub_receive_channel(ENetHost *host,
+                                     ENetPeerImpl *peer,
+                                     const enet_uint8 *buffer,
+                                     size_t length,
+                                     ENetEvent *event)
+{
+    enet_uint32 now = enet_stub_time_ms();
+    enet_uint8 message_type = buffer[0];
+
+    if (message_type == ENET_STUB_MSG_ACK || message_type == ENET_STUB_MSG_PAYLOAD_ACK) {
+        if (length < 1 + ENET_STUB_ACK_SIZE) {
+            return 0;
+        }
+        enet_stub_process_ack(peer, buffer + 1, now);
+        if (message_type == ENET_STUB_MSG_ACK || length == 1 + ENET_STUB_ACK_SIZE) {
+            return 0;
+        }
+        ENetPacket *packet = enet_stub_packet_from_buffer(host, buffer + 1 + ENET_STUB_ACK_SIZE, length - 1 - ENET_STUB_ACK_SIZE);
+        enet_stub_fill_event(event, ENET_EVENT_TYPE_RECEIVE, peer, packet);
+        return 1;
+    }
+
+    if (length <= ENET_STUB_RELIABLE_HEADER) {
+        return 0;
+    }
+    enet_uint16 sequence = enet_stub_read_u16(buffer + 1);
+    enet_stub_process_ack(peer, buffer + 3, now);
+    enet_uint8 flags = buffer[3 + ENET_STUB_ACK_SIZE];
+
+    /* always re-ack, even duplicates: the sender may have missed our last ack */
+    if (!peer->ack_pending) {
+        peer->ack_pending = 1;
+        peer->ack_pending_since = now;
+    }
+
+    enet_uint16 offset = (enet_uint16)(sequence - peer->next_expected);
+    if (offset >= ENET_STUB_WINDOW) {
+        return 0;
+    }
+    ENetStubIncoming *slot = &peer->incoming[sequence % ENET_STUB_WINDOW];
+    if (slot->received) {
+        return 0;
+    }
+
+    ENetPacket *packet = enet_stub_packet_from_buffer(host, buffer + ENET_STUB_RELIABLE_HEADER, length - ENET_STUB_RELIABLE_HEADER);
+    slot->received = 1;
+    slot->flags = flags;
+    if (flags & (ENET_STUB_RELIABLE_ORDERED | ENET_STUB_RELIABLE_FRAGMENT)) {
+        slot->packet = packet;
+    } else {
+        enet_stub_push_event(host, ENET_EVENT_TYPE_RECEIVE, peer, packet);
+    }
+
+    while (peer->incoming[peer->next_expected % ENET_STUB_WINDOW].received) {
+        ENetStubIncoming *next = &peer->incoming[peer->next_expected % ENET_STUB_WINDOW];
+        if (next->packet && (next->flags & ENET_STUB_RELIABLE_FRAGMENT)) {
+            ENetPacket *whole =
+                enet_stub_reassemble(host->pool, &peer->reliable_reassembly, 1, next->packet->data, next->packet->dataLength, now);
+            enet_packet_destroy(next->packet);
+            next->packet = whole;
+        }
+        if (next->packet) {
+            enet_stub_push_event(host, ENET_EVENT_TYPE_RECEIVE, peer, next->packet);
+            next->packet = NULL;
+        }
+        next->received = 0;
+        ++peer->next_expected;
+    }
+
+    return enet_stub_pop_event(host, event);
+}
+
+static void enet_stub_send_ping(ENetPeerImpl *peer, enet_uint8 type, enet_uint32 timestamp)
+{
+    enet_uint8 buffer[5];
+    buffer[0] = type;
+    buffer[1] = (enet_uint8)(timestamp & 0xFF);
+    buffer[2] = (enet_uint8)((timestamp >> 8) & 0xFF);
+    buffer[3] = (enet_uint8)((timestamp >> 16) & 0xFF);
+    buffer[4] = (enet_uint8)((timestamp >> 24) & 0xFF);
+    enet_stub_send_datagram(peer, buffer, sizeof(buffer), NULL, 0, NULL, 0);
+}
+
+/* Answers a PING, or takes an RTT sample from a PONG. Never an event. */
+static int enet_stub_receive_ping(ENetPeerImpl *peer, const enet_uint8 *buffer, size_t length)
+{
+    if (length < 5) {
         return 0;
     }
+    enet_uint32 timestamp = (enet_uint32)buffer[1] | ((enet_uint32)buffer[2] << 8) | ((enet_uint32)buffer[3] << 16) |
+                            ((enet_uint32)buffer[4] << 24);
+    if (buffer[0] == ENET_STUB_MSG_PING) {
+        enet_stub_send_ping(peer, ENET_STUB_MSG_PONG, timestamp);
+    } else {
+        enet_uint32 sample = peer->last_receive_ms - timestamp;
+        if (sample < (enet_uint32)ENET_STUB_TIMEOUT_MAX_MS) {
+            enet_stub_update_rtt(peer, (float)sample);
+        }
+    }
+    return 0;
+}
 
+static int enet_stub_is_channel_message(enet_uint8 message_type)
+{
+    return message_type == ENET_STUB_MSG_RELIABLE || message_type == ENET_STUB_MSG_ACK ||
+           message_type == ENET_STUB_MSG_PAYLOAD_ACK;
+}
+
+static int enet_stub_handle_datagram(ENetHost *host,
+                                     const struct sockaddr_in *from_addr,
+                                     const enet_uint8 *buffer,
+                                     int len,
+                                     ENetEvent *event)
+{
+    struct sockaddr_in from = *from_addr;
     enet_uint8 message_type = buffer[0];
     ENetPeerImpl *peer = enet_stub_find_peer(host, &from);
 
@@ -389,12 +2233,14 @@ static int enet_stub_process_incoming(ENetHost *host, ENetEvent *event)
                 }
                 peer->address = from;
                 peer->connected = 1;
+                enet_stub_index_peer(host, peer);
                 enet_stub_send_control(host, peer, ENET_STUB_MSG_HELLO_ACK);
                 enet_stub_fill_event(event, ENET_EVENT_TYPE_CONNECT, peer, NULL);
                 return 1;
             }
             return 0;
         }
+        peer->last_receive_ms = enet_stub_time_ms();
 
         if (message_type == ENET_STUB_MSG_HELLO) {
             peer->connected = 1;
@@ -404,93 +2250,441 @@ static int enet_stub_process_incoming(ENetHost *host, ENetEvent *event)
         } else if (message_type == ENET_STUB_MSG_DISCONNECT) {
             peer->connected = 0;
             enet_stub_fill_event(event, ENET_EVENT_TYPE_DISCONNECT, peer, NULL);
-            peer->in_use = 0;
+            enet_stub_free_peer(host, peer);
             return 1;
         } else if (message_type == ENET_STUB_MSG_PAYLOAD) {
-            ENetPacket *packet = enet_stub_packet_from_buffer(buffer + 1, (size_t)len - 1);
+            ENetPacket *packet = enet_stub_packet_from_buffer(host, buffer + 1, (size_t)len - 1);
             enet_stub_fill_event(event, ENET_EVENT_TYPE_RECEIVE, peer, packet);
             return 1;
+        } else if (message_type == ENET_STUB_MSG_FRAGMENT) {
+            return enet_stub_receive_fragment(peer, buffer, (size_t)len, event);
+        } else if (enet_stub_is_channel_message(message_type)) {
+            return enet_stub_receive_channel(host, peer, buffer, (size_t)len, event);
+        } else if (message_type == ENET_STUB_MSG_PING || message_type == ENET_STUB_MSG_PONG) {
+            return enet_stub_receive_ping(peer, buffer, (size_t)len);
         }
     } else {
         peer = host->server_peer;
         if (!peer) {
             return 0;
         }
+        peer->last_receive_ms = enet_stub_time_ms();
         if (message_type == ENET_STUB_MSG_HELLO_ACK) {
+            if (peer->connected) {
+                /* answer to a retried HELLO */
+                return 0;
+            }
             peer->connected = 1;
             enet_stub_fill_event(event, ENET_EVENT_TYPE_CONNECT, peer, NULL);
             return 1;
         } else if (message_type == ENET_STUB_MSG_DISCONNECT) {
-            peer->connected = 0;
             enet_stub_fill_event(event, ENET_EVENT_TYPE_DISCONNECT, peer, NULL);
+            host->server_peer = NULL;
+            enet_stub_free_peer(host, peer);
             return 1;
         } else if (message_type == ENET_STUB_MSG_PAYLOAD) {
-            ENetPacket *packet = enet_stub_packet_from_buffer(buffer + 1, (size_t)len - 1);
+            ENetPacket *packet = enet_stub_packet_from_buffer(host, buffer + 1, (size_t)len - 1);
             enet_stub_fill_event(event, ENET_EVENT_TYPE_RECEIVE, peer, packet);
             return 1;
+        } else if (message_type == ENET_STUB_MSG_FRAGMENT) {
+            return enet_stub_receive_fragment(peer, buffer, (size_t)len, event);
+        } else if (enet_stub_is_channel_message(message_type)) {
+            return enet_stub_receive_channel(host, peer, buffer, (size_t)len, event);
+        } else if (message_type == ENET_STUB_MSG_PING || message_type == ENET_STUB_MSG_PONG) {
+            return enet_stub_receive_ping(peer, buffer, (size_t)len);
         }
     }
 
     return 0;
 }
 
-int enet_host_service(ENetHost *host, ENetEvent *event, enet_uint32 timeout_ms)
+/* Returns 1 with an event, 0 when a datagram was consumed without one (acks,
+ * duplicates, junk) and -1 when nothing is left to read. */
+static int enet_stub_process_incoming(ENetHost *host, ENetEvent *event)
 {
-    if (!host || !event) {
-        return -1;
+    struct sockaddr_in from;
+    const enet_uint8 *buffer = NULL;
+    int len = 0;
+#if !ENET_STUB_BATCHED_IO
+    enet_uint8 receive_buffer[ENET_STUB_MAX_PACKET];
+#endif
+#if ENET_STUB_RECEIVE_SHARDS
+    ENetStubShard *shard = NULL;
+#endif
+
+    if (host->offline) {
+        if (host->inbox_count == 0) {
+            return -1;
+        }
+        const ENetStubDatagram *datagram = &host->inbox[host->inbox_head];
+        host->inbox_head = (host->inbox_head + 1) % ENET_STUB_INBOX_CAPACITY;
+        --host->inbox_count;
+        enet_stub_offline_address(datagram->peer, &from);
+        buffer = datagram->data;
+        len = (int)datagram->length;
+#if ENET_STUB_RECEIVE_SHARDS
+    } else if (host->shard_count > 0) {
+        shard = enet_stub_shard_peek(host, &from, &buffer, &len);
+        if (!shard) {
+            enet_stub_shard_clear_wake(host);
+            /* a ring may have filled between the peek and the clear */
+            shard = enet_stub_shard_peek(host, &from, &buffer, &len);
+            if (!shard) {
+                return -1;
+            }
+        }
+        if (len == 0) {
+            enet_stub_shard_release(shard);
+            return 0;
+        }
+#endif
+    } else {
+#if ENET_STUB_BATCHED_IO
+        ENetStubIoBatch *batch = host->receive_batch;
+        if (batch->count == 0 && enet_stub_receive_batch(host) <= 0) {
+            return -1;
+        }
+        size_t slot = batch->head++;
+        --batch->count;
+        from = batch->addresses[slot];
+        buffer = batch->data[slot];
+        len = (int)batch->messages[slot].msg_len;
+#else
+        socklen_t from_len = sizeof(from);
+        len = (int)recvfrom(host->socket,
+                            (char *)receive_buffer,
+                            (int)sizeof(receive_buffer),
+                            0,
+                            (struct sockaddr *)&from,
+                            &from_len);
+        if (len < 0) {
+            return -1;
+        }
+        buffer = receive_buffer;
+#endif
+        if (len == 0) {
+            return 0;
+        }
+    }
+
+    event->peer = NULL;
+    int result = enet_stub_handle_datagram(host, &from, buffer, len, event);
+    if (host->capture) {
+        /* the peer is known once handling has matched or allocated it */
+        enet_uint32 peer_id = (result > 0 && event->peer) ? ((ENetPeerImpl *)event->peer)->id : 0;
+        enet_stub_capture_record(host, ENET_STUB_CAPTURE_RECEIVED, peer_id, buffer, (size_t)len, NULL, 0, NULL, 0);
+    }
+#if ENET_STUB_RECEIVE_SHARDS
+    if (shard) {
+        enet_stub_shard_release(shard);
+    }
+#endif
+    return result;
+}
+
+/* Times out silent peers, pings the others, retransmits timed-out reliable
+ * packets, drops stale partial fragment groups, sends acks nothing carried
+ * and retries an unanswered HELLO. Runs once the incoming queue is drained. */
+static void enet_stub_service_peers(ENetHost *host)
+{
+    enet_uint32 now = enet_stub_time_ms();
+    for (size_t i = 0; i < host->peer_count; ++i) {
+        ENetPeerImpl *peer = &host->peers[i];
+        if (!peer->in_use) {
+            continue;
+        }
+
+        if (!host->offline) {
+            float timeout_ms = ENET_STUB_TIMEOUT_LIMIT * peer->rto_ms;
+            if (timeout_ms < ENET_STUB_TIMEOUT_MIN_MS) {
+                timeout_ms = ENET_STUB_TIMEOUT_MIN_MS;
+            } else if (timeout_ms > ENET_STUB_TIMEOUT_MAX_MS) {
+                timeout_ms = ENET_STUB_TIMEOUT_MAX_MS;
+            }
+            /* wait for room in the queue rather than lose the event */
+            if ((float)(enet_uint32)(now - peer->last_receive_ms) >= timeout_ms &&
+                host->event_count < ENET_STUB_EVENT_QUEUE) {
+                enet_stub_push_event(host, ENET_EVENT_TYPE_DISCONNECT, peer, NULL);
+                if (peer == host->server_peer) {
+                    host->server_peer = NULL;
+                }
+                enet_stub_free_peer(host, peer);
+                continue;
+            }
+            if (peer->connected && (enet_uint32)(now - peer->last_ping_ms) >= ENET_STUB_PING_INTERVAL_MS) {
+                enet_stub_send_ping(peer, ENET_STUB_MSG_PING, now);
+                peer->last_ping_ms = now;
+            }
+        }
+
+        if (!host->is_server && !peer->connected && peer == host->server_peer &&
+            (enet_uint32)(now - peer->hello_sent_ms) >= ENET_STUB_HELLO_RETRY_MS) {
+            enet_stub_send_control(host, peer, ENET_STUB_MSG_HELLO);
+            peer->hello_sent_ms = now;
+        }
+
+        for (enet_uint16 sequence = peer->send_base; sequence != peer->next_sequence; ++sequence) {
+            ENetStubOutgoing *outgoing = &peer->in_flight[sequence % ENET_STUB_WINDOW];
+            if (!outgoing->packet || (float)(enet_uint32)(now - outgoing->sent_ms) < outgoing->timeout_ms) {
+                continue;
+            }
+            enet_stub_transmit_reliable(peer, outgoing, now);
+            /* back off on loss */
+            outgoing->timeout_ms *= 2.0f;
+            if (outgoing->timeout_ms > ENET_STUB_MAX_RTO_MS) {
+                outgoing->timeout_ms = ENET_STUB_MAX_RTO_MS;
+            }
+        }
+
+        for (int slot = 0; slot < ENET_STUB_REASSEMBLY_SLOTS; ++slot) {
+            ENetStubReassembly *reassembly = &peer->reassembly[slot];
+            if (reassembly->packet && (enet_uint32)(now - reassembly->started_ms) >= ENET_STUB_REASSEMBLY_TIMEOUT_MS) {
+                enet_packet_destroy(reassembly->packet);
+                reassembly->packet = NULL;
+            }
+        }
+
+        if (peer->ack_pending && (enet_uint32)(now - peer->ack_pending_since) >= ENET_STUB_ACK_DELAY_MS) {
+            enet_uint8 ack[1 + ENET_STUB_ACK_SIZE];
+            ack[0] = ENET_STUB_MSG_ACK;
+            enet_stub_write_ack(peer, ack + 1);
+            enet_stub_send_datagram(peer, ack, sizeof(ack), NULL, 0, NULL, 0);
+        }
+    }
+}
+
+/* Waits until the host may have datagrams to read; returns > 0 if so. */
+static int enet_stub_wait(ENetHost *host, enet_uint32 timeout_ms)
+{
+#if ENET_STUB_RECEIVE_SHARDS
+    if (host->shard_count > 0) {
+        struct pollfd wake;
+        wake.fd = host->wake_fd;
+        wake.events = POLLIN;
+        return poll(&wake, 1, (int)timeout_ms);
     }
+#endif
 
     fd_set read_fds;
     FD_ZERO(&read_fds);
     FD_SET(host->socket, &read_fds);
 
     struct timeval tv;
-    struct timeval *tv_ptr = NULL;
-    if (timeout_ms != 0) {
-        tv.tv_sec = (long)(timeout_ms / 1000);
-        tv.tv_usec = (long)((timeout_ms % 1000) * 1000);
-        tv_ptr = &tv;
-    } else {
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-        tv_ptr = &tv;
-    }
+    tv.tv_sec = (long)(timeout_ms / 1000);
+    tv.tv_usec = (long)((timeout_ms % 1000) * 1000);
 
 #if defined(_WIN32)
-    int ready = select(0, &read_fds, NULL, NULL, tv_ptr);
+    return select(0, &read_fds, NULL, NULL, &tv);
 #else
-    int ready = select(host->socket + 1, &read_fds, NULL, NULL, tv_ptr);
+    return select(host->socket + 1, &read_fds, NULL, NULL, &tv);
 #endif
-    if (ready <= 0) {
-        event->type = ENET_EVENT_TYPE_NONE;
-        event->peer = NULL;
-        event->packet = NULL;
-        event->data = 0;
+}
+
+int enet_host_service(ENetHost *host, ENetEvent *event, enet_uint32 timeout_ms)
+{
+    if (!host || !event) {
+        return -1;
+    }
+
+    g_enet_stub_current_pool = host->pool;
+
+    if (enet_stub_pop_event(host, event)) {
+        return 1;
+    }
+
+    enet_stub_sim_release(host, 0);
+    enet_stub_flush_sends(host);
+
+    /* the socket is non-blocking, so read first and only wait when there
+     * was nothing and the caller allows it */
+    int waited = (timeout_ms == 0 || host->offline);
+    enet_uint32 started_ms = host->simulator ? enet_stub_time_ms() : 0;
+    for (;;) {
+        int result = enet_stub_process_incoming(host, event);
+        if (result > 0) {
+            return 1;
+        }
+        if (result == 0) {
+            continue;
+        }
+        if (waited) {
+            break;
+        }
+
+        /* delayed datagrams must go out on time, so wait a tick at a time
+         * while the simulator holds any */
+        enet_uint32 wait_ms = timeout_ms;
+        waited = 1;
+        if (host->simulator && host->simulator->stats.queued > 0) {
+            enet_uint32 elapsed_ms = enet_stub_time_ms() - started_ms;
+            if (elapsed_ms >= timeout_ms) {
+                break;
+            }
+            wait_ms = timeout_ms - elapsed_ms;
+            if (wait_ms > 1) {
+                wait_ms = 1;
+                waited = 0;
+            }
+        }
+
+        if (enet_stub_wait(host, wait_ms) <= 0) {
+            if (waited) {
+                break;
+            }
+            enet_stub_sim_release(host, 0);
+            enet_stub_flush_sends(host);
+        }
+    }
+
+    enet_stub_service_peers(host);
+    enet_stub_sim_release(host, 0);
+    enet_stub_flush_sends(host);
+    enet_stub_fill_event(event, ENET_EVENT_TYPE_NONE, NULL, NULL);
+    return 0;
+}
+
+void enet_host_flush(ENetHost *host)
+{
+    if (!host) {
+        return;
+    }
+    enet_stub_sim_release(host, 0);
+    enet_stub_flush_sends(host);
+}
+
+int enet_host_simulate(ENetHost *host, const ENetSimulatorSettings *settings)
+{
+    if (!host || host->offline) {
+        return -1;
+    }
+
+    if (!settings) {
+        if (host->simulator) {
+            enet_stub_sim_release(host, 1);
+            enet_stub_flush_sends(host);
+            enet_stub_sim_free(host->simulator);
+            host->simulator = NULL;
+        }
         return 0;
     }
 
-    return enet_stub_process_incoming(host, event);
+    ENetStubSimulator *sim = host->simulator;
+    if (!sim) {
+        sim = (ENetStubSimulator *)calloc(1, sizeof(ENetStubSimulator));
+        if (!sim) {
+            return -1;
+        }
+        sim->wheel_ms = enet_stub_time_ms();
+        sim->last_due_ms = sim->wheel_ms;
+        host->simulator = sim;
+    }
+
+    sim->settings = *settings;
+    float *probabilities[3] = {&sim->settings.loss, &sim->settings.duplicate, &sim->settings.reorder};
+    for (int i = 0; i < 3; ++i) {
+        if (!(*probabilities[i] > 0.0f)) {
+            *probabilities[i] = 0.0f;
+        } else if (*probabilities[i] > 1.0f) {
+            *probabilities[i] = 1.0f;
+        }
+    }
+    if (sim->settings.reorderMs <= 0.0f) {
+        sim->settings.reorderMs = ENET_STUB_SIM_REORDER_MS;
+    }
+
+    /* splitmix64 of the seed, so that nearby seeds give unrelated streams */
+    uint64_t seed = (uint64_t)settings->seed + 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+    sim->random = seed ? seed : 1;
+
+    /* two-state loss with mean burst length B and overall rate p: a burst
+     * ends with probability 1/B, and starts with p/(1-p) of that */
+    sim->in_loss_burst = 0;
+    sim->burst_enter = 0.0f;
+    sim->burst_exit = 0.0f;
+    if (sim->settings.lossBurst > 1.0f && sim->settings.loss > 0.0f && sim->settings.loss < 1.0f) {
+        sim->burst_exit = 1.0f / sim->settings.lossBurst;
+        sim->burst_enter = sim->settings.loss * sim->burst_exit / (1.0f - sim->settings.loss);
+    }
+    return 0;
+}
+
+void enet_host_simulator_stats(const ENetHost *host, ENetSimulatorStats *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!host || !host->simulator) {
+        return;
+    }
+    *stats = host->simulator->stats;
+}
+
+ENetSocket enet_host_socket(const ENetHost *host)
+{
+    if (!host) {
+        return (ENetSocket)INVALID_SOCKET;
+    }
+#if ENET_STUB_RECEIVE_SHARDS
+    if (host->shard_count > 0) {
+        return (ENetSocket)host->wake_fd;
+    }
+#endif
+    return (ENetSocket)host->socket;
 }
 
 int enet_peer_send(ENetPeer *peer_ptr, enet_uint8 channelID, ENetPacket *packet)
 {
     (void)channelID;
     ENetPeerImpl *peer = (ENetPeerImpl *)peer_ptr;
-    if (!peer || !peer->in_use || !packet || packet->dataLength + 1 > ENET_STUB_MAX_PACKET) {
+    if (!peer || !peer->in_use || !packet) {
+        return -1;
+    }
+
+    if ((packet->flags & ENET_PACKET_FLAG_RELIABLE) && !peer->host->offline) {
+        return enet_stub_send_reliable(peer, packet);
+    }
+
+    if (enet_stub_send_unreliable(peer, NULL, 0, packet->data, packet->dataLength) != 0) {
+        return -1;
+    }
+    enet_packet_destroy(packet);
+    return 0;
+}
+
+int enet_peer_send_with_header(ENetPeer *peer_ptr,
+                               enet_uint8 channelID,
+                               const void *header,
+                               size_t headerLength,
+                               ENetPacket *packet)
+{
+    (void)channelID;
+    ENetPeerImpl *peer = (ENetPeerImpl *)peer_ptr;
+    if (!peer || !peer->in_use || !packet || (!header && headerLength > 0)) {
         return -1;
     }
 
-    enet_uint8 buffer[ENET_STUB_MAX_PACKET];
-    buffer[0] = ENET_STUB_MSG_PAYLOAD;
-    memcpy(buffer + 1, packet->data, packet->dataLength);
+    if ((packet->flags & ENET_PACKET_FLAG_RELIABLE) && !peer->host->offline) {
+        /* the reliable path keeps its own copy for retransmission */
+        ENetPacket *copy = enet_stub_packet_alloc(peer->host->pool, NULL, headerLength + packet->dataLength, packet->flags);
+        if (!copy) {
+            return -1;
+        }
+        if (headerLength > 0) {
+            memcpy(copy->data, header, headerLength);
+        }
+        memcpy(copy->data + headerLength, packet->data, packet->dataLength);
+        if (enet_stub_send_reliable(peer, copy) != 0) {
+            enet_packet_destroy(copy);
+            return -1;
+        }
+        return 0;
+    }
 
-    int sent = (int)sendto(peer->host->socket,
-                           (const char *)buffer,
-                           (int)(packet->dataLength + 1),
-                           0,
-                           (const struct sockaddr *)&peer->address,
-                           sizeof(peer->address));
-    return (sent == (int)(packet->dataLength + 1)) ? 0 : -1;
+    return enet_stub_send_unreliable(peer, (const enet_uint8 *)header, headerLength, packet->data, packet->dataLength);
 }
 
 void enet_host_broadcast(ENetHost *host, enet_uint8 channelID, ENetPacket *packet)
@@ -503,36 +2697,59 @@ void enet_host_broadcast(ENetHost *host, enet_uint8 channelID, ENetPacket *packe
         if (!peer->in_use || !peer->connected) {
             continue;
         }
-        enet_peer_send((ENetPeer *)peer, channelID, packet);
+        enet_peer_send_with_header((ENetPeer *)peer, channelID, NULL, 0, packet);
     }
+    enet_packet_destroy(packet);
 }
 
 ENetPacket *enet_packet_create(const void *data, size_t dataLength, enet_uint32 flags)
 {
-    ENetPacket *packet = (ENetPacket *)calloc(1, sizeof(ENetPacket));
+    return enet_stub_packet_alloc(g_enet_stub_current_pool, data, dataLength, flags);
+}
+
+void enet_packet_destroy(ENetPacket *packet)
+{
     if (!packet) {
-        return NULL;
+        return;
     }
-    packet->data = (enet_uint8 *)malloc(dataLength);
-    if (!packet->data) {
-        free(packet);
-        return NULL;
+
+    ENetStubPacketBlock *block = (ENetStubPacketBlock *)((char *)packet - offsetof(ENetStubPacketBlock, packet));
+    ENetStubPacketPool *pool = block->pool;
+    if (!pool) {
+        free(block);
+        return;
     }
-    if (data && dataLength > 0) {
-        memcpy(packet->data, data, dataLength);
+
+    pool->stats.outstanding -= 1;
+    if (pool->orphaned) {
+        free(block);
+        if (pool->stats.outstanding == 0) {
+            free(pool);
+        }
+        return;
     }
-    packet->dataLength = dataLength;
-    packet->flags = flags;
-    return packet;
+    if (pool->free_counts[block->size_class] >= g_enet_stub_pool_class_limits[block->size_class]) {
+        free(block);
+        return;
+    }
+    block->next = pool->free_blocks[block->size_class];
+    pool->free_blocks[block->size_class] = block;
+    ++pool->free_counts[block->size_class];
 }
 
-void enet_packet_destroy(ENetPacket *packet)
+void enet_host_packet_pool_stats(const ENetHost *host, ENetPacketPoolStats *stats)
 {
-    if (!packet) {
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!host || !host->pool) {
         return;
     }
-    free(packet->data);
-    free(packet);
+    *stats = host->pool->stats;
+    for (int size_class = 0; size_class < ENET_STUB_POOL_CLASSES; ++size_class) {
+        stats->pooled += host->pool->free_counts[size_class];
+    }
 }
 
 enet_uint32 enet_time_get(void)
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "engine/network_bitpack.h"
+#include "engine/network_conditions.h"
 #include "engine/network_master.h"
 
 #ifndef ENET_PACKET_FLAG_UNSEQUENCED
@@ -15,8 +17,14 @@
 #endif
 
 typedef struct NetworkClient NetworkClient;
-
-#define NETWORK_MAX_REMOTE_PLAYERS 16
+typedef struct PlayerCommand PlayerCommand;
+typedef struct PlayerState PlayerState;
+typedef struct GameConfig GameConfig;
+typedef struct GameWorld GameWorld;
+
+/* per snapshot; full snapshots this large span several datagrams and are
+ * fragmented by the transport */
+#define NETWORK_MAX_REMOTE_PLAYERS 64
 #define NETWORK_MAX_PLAYER_NAME    16
 
 #define NETWORK_VOICE_MAX_DATA        2048
@@ -25,14 +33,42 @@ typedef struct NetworkClient NetworkClient;
 typedef struct NetworkClientConfig {
     const char *host;
     uint16_t port;
+    /* shape outgoing traffic with `conditions`, to play or test against a
+     * server on loopback as if it were far away */
     bool simulate_latency;
+    NetworkConditions conditions;
+    /* how far behind the newest snapshot remote players are drawn; more
+     * rides out jitter and loss, less shows them sooner. 0 for 100 ms,
+     * two snapshot intervals at 20 Hz */
+    float interpolation_delay_ms;
+    /* player command uploads per second, whatever the frame rate; commands
+     * of the frames in between are batched. 0 for 60 */
+    float command_rate;
 } NetworkClientConfig;
 
 typedef struct NetworkClientStats {
     bool connected;
     float time_since_last_packet;
-    float simulated_ping_ms;
+    /* smoothed round-trip time to the server and its variance, from the
+     * transport's keepalive pings; 0 until measured */
+    float ping_ms;
+    float ping_variance_ms;
     uint32_t remote_player_count;
+    uint64_t bytes_received;
+    uint64_t snapshots_received;
+    /* how far the newest snapshot is ahead of the time remote players are
+     * drawn at (negative while extrapolating), and the updates that found
+     * no snapshot to interpolate towards */
+    float interpolation_buffer_ms;
+    uint64_t interpolation_underruns;
+    /* local player prediction: commands sent but not yet simulated by the
+     * server, and the reconciliations that moved the predicted position
+     * (by prediction_error_average_m on average) */
+    uint32_t prediction_pending_commands;
+    uint64_t prediction_corrections;
+    float prediction_error_average_m;
+    /* datagrams carrying player commands, at most command_rate per second */
+    uint64_t command_uploads;
 } NetworkClientStats;
 
 typedef struct NetworkRemotePlayer {
@@ -43,16 +79,35 @@ typedef struct NetworkRemotePlayer {
     float yaw;
 } NetworkRemotePlayer;
 
-typedef struct NetworkClientPlayerState {
-    float position[3];
+/* Movement input for one client frame; the server replays it through
+ * player_update_physics. `sequence` is stamped by the sending client. */
+typedef struct NetworkPlayerCommand {
+    uint32_t sequence;
+    float duration;
+    float move_direction[3];
+    float move_magnitude;
+    float vertical_axis;
     float yaw;
-} NetworkClientPlayerState;
+    bool jump;
+    bool sprint;
+} NetworkPlayerCommand;
+
+/* seconds; the server clamps longer commands */
+#define NETWORK_MAX_COMMAND_DURATION 0.1f
 
 typedef enum NetworkWeaponEventType {
     NETWORK_WEAPON_EVENT_DROP = 0,
     NETWORK_WEAPON_EVENT_PICKUP = 1,
+    NETWORK_WEAPON_EVENT_FIRE = 2,
 } NetworkWeaponEventType;
 
+#define NETWORK_WEAPON_EVENT_NO_HIT 0xFFU
+
+/* For FIRE, `position` is the muzzle, `direction` the unit aim vector and
+ * `view_time` the server time the shooter was looking at (see
+ * network_client_view_time). The server checks the shot against the players
+ * as they were at view_time and relays it with `hit_id` set to the player it
+ * hit, or NETWORK_WEAPON_EVENT_NO_HIT; the hit_id a client sends is ignored. */
 typedef struct NetworkWeaponEvent {
     NetworkWeaponEventType type;
     uint8_t actor_id;
@@ -61,10 +116,14 @@ typedef struct NetworkWeaponEvent {
     int16_t ammo_in_clip;
     int16_t ammo_reserve;
     float position[3];
+    float direction[3];
+    double view_time;
+    uint8_t hit_id;
 } NetworkWeaponEvent;
 
 typedef enum NetworkVoiceCodec {
     NETWORK_VOICE_CODEC_PCM16 = 0,
+    NETWORK_VOICE_CODEC_IMA_ADPCM = 1,
 } NetworkVoiceCodec;
 
 typedef struct NetworkVoicePacket {
@@ -88,8 +147,33 @@ void network_client_update(NetworkClient *client, float dt);
 bool network_client_is_connected(const NetworkClient *client);
 const NetworkClientStats *network_client_stats(const NetworkClient *client);
 uint8_t network_client_self_id(const NetworkClient *client);
+/* Players as of the newest snapshot, including the local one. */
 const NetworkRemotePlayer *network_client_remote_players(const NetworkClient *client, size_t *out_count);
-bool network_client_send_player_state(NetworkClient *client, const NetworkClientPlayerState *state);
+/* Other players as they should be drawn: each one's recent snapshot states
+ * are played back interpolation_delay_ms behind the server, interpolating
+ * position and yaw, and extrapolated for at most 250 ms when snapshots stop
+ * coming. Updated by network_client_update. */
+const NetworkRemotePlayer *network_client_interpolated_players(const NetworkClient *client, size_t *out_count);
+/* Server time the interpolated players currently show, in seconds; what a
+ * FIRE event's view_time should carry. Zero before the first snapshot. */
+double network_client_view_time(const NetworkClient *client);
+/* Stamps `command` with the next sequence and keeps it until the server
+ * reports having simulated it. Commands go out in batches at command_rate,
+ * unreliably; each upload also repeats the still pending commands of the two
+ * uploads before it, so a command is only lost with three uploads in a row.
+ * On success `command` holds the values the server will decode (quantized,
+ * duration clamped), which is what the local player should be predicted
+ * with. */
+bool network_client_send_player_command(NetworkClient *client, NetworkPlayerCommand *command);
+/* Client-side prediction: when an authoritative state of the local player has
+ * arrived since the last call, rewinds `player` to it and replays the commands
+ * the server had not simulated yet through player_update_physics. Returns true
+ * when `player` was reconciled. */
+bool network_client_reconcile(NetworkClient *client,
+                              PlayerState *player,
+                              const GameConfig *config,
+                              GameWorld *world,
+                              size_t player_entity_index);
 bool network_client_send_weapon_event(NetworkClient *client, const NetworkWeaponEvent *event);
 size_t network_client_dequeue_weapon_events(NetworkClient *client,
                                             NetworkWeaponEvent *out_events,
@@ -99,6 +183,19 @@ size_t network_client_dequeue_voice_packets(NetworkClient *client,
                                             NetworkVoicePacket *out_packets,
                                             size_t max_packets);
 
+/* Expected payload bytes for a voice frame, or 0 if the codec is unknown or
+ * the decoded PCM would not fit in NETWORK_VOICE_MAX_DATA. */
+size_t network_voice_payload_size(NetworkVoiceCodec codec, uint16_t frame_count, uint8_t channels);
+
+void network_player_command_write(NetworkBitWriter *writer,
+                                  const NetworkQuantization *quant,
+                                  const NetworkPlayerCommand *command);
+bool network_player_command_read(NetworkBitReader *reader,
+                                 const NetworkQuantization *quant,
+                                 NetworkPlayerCommand *command);
+/* The movement input player_update_physics takes for `command`. */
+void network_player_command_to_input(const NetworkPlayerCommand *command, PlayerCommand *input);
+
 bool network_fetch_master_list(const MasterClientConfig *config,
                                MasterServerEntry *out_entries,
                                size_t max_entries,
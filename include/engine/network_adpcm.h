@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* IMA-ADPCM voice codec: 4 bits per sample plus a per-channel header holding
+ * the predictor and step index the frame starts from, so a lost packet only
+ * costs that frame. Samples are interleaved as in PCM16. */
+typedef struct NetworkAdpcmState {
+    int16_t predictor;
+    uint8_t step_index;
+} NetworkAdpcmState;
+
+#define NETWORK_ADPCM_CHANNEL_HEADER_SIZE 4
+
+void network_adpcm_state_reset(NetworkAdpcmState *state);
+size_t network_adpcm_encoded_size(uint16_t frame_count, uint8_t channels);
+
+/* Encodes frame_count interleaved frames, continuing from `states` (one per
+ * channel). Returns the bytes written, or 0 if `out` is too small. */
+size_t network_adpcm_encode(NetworkAdpcmState *states,
+                            uint8_t channels,
+                            const int16_t *samples,
+                            uint16_t frame_count,
+                            uint8_t *out,
+                            size_t out_capacity);
+
+/* Decodes a frame produced by network_adpcm_encode, resynchronising `states`
+ * from its header. Returns the number of samples written, or 0 on error. */
+size_t network_adpcm_decode(NetworkAdpcmState *states,
+                            uint8_t channels,
+                            const uint8_t *data,
+                            size_t size,
+                            uint16_t frame_count,
+                            int16_t *out,
+                            size_t out_capacity);
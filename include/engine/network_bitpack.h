@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fixed-point ranges shared by client and server. Positions are quantized
+ * relative to the world bounds with a per-axis bit count; yaw wraps to
+ * [0, 2*pi) and uses yaw_bits. The server sends its table in WELCOME. */
+typedef struct NetworkQuantization {
+    float world_min[3];
+    float world_max[3];
+    uint8_t position_bits[3];
+    uint8_t yaw_bits;
+} NetworkQuantization;
+
+#define NETWORK_QUANTIZATION_WIRE_SIZE (sizeof(float) * 6 + 4)
+
+typedef struct NetworkBitWriter {
+    uint8_t *data;
+    size_t capacity;
+    size_t bit_position;
+    bool overflow;
+} NetworkBitWriter;
+
+typedef struct NetworkBitReader {
+    const uint8_t *data;
+    size_t size;
+    size_t bit_position;
+    bool overflow;
+} NetworkBitReader;
+
+void network_bit_writer_init(NetworkBitWriter *writer, uint8_t *data, size_t capacity);
+void network_bit_write(NetworkBitWriter *writer, uint32_t value, unsigned bits);
+size_t network_bit_writer_bytes(const NetworkBitWriter *writer);
+
+void network_bit_reader_init(NetworkBitReader *reader, const uint8_t *data, size_t size);
+uint32_t network_bit_read(NetworkBitReader *reader, unsigned bits);
+size_t network_bit_reader_bytes(const NetworkBitReader *reader);
+
+void network_quantization_default(NetworkQuantization *quant);
+bool network_quantization_valid(const NetworkQuantization *quant);
+float network_quantization_position_step(const NetworkQuantization *quant, int axis);
+size_t network_quantization_write(const NetworkQuantization *quant, uint8_t *out, size_t capacity);
+bool network_quantization_read(NetworkQuantization *quant, const uint8_t *data, size_t size);
+
+uint32_t network_quantize_position(const NetworkQuantization *quant, int axis, float value);
+float network_dequantize_position(const NetworkQuantization *quant, int axis, uint32_t value);
+uint32_t network_quantize_yaw(const NetworkQuantization *quant, float yaw);
+float network_dequantize_yaw(const NetworkQuantization *quant, uint32_t value);
+
+void network_bit_write_position(NetworkBitWriter *writer, const NetworkQuantization *quant, const float position[3]);
+void network_bit_read_position(NetworkBitReader *reader, const NetworkQuantization *quant, float position[3]);
+void network_bit_write_yaw(NetworkBitWriter *writer, const NetworkQuantization *quant, float yaw);
+float network_bit_read_yaw(NetworkBitReader *reader, const NetworkQuantization *quant);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct _ENetHost;
+
+typedef enum NetworkJitterDistribution {
+    NETWORK_JITTER_UNIFORM = 0,
+    NETWORK_JITTER_NORMAL = 1,
+    NETWORK_JITTER_PARETO = 2,
+} NetworkJitterDistribution;
+
+/* WAN conditions simulated on the datagrams a client or server sends, to
+ * test on loopback (the model is enet_host_simulate's). Each end only shapes
+ * its own traffic, so latency_ms is one way. */
+typedef struct NetworkConditions {
+    uint32_t seed;
+    float latency_ms;
+    float jitter_ms;
+    NetworkJitterDistribution jitter_distribution;
+    float loss;       /* probability, 0..1 */
+    float loss_burst; /* mean datagrams per loss burst; 1 or less for independent losses */
+    float duplicate;  /* probability */
+    float reorder;    /* probability that a datagram is held back by reorder_ms */
+    float reorder_ms;
+} NetworkConditions;
+
+/* Sets one field by name, for command line options and config keys: latency,
+ * jitter, jitter_dist (uniform, normal or pareto), loss, loss_burst,
+ * duplicate, reorder, reorder_ms or seed; dashes may stand for underscores.
+ * False for an unknown name. */
+bool network_conditions_set(NetworkConditions *conditions, const char *name, const char *value);
+
+/* Shapes the host's outgoing datagrams, or stops when `conditions` is NULL. */
+bool network_conditions_apply(struct _ENetHost *host, const NetworkConditions *conditions);
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "engine/network_bitpack.h"
+#include "engine/network_conditions.h"
+
 typedef struct NetworkServer NetworkServer;
 
+/* client ids are one byte on the wire and 0xFF means "none", so one server
+ * instance holds at most 255 players; run more instances in a pool (see
+ * network_server_pool_create) for more */
+#define NETWORK_SERVER_MAX_CLIENTS 255U
+
 typedef enum NetworkVoiceChatMode {
     NETWORK_VOICE_CHAT_PROXIMITY = 0,
     NETWORK_VOICE_CHAT_GLOBAL = 1,
@@ -12,6 +21,7 @@ typedef enum NetworkVoiceChatMode {
 
 typedef struct NetworkServerConfig {
     uint16_t port;
+    /* clamped to NETWORK_SERVER_MAX_CLIENTS, with a warning */
     uint32_t max_clients;
     const char *name;
     const char *public_address;
@@ -22,6 +32,22 @@ typedef struct NetworkServerConfig {
     bool advertise;
     NetworkVoiceChatMode voice_mode;
     float voice_range;
+    float tick_rate;
+    float snapshot_rate;
+    NetworkQuantization quantization;
+    float relevance_radius;
+    /* when set, every datagram sent or received is traced to this file
+     * (see enet_host_capture_start) */
+    const char *capture_path;
+    /* no socket and no master registration: datagrams only arrive through
+     * network_server_inject, e.g. when replaying a capture */
+    bool offline;
+    /* sockets opened on the port with SO_REUSEPORT, each read by its own
+     * thread (see enet_host_create_sharded); 0 or 1 for a single socket */
+    uint32_t receive_shards;
+    /* shape outgoing traffic with `conditions` (ignored when offline) */
+    bool simulate_latency;
+    NetworkConditions conditions;
 } NetworkServerConfig;
 
 typedef struct NetworkServerStats {
@@ -31,10 +57,90 @@ typedef struct NetworkServerStats {
     bool master_registered;
     float master_time_since_contact;
     uint32_t master_failures;
+    uint32_t tick;
+    uint32_t snapshots_sent;
+    /* per-client snapshots skipped on ticks between snapshot ticks */
+    uint32_t snapshots_suppressed;
+    uint32_t snapshots_delta;
+    uint64_t snapshot_bytes_sent;
+    uint64_t snapshot_entities_sent;
+    uint64_t snapshot_entities_deferred;
+    float snapshot_entities_average;
+    uint64_t commands_processed;
+    uint64_t commands_dropped;
+    /* commands received again in a later upload, and those that never
+     * arrived in any (every upload carrying them was lost) */
+    uint64_t commands_redundant;
+    uint64_t commands_lost;
+    /* messages queued to peers vs the datagrams they were coalesced into;
+     * without coalescing every message would be its own datagram */
+    uint64_t messages_sent;
+    uint64_t datagrams_sent;
+    /* how late ticks ran relative to their schedule, from the dt passed in */
+    uint64_t tick_jitter_samples;
+    float tick_jitter_mean_ms;
+    float tick_jitter_stddev_ms;
+    float tick_jitter_max_ms;
+    /* enet packet pool: a miss is a packet that had to be allocated, which
+     * should stop happening once the server has warmed up */
+    uint64_t packet_pool_hits;
+    uint64_t packet_pool_misses;
+    /* smoothed round-trip times of the connected clients, as of the last tick */
+    float rtt_mean_ms;
+    float rtt_max_ms;
+    /* network simulation: datagrams it dropped, and those still held back */
+    uint64_t simulated_drops;
+    uint64_t simulated_queued;
+    /* FIRE events checked with network_server_rewind_raycast, those that hit
+     * a player, and those dropped because the shooter could not have fired */
+    uint64_t shots_validated;
+    uint64_t shots_hit;
+    uint64_t shots_rejected;
+    /* voice packets dropped because their size does not match their header */
+    uint64_t voice_packets_invalid;
 } NetworkServerStats;
 
+typedef struct NetworkServerRewindHit {
+    uint8_t client_id;
+    float distance;
+    float point[3];
+} NetworkServerRewindHit;
+
 NetworkServer *network_server_create(const NetworkServerConfig *config);
 void network_server_destroy(NetworkServer *server);
 
 void network_server_update(NetworkServer *server, float dt);
 const NetworkServerStats *network_server_stats(const NetworkServer *server);
+
+/* Seconds until the server next has work not driven by incoming packets (a
+ * tick while clients are connected, or a master heartbeat). Negative when
+ * nothing is scheduled and the caller may block until a packet arrives. */
+float network_server_next_deadline(const NetworkServer *server);
+
+/* The listening UDP socket, for event loops that wait on it directly. */
+intptr_t network_server_socket(const NetworkServer *server);
+
+/* Offline servers only: queues one captured datagram from trace peer `peer`
+ * for the next network_server_update. Fails when the queue is full. */
+bool network_server_inject(NetworkServer *server, uint32_t peer, const uint8_t *data, size_t size);
+
+/* Smoothed round-trip time to client `client_id` and its variance, in ms, as
+ * measured by the transport. False when no such client is connected. */
+bool network_server_client_rtt(const NetworkServer *server, uint8_t client_id, float *rtt_ms, float *rtt_variance_ms);
+
+/* Simulation time of the latest tick, in seconds (tick * tick interval). */
+double network_server_time(const NetworkServer *server);
+
+/* Casts a ray against player colliders as they were at `timestamp` (server
+ * simulation time the shooter was viewing, roughly the current time minus
+ * half of network_server_client_rtt and the client's interpolation delay). Positions are interpolated
+ * between recorded ticks; timestamps outside the history window clamp to its
+ * ends. `direction` must be unit length. Players with id `ignore_id` are
+ * skipped. Returns true on a hit. */
+bool network_server_rewind_raycast(const NetworkServer *server,
+                                   double timestamp,
+                                   const float origin[3],
+                                   const float direction[3],
+                                   float max_distance,
+                                   uint8_t ignore_id,
+                                   NetworkServerRewindHit *out_hit);
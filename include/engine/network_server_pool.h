@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine/network_server.h"
+
+typedef struct NetworkServerPool NetworkServerPool;
+
+/* Hosts instance_count servers in one process on consecutive ports starting
+ * at base->port; each registers with the master on its own. Instances are
+ * statically assigned to worker_count threads (0 = one per online core,
+ * never more than instance_count), and every worker waits on its instances'
+ * sockets and tick deadlines. */
+NetworkServerPool *network_server_pool_create(const NetworkServerConfig *base,
+                                              uint32_t instance_count,
+                                              uint32_t worker_count);
+void network_server_pool_destroy(NetworkServerPool *pool);
+
+/* Starts the workers, with the calling thread acting as worker 0. Each worker
+ * prints per-instance tick time and jitter every report_interval seconds
+ * (<= 0 disables reports). A fatal error in any worker stops them all; once
+ * this returns false no worker is running and the pool may be destroyed. */
+bool network_server_pool_run(NetworkServerPool *pool, double report_interval);
+
+uint32_t network_server_pool_instance_count(const NetworkServerPool *pool);
+uint32_t network_server_pool_worker_count(const NetworkServerPool *pool);
+NetworkServer *network_server_pool_instance(NetworkServerPool *pool, uint32_t index);
@@ -5,6 +5,10 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+/* gap kept between a resolved collider and what it hit; replicated positions
+ * must round-trip through the network quantization closer than this */
+#define PLAYER_COLLISION_EPSILON 0.0005f
+
 typedef struct PlayerCommand {
     vec3 move_direction;
     float move_magnitude;
@@ -41,6 +45,7 @@ typedef struct GameConfig GameConfig;
 typedef struct GameWorld GameWorld;
 
 // Player management functions
+void player_default_config(GameConfig *config);
 void player_init(PlayerState *player, const GameConfig *config, vec3 start_position);
 void player_reset_command(PlayerCommand *command);
 void player_build_command(PlayerCommand *command,
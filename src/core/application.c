@@ -3,6 +3,7 @@
 #include "engine/renderer.h"
 #include "engine/input.h"
 #include "engine/game.h"
+#include "engine/player.h"
 #include "engine/physics.h"
 #include "engine/ecs.h"
 #include "engine/resources.h"
@@ -1339,23 +1340,8 @@ int engine_run(const EngineConfig *config)
         return -5;
     }
 
-    GameConfig game_config = {
-        .mouse_sensitivity = 1.0f,
-        .move_speed = 5.5f,
-        .sprint_multiplier = 1.6f,
-        .jump_velocity = 6.2f,
-        .gravity = 9.81f,
-        .player_height = 1.7f,
-        .ground_acceleration = 30.0f,
-        .ground_friction = 4.0f,
-        .air_control = 6.0f,
-        .enable_double_jump = true,
-        .double_jump_window = 1.0f,
-        .allow_flight = false,
-        .enable_view_bobbing = true,
-        .view_bobbing_amplitude = 0.035f,
-        .view_bobbing_frequency = 9.0f,
-    };
+    GameConfig game_config;
+    player_default_config(&game_config);
 
     GameState *game = NULL;
 
@@ -3,6 +3,7 @@
 #include "engine/audio.h"
 #include "engine/hud.h"
 #include "engine/network.h"
+#include "engine/network_adpcm.h"
 #include "engine/player.h"
 #include "engine/preferences.h"
 #include "engine/server_browser.h"
@@ -28,6 +29,7 @@
 
 #define GAME_VOICE_CAPTURE_SAMPLES 480U
 #define GAME_VOICE_DEFAULT_SAMPLE_RATE 16000U
+#define GAME_VOICE_CODEC NETWORK_VOICE_CODEC_IMA_ADPCM
 
 struct GameState {
     Renderer *renderer;
@@ -79,26 +81,14 @@ struct GameState {
     int16_t voice_capture_buffer[NETWORK_VOICE_MAX_DATA / sizeof(int16_t)];
     size_t voice_capture_sample_count;
     bool voice_capture_available;
+    NetworkAdpcmState voice_encoder[NETWORK_VOICE_MAX_CHANNELS];
+    NetworkAdpcmState voice_decoders[256][NETWORK_VOICE_MAX_CHANNELS];
 };
 
 static GameConfig game_default_config(void)
 {
     GameConfig config;
-    config.mouse_sensitivity = 1.0f;
-    config.move_speed = 6.0f;
-    config.sprint_multiplier = 1.6f;
-    config.jump_velocity = 6.0f;
-    config.gravity = 9.81f;
-    config.player_height = 1.7f;
-    config.ground_acceleration = 32.0f;
-    config.ground_friction = 4.0f;
-    config.air_control = 6.0f;
-    config.enable_double_jump = true;
-    config.double_jump_window = 1.0f;
-    config.allow_flight = false;
-    config.enable_view_bobbing = true;
-    config.view_bobbing_amplitude = 0.035f;
-    config.view_bobbing_frequency = 9.0f;
+    player_default_config(&config);
     return config;
 }
 
@@ -436,6 +426,32 @@ static void game_send_weapon_pickup_event(GameState *game, uint32_t pickup_id)
     (void)network_client_send_weapon_event(game->network, &event);
 }
 
+static void game_send_weapon_fire_event(GameState *game)
+{
+    if (!game || !game->network) {
+        return;
+    }
+
+    NetworkWeaponEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = NETWORK_WEAPON_EVENT_FIRE;
+    event.weapon_id = (uint16_t)weapon_state_id(&game->weapon);
+    event.ammo_in_clip = (int16_t)game->weapon.ammo_in_clip;
+    event.ammo_reserve = (int16_t)game->weapon.ammo_reserve;
+
+    const vec3 origin = game->camera.position;
+    const vec3 direction = camera_forward(&game->camera);
+    event.position[0] = origin.x;
+    event.position[1] = origin.y;
+    event.position[2] = origin.z;
+    event.direction[0] = direction.x;
+    event.direction[1] = direction.y;
+    event.direction[2] = direction.z;
+    event.view_time = network_client_view_time(game->network);
+
+    (void)network_client_send_weapon_event(game->network, &event);
+}
+
 static void game_drop_current_weapon(GameState *game)
 {
     if (!game) {
@@ -641,6 +657,11 @@ static void game_process_weapon_events(GameState *game)
                 game->pickup_distance = 0.0f;
                 break;
             }
+            case NETWORK_WEAPON_EVENT_FIRE:
+                if (event->hit_id == self_id) {
+                    game->hud.damage_flash = 0.3f;
+                }
+                break;
             default:
                 break;
             }
@@ -669,21 +690,26 @@ static void game_process_voice_packets(GameState *game)
 
         for (size_t i = 0; i < count; ++i) {
             const NetworkVoicePacket *packet = &packets[i];
-            if (!packet || packet->codec != NETWORK_VOICE_CODEC_PCM16 || packet->data_size == 0U) {
-                continue;
-            }
-
-            size_t expected_size = (size_t)packet->frame_count * packet->channels * sizeof(int16_t);
-            if (packet->channels == 0U ||
-                packet->channels > NETWORK_VOICE_MAX_CHANNELS ||
-                expected_size == 0U ||
-                expected_size > NETWORK_VOICE_MAX_DATA ||
-                packet->data_size != expected_size) {
+            size_t expected_size = network_voice_payload_size(packet->codec, packet->frame_count, packet->channels);
+            if (expected_size == 0U || packet->data_size != expected_size) {
                 continue;
             }
 
             int16_t sample_buffer[NETWORK_VOICE_MAX_DATA / sizeof(int16_t)];
-            memcpy(sample_buffer, packet->data, packet->data_size);
+            if (packet->codec == NETWORK_VOICE_CODEC_IMA_ADPCM) {
+                size_t decoded = network_adpcm_decode(game->voice_decoders[packet->speaker_id],
+                                                      packet->channels,
+                                                      packet->data,
+                                                      packet->data_size,
+                                                      packet->frame_count,
+                                                      sample_buffer,
+                                                      sizeof(sample_buffer) / sizeof(sample_buffer[0]));
+                if (decoded == 0U) {
+                    continue;
+                }
+            } else {
+                memcpy(sample_buffer, packet->data, packet->data_size);
+            }
 
             float playback_volume = packet->volume;
             if (playback_volume <= 0.0f) {
@@ -725,6 +751,9 @@ static void game_update_voice_chat(GameState *game, float dt)
         bool started = audio_microphone_start();
         game->voice_capture_available = started;
         game->voice_capture_sample_count = 0U;
+        for (size_t c = 0; c < NETWORK_VOICE_MAX_CHANNELS; ++c) {
+            network_adpcm_state_reset(&game->voice_encoder[c]);
+        }
         if (!started) {
             return;
         }
@@ -791,7 +820,7 @@ static void game_update_voice_chat(GameState *game, float dt)
 
                 if (transmit) {
                     NetworkVoicePacket packet = {0};
-                    packet.codec = NETWORK_VOICE_CODEC_PCM16;
+                    packet.codec = GAME_VOICE_CODEC;
                     packet.channels = audio_microphone_channels();
                     if (packet.channels == 0U || packet.channels > NETWORK_VOICE_MAX_CHANNELS) {
                         packet.channels = 1U;
@@ -810,14 +839,23 @@ static void game_update_voice_chat(GameState *game, float dt)
                     packet.frame_count = (uint16_t)frames;
                     packet.volume = 1.0f;
 
-                    size_t byte_count = total_samples * sizeof(int16_t);
-                    if (byte_count > sizeof(packet.data)) {
-                        byte_count = sizeof(packet.data);
+                    if (packet.codec == NETWORK_VOICE_CODEC_IMA_ADPCM) {
+                        packet.data_size = network_adpcm_encode(game->voice_encoder,
+                                                                packet.channels,
+                                                                game->voice_capture_buffer,
+                                                                packet.frame_count,
+                                                                packet.data,
+                                                                sizeof(packet.data));
+                    } else {
+                        size_t byte_count = total_samples * sizeof(int16_t);
+                        if (byte_count > sizeof(packet.data)) {
+                            byte_count = sizeof(packet.data);
+                        }
+
+                        memcpy(packet.data, game->voice_capture_buffer, byte_count);
+                        packet.data_size = byte_count;
                     }
 
-                    memcpy(packet.data, game->voice_capture_buffer, byte_count);
-                    packet.data_size = byte_count;
-
                     if (!block_network) {
                         (void)network_client_send_voice_packet(game->network, &packet);
                     }
@@ -836,7 +874,7 @@ static void game_synchronize_remote_players(GameState *game)
     }
 
     size_t remote_count = 0;
-    const NetworkRemotePlayer *remote_players = network_client_remote_players(game->network, &remote_count);
+    const NetworkRemotePlayer *remote_players = network_client_interpolated_players(game->network, &remote_count);
     if (!remote_players) {
         remote_count = 0;
     }
@@ -883,6 +921,52 @@ static void game_synchronize_remote_players(GameState *game)
     }
 }
 
+static bool game_send_player_command(GameState *game, float dt, NetworkPlayerCommand *out_command)
+{
+    if (!game || !game->network) {
+        return false;
+    }
+
+    NetworkPlayerCommand command;
+    command.sequence = 0U;
+    command.duration = dt;
+    command.move_direction[0] = game->command.move_direction.x;
+    command.move_direction[1] = game->command.move_direction.y;
+    command.move_direction[2] = game->command.move_direction.z;
+    command.move_magnitude = game->command.move_magnitude;
+    command.vertical_axis = game->command.vertical_axis;
+    command.yaw = game->camera.yaw;
+    command.jump = game->command.jump_requested;
+    command.sprint = game->command.sprint;
+    if (!network_client_send_player_command(game->network, &command)) {
+        return false;
+    }
+    *out_command = command;
+    return true;
+}
+
+/* Online, the command is sent before the local player moves, so the player is
+ * predicted from the command exactly as the server will simulate it.
+ * Otherwise it moves freely. */
+static void game_update_local_player(GameState *game, float dt)
+{
+    PlayerCommand movement = game->command;
+    float step = dt;
+
+    NetworkPlayerCommand command;
+    if (game_send_player_command(game, dt, &command)) {
+        network_player_command_to_input(&command, &movement);
+        step = command.duration;
+    }
+
+    player_update_physics(&game->player,
+                          &movement,
+                          &game->config,
+                          &game->world,
+                          step,
+                          game->player_entity_index);
+}
+
 static void game_update_network(GameState *game, float dt)
 {
     if (!game || !game->network) {
@@ -890,6 +974,7 @@ static void game_update_network(GameState *game, float dt)
     }
 
     network_client_update(game->network, dt);
+    (void)network_client_reconcile(game->network, &game->player, &game->config, &game->world, game->player_entity_index);
     const NetworkClientStats *stats = network_client_stats(game->network);
     if (!stats) {
         return;
@@ -904,13 +989,6 @@ static void game_update_network(GameState *game, float dt)
         return;
     }
 
-    NetworkClientPlayerState player_state;
-    player_state.position[0] = game->player.position.x;
-    player_state.position[1] = game->player.position.y;
-    player_state.position[2] = game->player.position.z;
-    player_state.yaw = game->camera.yaw;
-    (void)network_client_send_player_state(game->network, &player_state);
-
     game_synchronize_remote_players(game);
     game_update_voice_chat(game, dt);
     game_process_voice_packets(game);
@@ -995,7 +1073,7 @@ GameState *game_create(const GameConfig *config, Renderer *renderer, PhysicsWorl
 
     game->network_config.host = game->current_server_address;
     game->network_config.port = game->current_server_port;
-    game->network_config.simulate_latency = true;
+    game->network_config.simulate_latency = false;
 
     game->master_config.host = game->master_server_host;
     game->master_config.port = 27050;
@@ -1185,12 +1263,7 @@ void game_update(GameState *game, float dt)
     game->session_time += (double)dt;
 
     physics_world_step(game->physics, dt);
-    player_update_physics(&game->player,
-                          &game->command,
-                          &game->config,
-                          &game->world,
-                          dt,
-                          game->player_entity_index);
+    game_update_local_player(game, dt);
 
     game_update_weapon_pickups(game);
 
@@ -1204,6 +1277,7 @@ void game_update(GameState *game, float dt)
     WeaponUpdateResult weapon_result = weapon_update(&game->weapon, &weapon_input);
     if (weapon_result.fired) {
         game->hud.damage_flash = 0.3f;
+        game_send_weapon_fire_event(game);
     }
 
     if (game->hud.damage_flash > 0.0f) {
@@ -1876,17 +1950,29 @@ static void game_draw_ui(GameState *game)
 
     /* Top-right network panel */
     const float net_panel_width = 240.0f;
-    renderer_draw_ui_rect(renderer, width - net_panel_width - margin + 12.0f, margin - 20.0f, net_panel_width, 110.0f, 0.05f, 0.05f, 0.07f, 0.68f * hud_alpha);
+    renderer_draw_ui_rect(renderer, width - net_panel_width - margin + 12.0f, margin - 20.0f, net_panel_width, 154.0f, 0.05f, 0.05f, 0.07f, 0.68f * hud_alpha);
     const NetworkClientStats *net_stats = game_network_stats(game);
     if (net_stats) {
         snprintf(buffer, sizeof(buffer), "Connection: %s", net_stats->connected ? "Online" : "Offline");
         renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 0.0f, buffer, 0.85f, 0.95f, 0.85f, 0.95f * hud_alpha);
-        snprintf(buffer, sizeof(buffer), "Ping: %.0f ms", net_stats->simulated_ping_ms);
+        snprintf(buffer, sizeof(buffer), "Ping: %.0f ms", net_stats->ping_ms);
         renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 22.0f, buffer, 0.85f, 0.85f, 0.95f, 0.92f * hud_alpha);
         snprintf(buffer, sizeof(buffer), "Players: %u", net_stats->remote_player_count + 1U);
         renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 44.0f, buffer, 0.85f, 0.85f, 0.95f, 0.92f * hud_alpha);
         snprintf(buffer, sizeof(buffer), "Last packet: %.1fs", net_stats->time_since_last_packet);
         renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 66.0f, buffer, 0.8f, 0.8f, 0.9f, 0.88f * hud_alpha);
+        snprintf(buffer,
+                 sizeof(buffer),
+                 "Interp: %.0f ms, %llu underruns",
+                 net_stats->interpolation_buffer_ms,
+                 (unsigned long long)net_stats->interpolation_underruns);
+        renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 88.0f, buffer, 0.8f, 0.8f, 0.9f, 0.88f * hud_alpha);
+        snprintf(buffer,
+                 sizeof(buffer),
+                 "Pred: %llu fixes, avg %.2f m",
+                 (unsigned long long)net_stats->prediction_corrections,
+                 net_stats->prediction_error_average_m);
+        renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 110.0f, buffer, 0.8f, 0.8f, 0.9f, 0.88f * hud_alpha);
     } else {
         renderer_draw_ui_text(renderer, width - net_panel_width - margin + 24.0f, margin + 16.0f, "Connection: offline", 0.85f, 0.5f, 0.5f, 0.95f * hud_alpha);
     }
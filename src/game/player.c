@@ -13,15 +13,14 @@
 #endif
 
 #define PLAYER_COLLIDER_RADIUS 0.35f
-#define COLLISION_EPSILON 0.0005f
 #define VIEW_BOB_DECAY 9.0f
 #define PLAYER_STEP_EPSILON 0.05f
 
 static bool aabb_intersects(vec3 a_center, vec3 a_half, vec3 b_center, vec3 b_half)
 {
-    return fabsf(a_center.x - b_center.x) <= (a_half.x + b_half.x) + COLLISION_EPSILON &&
-           fabsf(a_center.y - b_center.y) <= (a_half.y + b_half.y) + COLLISION_EPSILON &&
-           fabsf(a_center.z - b_center.z) <= (a_half.z + b_half.z) + COLLISION_EPSILON;
+    return fabsf(a_center.x - b_center.x) <= (a_half.x + b_half.x) + PLAYER_COLLISION_EPSILON &&
+           fabsf(a_center.y - b_center.y) <= (a_half.y + b_half.y) + PLAYER_COLLISION_EPSILON &&
+           fabsf(a_center.z - b_center.z) <= (a_half.z + b_half.z) + PLAYER_COLLISION_EPSILON;
 }
 
 static float *player_velocity_axis(PlayerState *player, int axis)
@@ -94,24 +93,24 @@ static vec3 resolve_axis(PlayerState *player,
         collided = true;
         if (axis == 0) {
             if (delta > 0.0f) {
-                updated.x = entity->position.x - e_half.x - half.x - COLLISION_EPSILON;
+                updated.x = entity->position.x - e_half.x - half.x - PLAYER_COLLISION_EPSILON;
             } else {
-                updated.x = entity->position.x + e_half.x + half.x + COLLISION_EPSILON;
+                updated.x = entity->position.x + e_half.x + half.x + PLAYER_COLLISION_EPSILON;
             }
         } else if (axis == 1) {
             if (delta > 0.0f) {
-                updated.y = entity->position.y - e_half.y - half.y - COLLISION_EPSILON;
+                updated.y = entity->position.y - e_half.y - half.y - PLAYER_COLLISION_EPSILON;
             } else {
-                updated.y = entity->position.y + e_half.y + half.y + COLLISION_EPSILON;
+                updated.y = entity->position.y + e_half.y + half.y + PLAYER_COLLISION_EPSILON;
                 player->grounded = true;
                 player->double_jump_available = config->enable_double_jump;
                 player->double_jump_timer = config->double_jump_window;
             }
         } else {
             if (delta > 0.0f) {
-                updated.z = entity->position.z - e_half.z - half.z - COLLISION_EPSILON;
+                updated.z = entity->position.z - e_half.z - half.z - PLAYER_COLLISION_EPSILON;
             } else {
-                updated.z = entity->position.z + e_half.z + half.z + COLLISION_EPSILON;
+                updated.z = entity->position.z + e_half.z + half.z + PLAYER_COLLISION_EPSILON;
             }
         }
     }
@@ -227,6 +226,34 @@ static void player_process_jump(PlayerState *player,
     }
 }
 
+/* Movement tuning shared by the client and the dedicated server so both
+ * sides run player_update_physics with identical parameters. The values are
+ * the ones engine_run always handed to game_create; the 6.0/6.0/32 set that
+ * game_default_config used to carry only applied to game_create(NULL), which
+ * nothing called, so the tuning players actually ran with is unchanged. */
+void player_default_config(GameConfig *config)
+{
+    if (!config) {
+        return;
+    }
+
+    config->mouse_sensitivity = 1.0f;
+    config->move_speed = 5.5f;
+    config->sprint_multiplier = 1.6f;
+    config->jump_velocity = 6.2f;
+    config->gravity = 9.81f;
+    config->player_height = 1.7f;
+    config->ground_acceleration = 30.0f;
+    config->ground_friction = 4.0f;
+    config->air_control = 6.0f;
+    config->enable_double_jump = true;
+    config->double_jump_window = 1.0f;
+    config->allow_flight = false;
+    config->enable_view_bobbing = true;
+    config->view_bobbing_amplitude = 0.035f;
+    config->view_bobbing_frequency = 9.0f;
+}
+
 void player_init(PlayerState *player, const GameConfig *config, vec3 start_position)
 {
     if (!player || !config) {
@@ -0,0 +1,178 @@
+#include "engine/network_adpcm.h"
+
+#define NETWORK_ADPCM_MAX_STEP_INDEX 88
+
+static const int16_t g_network_adpcm_steps[NETWORK_ADPCM_MAX_STEP_INDEX + 1] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+    25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+    88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+    307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+    1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+    3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t g_network_adpcm_index_adjust[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static int32_t network_adpcm_clamp_sample(int32_t value)
+{
+    if (value > 32767) {
+        return 32767;
+    }
+    if (value < -32768) {
+        return -32768;
+    }
+    return value;
+}
+
+static uint8_t network_adpcm_next_index(uint8_t index, uint8_t nibble)
+{
+    int32_t next = (int32_t)index + g_network_adpcm_index_adjust[nibble & 7U];
+    if (next < 0) {
+        next = 0;
+    } else if (next > NETWORK_ADPCM_MAX_STEP_INDEX) {
+        next = NETWORK_ADPCM_MAX_STEP_INDEX;
+    }
+    return (uint8_t)next;
+}
+
+/* Applies one nibble to the state; shared by the encoder (to track what the
+ * decoder will reconstruct) and the decoder. */
+static int16_t network_adpcm_apply(NetworkAdpcmState *state, uint8_t nibble)
+{
+    int32_t step = g_network_adpcm_steps[state->step_index];
+    int32_t diff = step >> 3;
+    if (nibble & 4U) {
+        diff += step;
+    }
+    if (nibble & 2U) {
+        diff += step >> 1;
+    }
+    if (nibble & 1U) {
+        diff += step >> 2;
+    }
+
+    int32_t predictor = (nibble & 8U) ? state->predictor - diff : state->predictor + diff;
+    state->predictor = (int16_t)network_adpcm_clamp_sample(predictor);
+    state->step_index = network_adpcm_next_index(state->step_index, nibble);
+    return state->predictor;
+}
+
+static uint8_t network_adpcm_encode_sample(NetworkAdpcmState *state, int16_t sample)
+{
+    int32_t step = g_network_adpcm_steps[state->step_index];
+    int32_t diff = (int32_t)sample - state->predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8U;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4U;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2U;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 1U;
+    }
+
+    (void)network_adpcm_apply(state, nibble);
+    return nibble;
+}
+
+void network_adpcm_state_reset(NetworkAdpcmState *state)
+{
+    if (!state) {
+        return;
+    }
+    state->predictor = 0;
+    state->step_index = 0;
+}
+
+size_t network_adpcm_encoded_size(uint16_t frame_count, uint8_t channels)
+{
+    size_t samples = (size_t)frame_count * channels;
+    return (size_t)channels * NETWORK_ADPCM_CHANNEL_HEADER_SIZE + (samples + 1U) / 2U;
+}
+
+size_t network_adpcm_encode(NetworkAdpcmState *states,
+                            uint8_t channels,
+                            const int16_t *samples,
+                            uint16_t frame_count,
+                            uint8_t *out,
+                            size_t out_capacity)
+{
+    if (!states || !samples || !out || channels == 0U) {
+        return 0;
+    }
+
+    size_t encoded_size = network_adpcm_encoded_size(frame_count, channels);
+    if (encoded_size > out_capacity) {
+        return 0;
+    }
+
+    uint8_t *write = out;
+    for (uint8_t c = 0; c < channels; ++c) {
+        uint16_t predictor = (uint16_t)states[c].predictor;
+        write[0] = (uint8_t)(predictor & 0xFF);
+        write[1] = (uint8_t)((predictor >> 8) & 0xFF);
+        write[2] = states[c].step_index;
+        write[3] = 0;
+        write += NETWORK_ADPCM_CHANNEL_HEADER_SIZE;
+    }
+
+    size_t sample_count = (size_t)frame_count * channels;
+    for (size_t i = 0; i < sample_count; i += 2U) {
+        uint8_t low = network_adpcm_encode_sample(&states[i % channels], samples[i]);
+        uint8_t high = 0;
+        if (i + 1U < sample_count) {
+            high = network_adpcm_encode_sample(&states[(i + 1U) % channels], samples[i + 1U]);
+        }
+        *write++ = (uint8_t)(low | (high << 4));
+    }
+
+    return encoded_size;
+}
+
+size_t network_adpcm_decode(NetworkAdpcmState *states,
+                            uint8_t channels,
+                            const uint8_t *data,
+                            size_t size,
+                            uint16_t frame_count,
+                            int16_t *out,
+                            size_t out_capacity)
+{
+    if (!states || !data || !out || channels == 0U) {
+        return 0;
+    }
+
+    size_t sample_count = (size_t)frame_count * channels;
+    if (size != network_adpcm_encoded_size(frame_count, channels) || sample_count > out_capacity) {
+        return 0;
+    }
+
+    const uint8_t *read = data;
+    for (uint8_t c = 0; c < channels; ++c) {
+        if (read[2] > NETWORK_ADPCM_MAX_STEP_INDEX) {
+            return 0;
+        }
+        states[c].predictor = (int16_t)(uint16_t)(read[0] | ((uint16_t)read[1] << 8));
+        states[c].step_index = read[2];
+        read += NETWORK_ADPCM_CHANNEL_HEADER_SIZE;
+    }
+
+    for (size_t i = 0; i < sample_count; i += 2U) {
+        uint8_t byte = *read++;
+        out[i] = network_adpcm_apply(&states[i % channels], (uint8_t)(byte & 0x0F));
+        if (i + 1U < sample_count) {
+            out[i + 1U] = network_adpcm_apply(&states[(i + 1U) % channels], (uint8_t)(byte >> 4));
+        }
+    }
+
+    return sample_count;
+}
@@ -0,0 +1,139 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#endif
+
+#include "engine/network_adpcm.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+#define ADPCMBENCH_SAMPLE_RATE 16000U
+#define ADPCMBENCH_MAX_FRAME_COUNT 4096U
+#define ADPCMBENCH_MAX_CHANNELS 2U
+/* one second of signal, cycled through frame by frame */
+#define ADPCMBENCH_SIGNAL_FRAMES ADPCMBENCH_SAMPLE_RATE
+#define ADPCMBENCH_PI 3.14159265358979323846
+/* packets encoded, then decoded, between two clock reads */
+#define ADPCMBENCH_BATCH 64U
+
+static double adpcmbench_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    unsigned frame_count = 320;
+    unsigned channels = 1;
+    double duration = 2.0;
+
+    // Arguments minimalistes: --frames 320 --channels 1 --duration 2
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frame_count = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--channels") == 0 && i + 1 < argc) channels = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) duration = atof(argv[++i]);
+        else {
+            fprintf(stderr, "usage: adpcmbench [--frames n] [--channels 1|2] [--duration s]\n");
+            return 1;
+        }
+    }
+    if (frame_count == 0 || frame_count > ADPCMBENCH_MAX_FRAME_COUNT) frame_count = 320;
+    if (channels == 0 || channels > ADPCMBENCH_MAX_CHANNELS) channels = 1;
+    if (duration <= 0.0) duration = 2.0;
+
+    size_t signal_samples = (size_t)ADPCMBENCH_SIGNAL_FRAMES * channels;
+    int16_t *signal = (int16_t *)malloc(sizeof(int16_t) * signal_samples);
+    int16_t *decoded = (int16_t *)malloc(sizeof(int16_t) * frame_count * channels);
+    size_t encoded_size = network_adpcm_encoded_size((uint16_t)frame_count, (uint8_t)channels);
+    uint8_t *packets_data = (uint8_t *)malloc(encoded_size * ADPCMBENCH_BATCH);
+    if (!signal || !decoded || !packets_data) {
+        fprintf(stderr, "[adpcmbench] out of memory\n");
+        return 1;
+    }
+
+    // Signal de voix synthétique: trois partiels sous une enveloppe lente
+    for (size_t i = 0; i < ADPCMBENCH_SIGNAL_FRAMES; ++i) {
+        double t = (double)i / (double)ADPCMBENCH_SAMPLE_RATE;
+        double envelope = 0.6 + 0.4 * sin(2.0 * ADPCMBENCH_PI * 3.0 * t);
+        double voice = 0.45 * sin(2.0 * ADPCMBENCH_PI * 220.0 * t) + 0.25 * sin(2.0 * ADPCMBENCH_PI * 1100.0 * t) +
+                       0.1 * sin(2.0 * ADPCMBENCH_PI * 2900.0 * t);
+        for (unsigned c = 0; c < channels; ++c) {
+            signal[i * channels + c] = (int16_t)lrint(16384.0 * envelope * voice);
+        }
+    }
+
+    printf("[adpcmbench] %u frames x %u channel(s) per packet: %zu bytes vs %zu as PCM16 (%.2fx smaller)\n",
+           frame_count,
+           channels,
+           encoded_size,
+           sizeof(int16_t) * frame_count * channels,
+           (double)(sizeof(int16_t) * frame_count * channels) / (double)encoded_size);
+
+    NetworkAdpcmState encoder[ADPCMBENCH_MAX_CHANNELS];
+    NetworkAdpcmState decoder[ADPCMBENCH_MAX_CHANNELS];
+    for (unsigned c = 0; c < ADPCMBENCH_MAX_CHANNELS; ++c) {
+        network_adpcm_state_reset(&encoder[c]);
+        network_adpcm_state_reset(&decoder[c]);
+    }
+
+    size_t position = 0;
+    uint64_t packets = 0;
+    uint64_t checksum = 0;
+    double encode_seconds = 0.0;
+    double decode_seconds = 0.0;
+    double end = adpcmbench_now() + duration;
+    while (adpcmbench_now() < end) {
+        double start = adpcmbench_now();
+        for (size_t p = 0; p < ADPCMBENCH_BATCH; ++p) {
+            if (position + frame_count > ADPCMBENCH_SIGNAL_FRAMES) {
+                position = 0;
+            }
+            checksum += network_adpcm_encode(encoder, (uint8_t)channels, signal + position * channels,
+                                             (uint16_t)frame_count, packets_data + p * encoded_size, encoded_size);
+            position += frame_count;
+        }
+        double middle = adpcmbench_now();
+        for (size_t p = 0; p < ADPCMBENCH_BATCH; ++p) {
+            checksum += network_adpcm_decode(decoder, (uint8_t)channels, packets_data + p * encoded_size, encoded_size,
+                                             (uint16_t)frame_count, decoded, (size_t)frame_count * channels);
+            checksum += (uint16_t)decoded[frame_count * channels - 1];
+        }
+        double stop = adpcmbench_now();
+        encode_seconds += middle - start;
+        decode_seconds += stop - middle;
+        packets += ADPCMBENCH_BATCH;
+    }
+
+    double samples = (double)packets * (double)frame_count * (double)channels;
+    double realtime = (double)ADPCMBENCH_SAMPLE_RATE * (double)channels;
+    printf("[adpcmbench] %llu packets: encode %.1f Msamples/s (%.0fx real time), decode %.1f Msamples/s (%.0fx real time)"
+           " (checksum %llu)\n",
+           (unsigned long long)packets,
+           samples / encode_seconds * 1e-6,
+           samples / encode_seconds / realtime,
+           samples / decode_seconds * 1e-6,
+           samples / decode_seconds / realtime,
+           (unsigned long long)checksum);
+
+    free(signal);
+    free(decoded);
+    free(packets_data);
+    return 0;
+}
@@ -0,0 +1,364 @@
+#include "engine/network_bitpack.h"
+
+#include "engine/network.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+
+#define NETWORK_QUANT_MAX_BITS 24U
+
+/* 1024 m x 256 m x 1024 m at ~0.5 mm resolution, so the round-trip error
+ * (<= 0.25 mm plus float rounding) stays below PLAYER_COLLISION_EPSILON */
+#define NETWORK_QUANT_DEFAULT_HALF_EXTENT 512.0f
+#define NETWORK_QUANT_DEFAULT_MIN_Y -64.0f
+#define NETWORK_QUANT_DEFAULT_MAX_Y 192.0f
+#define NETWORK_QUANT_DEFAULT_XZ_BITS 21U
+#define NETWORK_QUANT_DEFAULT_Y_BITS 19U
+#define NETWORK_QUANT_DEFAULT_YAW_BITS 12U
+
+/* command durations travel in quarter milliseconds, capped at ~255 ms */
+#define NETWORK_COMMAND_DURATION_BITS 10U
+#define NETWORK_COMMAND_DURATION_MAX 1023U
+#define NETWORK_COMMAND_DURATION_UNITS_PER_SECOND 4000.0f
+#define NETWORK_COMMAND_MAGNITUDE_RANGE 2.0f
+
+void network_bit_writer_init(NetworkBitWriter *writer, uint8_t *data, size_t capacity)
+{
+    if (!writer) {
+        return;
+    }
+
+    writer->data = data;
+    writer->capacity = data ? capacity : 0;
+    writer->bit_position = 0;
+    writer->overflow = false;
+}
+
+void network_bit_write(NetworkBitWriter *writer, uint32_t value, unsigned bits)
+{
+    if (!writer || bits == 0U || bits > 32U) {
+        return;
+    }
+
+    if (writer->bit_position + bits > writer->capacity * 8U) {
+        writer->overflow = true;
+        return;
+    }
+
+    for (unsigned i = 0; i < bits; ++i) {
+        size_t byte = writer->bit_position >> 3;
+        unsigned shift = (unsigned)(writer->bit_position & 7U);
+        if (shift == 0U) {
+            writer->data[byte] = 0;
+        }
+        if ((value >> i) & 1U) {
+            writer->data[byte] |= (uint8_t)(1U << shift);
+        }
+        ++writer->bit_position;
+    }
+}
+
+size_t network_bit_writer_bytes(const NetworkBitWriter *writer)
+{
+    return writer ? (writer->bit_position + 7U) / 8U : 0;
+}
+
+void network_bit_reader_init(NetworkBitReader *reader, const uint8_t *data, size_t size)
+{
+    if (!reader) {
+        return;
+    }
+
+    reader->data = data;
+    reader->size = data ? size : 0;
+    reader->bit_position = 0;
+    reader->overflow = false;
+}
+
+uint32_t network_bit_read(NetworkBitReader *reader, unsigned bits)
+{
+    if (!reader || bits == 0U || bits > 32U) {
+        return 0;
+    }
+
+    if (reader->bit_position + bits > reader->size * 8U) {
+        reader->overflow = true;
+        reader->bit_position = reader->size * 8U;
+        return 0;
+    }
+
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bits; ++i) {
+        size_t byte = reader->bit_position >> 3;
+        unsigned shift = (unsigned)(reader->bit_position & 7U);
+        if ((reader->data[byte] >> shift) & 1U) {
+            value |= (uint32_t)1U << i;
+        }
+        ++reader->bit_position;
+    }
+    return value;
+}
+
+size_t network_bit_reader_bytes(const NetworkBitReader *reader)
+{
+    return reader ? (reader->bit_position + 7U) / 8U : 0;
+}
+
+void network_quantization_default(NetworkQuantization *quant)
+{
+    if (!quant) {
+        return;
+    }
+
+    quant->world_min[0] = -NETWORK_QUANT_DEFAULT_HALF_EXTENT;
+    quant->world_min[1] = NETWORK_QUANT_DEFAULT_MIN_Y;
+    quant->world_min[2] = -NETWORK_QUANT_DEFAULT_HALF_EXTENT;
+    quant->world_max[0] = NETWORK_QUANT_DEFAULT_HALF_EXTENT;
+    quant->world_max[1] = NETWORK_QUANT_DEFAULT_MAX_Y;
+    quant->world_max[2] = NETWORK_QUANT_DEFAULT_HALF_EXTENT;
+    quant->position_bits[0] = NETWORK_QUANT_DEFAULT_XZ_BITS;
+    quant->position_bits[1] = NETWORK_QUANT_DEFAULT_Y_BITS;
+    quant->position_bits[2] = NETWORK_QUANT_DEFAULT_XZ_BITS;
+    quant->yaw_bits = NETWORK_QUANT_DEFAULT_YAW_BITS;
+}
+
+bool network_quantization_valid(const NetworkQuantization *quant)
+{
+    if (!quant) {
+        return false;
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (!(quant->world_max[axis] > quant->world_min[axis])) {
+            return false;
+        }
+        if (quant->position_bits[axis] == 0U || quant->position_bits[axis] > NETWORK_QUANT_MAX_BITS) {
+            return false;
+        }
+    }
+
+    return quant->yaw_bits > 0U && quant->yaw_bits <= 16U;
+}
+
+float network_quantization_position_step(const NetworkQuantization *quant, int axis)
+{
+    if (!quant || axis < 0 || axis > 2 || quant->position_bits[axis] == 0U) {
+        return 0.0f;
+    }
+
+    uint32_t max_value = (1U << quant->position_bits[axis]) - 1U;
+    return (quant->world_max[axis] - quant->world_min[axis]) / (float)max_value;
+}
+
+size_t network_quantization_write(const NetworkQuantization *quant, uint8_t *out, size_t capacity)
+{
+    if (!quant || !out || capacity < NETWORK_QUANTIZATION_WIRE_SIZE) {
+        return 0;
+    }
+
+    memcpy(out, quant->world_min, sizeof(float) * 3);
+    memcpy(out + sizeof(float) * 3, quant->world_max, sizeof(float) * 3);
+    out[sizeof(float) * 6] = quant->position_bits[0];
+    out[sizeof(float) * 6 + 1] = quant->position_bits[1];
+    out[sizeof(float) * 6 + 2] = quant->position_bits[2];
+    out[sizeof(float) * 6 + 3] = quant->yaw_bits;
+    return NETWORK_QUANTIZATION_WIRE_SIZE;
+}
+
+bool network_quantization_read(NetworkQuantization *quant, const uint8_t *data, size_t size)
+{
+    if (!quant || !data || size < NETWORK_QUANTIZATION_WIRE_SIZE) {
+        return false;
+    }
+
+    NetworkQuantization parsed;
+    memcpy(parsed.world_min, data, sizeof(float) * 3);
+    memcpy(parsed.world_max, data + sizeof(float) * 3, sizeof(float) * 3);
+    parsed.position_bits[0] = data[sizeof(float) * 6];
+    parsed.position_bits[1] = data[sizeof(float) * 6 + 1];
+    parsed.position_bits[2] = data[sizeof(float) * 6 + 2];
+    parsed.yaw_bits = data[sizeof(float) * 6 + 3];
+    if (!network_quantization_valid(&parsed)) {
+        return false;
+    }
+
+    *quant = parsed;
+    return true;
+}
+
+uint32_t network_quantize_position(const NetworkQuantization *quant, int axis, float value)
+{
+    if (!quant || axis < 0 || axis > 2) {
+        return 0;
+    }
+
+    uint32_t max_value = (1U << quant->position_bits[axis]) - 1U;
+    float min = quant->world_min[axis];
+    float max = quant->world_max[axis];
+    if (!(value > min)) {
+        return 0;
+    }
+    if (value >= max) {
+        return max_value;
+    }
+
+    float normalized = (value - min) / (max - min);
+    return (uint32_t)lroundf(normalized * (float)max_value);
+}
+
+float network_dequantize_position(const NetworkQuantization *quant, int axis, uint32_t value)
+{
+    if (!quant || axis < 0 || axis > 2) {
+        return 0.0f;
+    }
+
+    uint32_t max_value = (1U << quant->position_bits[axis]) - 1U;
+    if (value > max_value) {
+        value = max_value;
+    }
+
+    float min = quant->world_min[axis];
+    float max = quant->world_max[axis];
+    return min + (max - min) * ((float)value / (float)max_value);
+}
+
+uint32_t network_quantize_yaw(const NetworkQuantization *quant, float yaw)
+{
+    if (!quant || !isfinite(yaw)) {
+        return 0;
+    }
+
+    const float two_pi = (float)(M_PI * 2.0);
+    float wrapped = fmodf(yaw, two_pi);
+    if (wrapped < 0.0f) {
+        wrapped += two_pi;
+    }
+
+    uint32_t steps = 1U << quant->yaw_bits;
+    uint32_t value = (uint32_t)lroundf(wrapped / two_pi * (float)steps);
+    return value & (steps - 1U);
+}
+
+float network_dequantize_yaw(const NetworkQuantization *quant, uint32_t value)
+{
+    if (!quant) {
+        return 0.0f;
+    }
+
+    uint32_t steps = 1U << quant->yaw_bits;
+    return (float)(value & (steps - 1U)) * ((float)(M_PI * 2.0) / (float)steps);
+}
+
+void network_bit_write_position(NetworkBitWriter *writer, const NetworkQuantization *quant, const float position[3])
+{
+    if (!writer || !quant || !position) {
+        return;
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+        network_bit_write(writer, network_quantize_position(quant, axis, position[axis]), quant->position_bits[axis]);
+    }
+}
+
+void network_bit_read_position(NetworkBitReader *reader, const NetworkQuantization *quant, float position[3])
+{
+    if (!reader || !quant || !position) {
+        return;
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+        position[axis] = network_dequantize_position(quant, axis, network_bit_read(reader, quant->position_bits[axis]));
+    }
+}
+
+void network_bit_write_yaw(NetworkBitWriter *writer, const NetworkQuantization *quant, float yaw)
+{
+    if (!writer || !quant) {
+        return;
+    }
+
+    network_bit_write(writer, network_quantize_yaw(quant, yaw), quant->yaw_bits);
+}
+
+float network_bit_read_yaw(NetworkBitReader *reader, const NetworkQuantization *quant)
+{
+    if (!reader || !quant) {
+        return 0.0f;
+    }
+
+    return network_dequantize_yaw(quant, network_bit_read(reader, quant->yaw_bits));
+}
+
+void network_player_command_write(NetworkBitWriter *writer,
+                                  const NetworkQuantization *quant,
+                                  const NetworkPlayerCommand *command)
+{
+    if (!writer || !quant || !command) {
+        return;
+    }
+
+    float duration = command->duration > 0.0f ? command->duration : 0.0f;
+    uint32_t duration_units = (uint32_t)lroundf(duration * NETWORK_COMMAND_DURATION_UNITS_PER_SECOND);
+    if (duration_units > NETWORK_COMMAND_DURATION_MAX) {
+        duration_units = NETWORK_COMMAND_DURATION_MAX;
+    }
+
+    float magnitude = command->move_magnitude;
+    if (!(magnitude > 0.0f)) {
+        magnitude = 0.0f;
+    } else if (magnitude > NETWORK_COMMAND_MAGNITUDE_RANGE) {
+        magnitude = NETWORK_COMMAND_MAGNITUDE_RANGE;
+    }
+    uint32_t magnitude_bits = (uint32_t)lroundf(magnitude / NETWORK_COMMAND_MAGNITUDE_RANGE * 255.0f);
+
+    float vertical = command->vertical_axis;
+    if (!(vertical > -1.0f)) {
+        vertical = -1.0f;
+    } else if (vertical > 1.0f) {
+        vertical = 1.0f;
+    }
+
+    network_bit_write(writer, command->sequence, 32);
+    network_bit_write(writer, duration_units, NETWORK_COMMAND_DURATION_BITS);
+    network_bit_write(writer, magnitude_bits, 8);
+    if (magnitude_bits != 0U) {
+        float heading = atan2f(command->move_direction[2], command->move_direction[0]);
+        network_bit_write(writer, network_quantize_yaw(quant, heading), quant->yaw_bits);
+    }
+    network_bit_write(writer, (uint32_t)lroundf((vertical + 1.0f) * 127.0f), 8);
+    network_bit_write_yaw(writer, quant, command->yaw);
+    network_bit_write(writer, command->jump ? 1U : 0U, 1);
+    network_bit_write(writer, command->sprint ? 1U : 0U, 1);
+}
+
+bool network_player_command_read(NetworkBitReader *reader,
+                                 const NetworkQuantization *quant,
+                                 NetworkPlayerCommand *command)
+{
+    if (!reader || !quant || !command) {
+        return false;
+    }
+
+    memset(command, 0, sizeof(*command));
+    command->sequence = network_bit_read(reader, 32);
+    command->duration = (float)network_bit_read(reader, NETWORK_COMMAND_DURATION_BITS) /
+                        NETWORK_COMMAND_DURATION_UNITS_PER_SECOND;
+
+    uint32_t magnitude_bits = network_bit_read(reader, 8);
+    command->move_magnitude = (float)magnitude_bits / 255.0f * NETWORK_COMMAND_MAGNITUDE_RANGE;
+    if (magnitude_bits != 0U) {
+        float heading = network_bit_read_yaw(reader, quant);
+        command->move_direction[0] = cosf(heading);
+        command->move_direction[2] = sinf(heading);
+    }
+    command->vertical_axis = (float)network_bit_read(reader, 8) / 127.0f - 1.0f;
+    command->yaw = network_bit_read_yaw(reader, quant);
+    command->jump = network_bit_read(reader, 1) != 0U;
+    command->sprint = network_bit_read(reader, 1) != 0U;
+
+    return !reader->overflow;
+}
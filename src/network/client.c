@@ -1,5 +1,12 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#    define _POSIX_C_SOURCE 200809L /* getaddrinfo */
+#endif
+
 #include "engine/network.h"
+#include "engine/network_bitpack.h"
+#include "engine/player.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,22 +18,107 @@
 #    include <winsock2.h>
 #    include <ws2tcpip.h>
 #    include <windows.h>
+#else
+#    include <arpa/inet.h>
+#    include <netdb.h>
+#    include <netinet/in.h>
+#    include <sys/socket.h>
 #endif
 
 #define NETWORK_MESSAGE_HELLO 0x01
 #define NETWORK_MESSAGE_WELCOME 0x02
 #define NETWORK_MESSAGE_PLAYER_COUNT 0x03
-#define NETWORK_MESSAGE_CLIENT_STATE 0x04
 #define NETWORK_MESSAGE_SERVER_SNAPSHOT 0x05
 #define NETWORK_MESSAGE_WEAPON_EVENT 0x06
 #define NETWORK_MESSAGE_CLIENT_WEAPON_EVENT 0x07
 #define NETWORK_MESSAGE_CLIENT_VOICE_DATA 0x08
 #define NETWORK_MESSAGE_VOICE_DATA 0x09
-
-#define NETWORK_WEAPON_EVENT_DATA_SIZE (1 + sizeof(uint16_t) + sizeof(int16_t) + sizeof(int16_t) + sizeof(uint32_t) + (sizeof(float) * 3))
+#define NETWORK_MESSAGE_SNAPSHOT_ACK 0x0A
+#define NETWORK_MESSAGE_CLIENT_COMMAND 0x0B
+#define NETWORK_MESSAGE_BUNDLE 0x0C
+#define NETWORK_MESSAGE_PLAYER_STATE 0x0D
+
+#define NETWORK_BUNDLE_LENGTH_SIZE 2
+
+#define NETWORK_CLIENT_COMMAND_MAX_SIZE 16
+
+/* [type][command sequence u32][position f32 x3][velocity f32 x3][flags][double jump timer f32] */
+#define NETWORK_PLAYER_STATE_SIZE (1 + 4 + 12 + 12 + 1 + 4)
+#define NETWORK_PLAYER_STATE_GROUNDED 0x01
+#define NETWORK_PLAYER_STATE_DOUBLE_JUMP 0x02
+/* commands kept for replay until the server has simulated them; about a
+ * second at 240 Hz */
+#define NETWORK_CLIENT_PENDING_COMMANDS 256
+/* commands are uploaded in batches at config.command_rate, each upload also
+ * repeating the pending commands of the previous NETWORK_CLIENT_COMMAND_REDUNDANCY */
+#define NETWORK_CLIENT_DEFAULT_COMMAND_RATE 60.0f
+#define NETWORK_CLIENT_COMMAND_REDUNDANCY 2
+#define NETWORK_CLIENT_MAX_UPLOAD_COMMANDS 32
+/* reconciliations that move the local player less than this are not corrections */
+#define NETWORK_CLIENT_CORRECTION_EPSILON 0.001f
+
+#define NETWORK_WEAPON_EVENT_DATA_SIZE (1 + sizeof(uint16_t) + sizeof(int16_t) + sizeof(int16_t) + sizeof(uint32_t) + (sizeof(float) * 6) + sizeof(double) + 1)
 
 #define NETWORK_CLIENT_WEAPON_EVENT_CAPACITY 64
 #define NETWORK_CLIENT_VOICE_PACKET_CAPACITY 64
+#define NETWORK_CLIENT_SNAPSHOT_HISTORY 32
+
+/* [type][sequence u16][baseline u16][flags][count][tick u32] */
+#define NETWORK_SNAPSHOT_HEADER_SIZE 11
+#define NETWORK_SNAPSHOT_FLAG_DELTA 0x01
+#define NETWORK_SNAPSHOT_FIELD_POS_X 0x01
+#define NETWORK_SNAPSHOT_FIELD_POS_Y 0x02
+#define NETWORK_SNAPSHOT_FIELD_POS_Z 0x04
+#define NETWORK_SNAPSHOT_FIELD_YAW 0x08
+#define NETWORK_SNAPSHOT_FIELD_NAME 0x10
+#define NETWORK_SNAPSHOT_FIELD_BITS 5
+#define NETWORK_SNAPSHOT_NAME_LENGTH_BITS 4
+
+/* remote players are drawn from a per-player buffer of recent snapshot
+ * states, some time behind the newest one */
+#define NETWORK_CLIENT_INTERPOLATION_SAMPLES 16
+#define NETWORK_CLIENT_DEFAULT_INTERPOLATION_DELAY_MS 100.0f
+#define NETWORK_CLIENT_MAX_EXTRAPOLATION 0.25
+/* the server clock estimate follows snapshot times by this fraction of the
+ * error, and jumps when it is off by more than NETWORK_CLIENT_CLOCK_RESET */
+#define NETWORK_CLIENT_CLOCK_CORRECTION 0.1
+#define NETWORK_CLIENT_CLOCK_RESET 0.5
+#define NETWORK_CLIENT_DEFAULT_TICK_INTERVAL (1.0 / 60.0)
+#define NETWORK_CLIENT_NO_TRACK 0xFF
+
+typedef struct NetworkClientSnapshotFrame {
+    uint16_t sequence;
+    uint8_t count;
+    int valid;
+    NetworkRemotePlayer entities[NETWORK_MAX_REMOTE_PLAYERS];
+} NetworkClientSnapshotFrame;
+
+typedef struct NetworkClientStateSample {
+    double time; /* server time, seconds */
+    float position[3];
+    float yaw;
+} NetworkClientStateSample;
+
+/* buffered states of one remote player, oldest first */
+typedef struct NetworkClientTrack {
+    bool in_use;
+    bool present; /* in the newest snapshot */
+    uint8_t id;
+    char name[NETWORK_MAX_PLAYER_NAME];
+    NetworkClientStateSample samples[NETWORK_CLIENT_INTERPOLATION_SAMPLES];
+    size_t head;
+    size_t count;
+} NetworkClientTrack;
+
+/* the local player as the server last simulated it */
+typedef struct NetworkClientPlayerState {
+    uint32_t command_sequence; /* newest command simulated, 0 for none */
+    float position[3];
+    float velocity[3];
+    bool grounded;
+    bool double_jump_available;
+    float double_jump_timer;
+} NetworkClientPlayerState;
 
 typedef struct NetworkClient {
     NetworkClientConfig config;
@@ -38,7 +130,6 @@ typedef struct NetworkClient {
     uint8_t self_id;
     double time_since_last_packet;
     double handshake_timer;
-    double handshake_start;
     int connecting;
     NetworkWeaponEvent weapon_events[NETWORK_CLIENT_WEAPON_EVENT_CAPACITY];
     size_t weapon_event_head;
@@ -46,23 +137,38 @@ typedef struct NetworkClient {
     NetworkVoicePacket voice_packets[NETWORK_CLIENT_VOICE_PACKET_CAPACITY];
     size_t voice_packet_head;
     size_t voice_packet_count;
+    NetworkClientSnapshotFrame snapshot_history[NETWORK_CLIENT_SNAPSHOT_HISTORY];
+    uint16_t latest_snapshot_sequence;
+    int has_snapshot;
+    NetworkQuantization quantization;
+    uint32_t next_command_sequence;
+    /* snapshot interpolation */
+    NetworkClientTrack tracks[NETWORK_MAX_REMOTE_PLAYERS];
+    uint8_t track_by_id[256];
+    double tick_interval;
+    double interpolation_delay;
+    double server_time; /* estimate, advanced by dt between snapshots */
+    double newest_snapshot_time;
+    int has_server_time;
+    NetworkRemotePlayer interpolated_players[NETWORK_MAX_REMOTE_PLAYERS];
+    size_t interpolated_count;
+    /* local player prediction: sent commands the server has not simulated
+     * yet, oldest first, and the newest authoritative state */
+    NetworkPlayerCommand pending_commands[NETWORK_CLIENT_PENDING_COMMANDS];
+    size_t pending_head;
+    size_t pending_count;
+    NetworkClientPlayerState player_state;
+    int has_player_state; /* until network_client_reconcile applies it */
+    double correction_error_sum;
+    /* command uploads */
+    double command_interval;
+    double command_timer; /* seconds since the last upload */
+    uint32_t next_upload_sequence; /* oldest command not uploaded yet */
+    uint32_t upload_starts[NETWORK_CLIENT_COMMAND_REDUNDANCY]; /* first new command of the last uploads, oldest first */
 } NetworkClient;
 
 static int g_enet_client_refcount = 0;
 
-static double network_get_time_seconds(void)
-{
-#ifdef _WIN32
-    LARGE_INTEGER counter;
-    LARGE_INTEGER freq;
-    QueryPerformanceCounter(&counter);
-    QueryPerformanceFrequency(&freq);
-    return (double)counter.QuadPart / (double)freq.QuadPart;
-#else
-    return 0.0;
-#endif
-}
-
 static uint32_t network_resolve_ipv4(const char *host)
 {
     if (!host || host[0] == '\0') {
@@ -102,6 +208,44 @@ static void network_client_clear_remote_players(NetworkClient *client)
     client->stats.remote_player_count = 0;
 }
 
+static void network_client_clear_snapshots(NetworkClient *client)
+{
+    if (!client) {
+        return;
+    }
+
+    memset(client->snapshot_history, 0, sizeof(client->snapshot_history));
+    client->latest_snapshot_sequence = 0;
+    client->has_snapshot = 0;
+
+    memset(client->tracks, 0, sizeof(client->tracks));
+    memset(client->track_by_id, NETWORK_CLIENT_NO_TRACK, sizeof(client->track_by_id));
+    client->server_time = 0.0;
+    client->newest_snapshot_time = 0.0;
+    client->has_server_time = 0;
+    client->interpolated_count = 0;
+}
+
+static void network_client_clear_prediction(NetworkClient *client)
+{
+    if (!client) {
+        return;
+    }
+
+    client->pending_head = 0;
+    client->pending_count = 0;
+    memset(&client->player_state, 0, sizeof(client->player_state));
+    client->has_player_state = 0;
+    client->stats.prediction_pending_commands = 0;
+
+    /* the first command goes out as soon as it is queued */
+    client->command_timer = client->command_interval;
+    client->next_upload_sequence = 1U;
+    for (size_t i = 0; i < NETWORK_CLIENT_COMMAND_REDUNDANCY; ++i) {
+        client->upload_starts[i] = 1U;
+    }
+}
+
 static void network_client_clear_weapon_events(NetworkClient *client)
 {
     if (!client) {
@@ -156,51 +300,380 @@ static void network_client_enqueue_weapon_event(NetworkClient *client, const Net
     ++client->weapon_event_count;
 }
 
-static void network_client_handle_snapshot(NetworkClient *client, const enet_uint8 *data, size_t size)
+static NetworkClientSnapshotFrame *network_client_find_snapshot(NetworkClient *client, uint16_t sequence)
+{
+    NetworkClientSnapshotFrame *frame = &client->snapshot_history[sequence % NETWORK_CLIENT_SNAPSHOT_HISTORY];
+    if (!frame->valid || frame->sequence != sequence) {
+        return NULL;
+    }
+    return frame;
+}
+
+/* Sends now rather than at the next update, since the transport may hold
+ * sends until it is serviced. The packet is freed if it could not be sent. */
+static bool network_client_send_now(NetworkClient *client, ENetPacket *packet)
 {
-    if (!client || !data || size < 2) {
+    if (enet_peer_send(client->peer, 0, packet) != 0) {
+        enet_packet_destroy(packet);
+        return false;
+    }
+    enet_host_flush(client->host);
+    return true;
+}
+
+static void network_client_send_snapshot_ack(NetworkClient *client, uint16_t sequence)
+{
+    if (!client || !client->peer) {
         return;
     }
 
-    const size_t header_size = 2;
-    const size_t stride = 1 + (sizeof(float) * 4) + NETWORK_MAX_PLAYER_NAME;
-    uint8_t reported_count = data[1];
-    size_t offset = header_size;
+    enet_uint8 payload[3];
+    payload[0] = NETWORK_MESSAGE_SNAPSHOT_ACK;
+    payload[1] = (enet_uint8)(sequence & 0xFF);
+    payload[2] = (enet_uint8)((sequence >> 8) & 0xFF);
 
+    ENetPacket *packet = enet_packet_create(payload, sizeof(payload), 0);
+    if (packet && enet_peer_send(client->peer, 0, packet) != 0) {
+        enet_packet_destroy(packet);
+    }
+}
+
+static void network_client_apply_snapshot_frame(NetworkClient *client, const NetworkClientSnapshotFrame *frame)
+{
     network_client_clear_remote_players(client);
 
     size_t stored = 0;
-    for (uint8_t i = 0; i < reported_count; ++i) {
-        if (offset + stride > size) {
+    for (uint8_t i = 0; i < frame->count && stored < NETWORK_MAX_REMOTE_PLAYERS; ++i) {
+        client->remote_players[stored++] = frame->entities[i];
+    }
+    client->remote_player_count = stored;
+
+    uint32_t remote_count = 0;
+    for (size_t i = 0; i < stored; ++i) {
+        const NetworkRemotePlayer *rp = &client->remote_players[i];
+        if (rp->active && rp->id != client->self_id) {
+            ++remote_count;
+        }
+    }
+    client->stats.remote_player_count = remote_count;
+}
+
+static const NetworkClientStateSample *network_client_track_sample(const NetworkClientTrack *track, size_t index)
+{
+    return &track->samples[(track->head + index) % NETWORK_CLIENT_INTERPOLATION_SAMPLES];
+}
+
+/* The track of player `id`, taking a free one or else the one of the player
+ * that left the snapshots longest ago. NULL when all are in use. */
+static NetworkClientTrack *network_client_find_track(NetworkClient *client, uint8_t id)
+{
+    uint8_t index = client->track_by_id[id];
+    if (index != NETWORK_CLIENT_NO_TRACK) {
+        return &client->tracks[index];
+    }
+
+    size_t chosen = NETWORK_MAX_REMOTE_PLAYERS;
+    double chosen_time = 0.0;
+    for (size_t i = 0; i < NETWORK_MAX_REMOTE_PLAYERS; ++i) {
+        const NetworkClientTrack *track = &client->tracks[i];
+        if (!track->in_use) {
+            chosen = i;
             break;
         }
+        if (track->present || track->count == 0) {
+            continue;
+        }
+        double newest = network_client_track_sample(track, track->count - 1)->time;
+        if (chosen == NETWORK_MAX_REMOTE_PLAYERS || newest < chosen_time) {
+            chosen = i;
+            chosen_time = newest;
+        }
+    }
+    if (chosen == NETWORK_MAX_REMOTE_PLAYERS) {
+        return NULL;
+    }
 
-        const enet_uint8 *entry = data + offset;
-        offset += stride;
+    NetworkClientTrack *track = &client->tracks[chosen];
+    if (track->in_use) {
+        client->track_by_id[track->id] = NETWORK_CLIENT_NO_TRACK;
+    }
+    memset(track, 0, sizeof(*track));
+    track->in_use = true;
+    track->id = id;
+    client->track_by_id[id] = (uint8_t)chosen;
+    return track;
+}
+
+/* Adds the snapshot's states to the players' buffers and steers the server
+ * clock estimate towards the snapshot's time. Deferred entities carry values
+ * from an earlier snapshot that are already buffered at their own time, so
+ * they only keep their player present; the track interpolates across the
+ * gap between its real samples. */
+static void network_client_buffer_snapshot(NetworkClient *client,
+                                           const NetworkClientSnapshotFrame *frame,
+                                           const bool *deferred,
+                                           uint32_t tick)
+{
+    double time = (double)tick * client->tick_interval;
+    if (!client->has_server_time || fabs(time - client->server_time) > NETWORK_CLIENT_CLOCK_RESET) {
+        client->server_time = time;
+        client->has_server_time = 1;
+    } else {
+        client->server_time += (time - client->server_time) * NETWORK_CLIENT_CLOCK_CORRECTION;
+    }
+    client->newest_snapshot_time = time;
 
-        if (stored >= NETWORK_MAX_REMOTE_PLAYERS) {
+    for (size_t i = 0; i < NETWORK_MAX_REMOTE_PLAYERS; ++i) {
+        client->tracks[i].present = false;
+    }
+
+    for (uint8_t i = 0; i < frame->count; ++i) {
+        const NetworkRemotePlayer *entity = &frame->entities[i];
+        if (!entity->active || entity->id == client->self_id) {
+            continue;
+        }
+        NetworkClientTrack *track = network_client_find_track(client, entity->id);
+        if (!track) {
+            continue;
+        }
+        track->present = true;
+        memcpy(track->name, entity->name, sizeof(track->name));
+        if (deferred[i] && track->count > 0) {
             continue;
         }
 
-        NetworkRemotePlayer *dst = &client->remote_players[stored++];
-        dst->id = entry[0];
-        memcpy(dst->position, entry + 1, sizeof(float) * 3);
-        memcpy(&dst->yaw, entry + 1 + sizeof(float) * 3, sizeof(float));
-        memcpy(dst->name, entry + 1 + sizeof(float) * 4, NETWORK_MAX_PLAYER_NAME);
-        dst->name[NETWORK_MAX_PLAYER_NAME - 1] = '\0';
-        dst->active = true;
+        if (track->count == NETWORK_CLIENT_INTERPOLATION_SAMPLES) {
+            track->head = (track->head + 1) % NETWORK_CLIENT_INTERPOLATION_SAMPLES;
+            --track->count;
+        }
+        NetworkClientStateSample *sample = &track->samples[(track->head + track->count) % NETWORK_CLIENT_INTERPOLATION_SAMPLES];
+        sample->time = time;
+        memcpy(sample->position, entity->position, sizeof(sample->position));
+        sample->yaw = entity->yaw;
+        ++track->count;
     }
+}
 
-    client->remote_player_count = stored;
+/* `t` past 1 extrapolates. Yaw turns the short way round. */
+static void network_client_blend(const NetworkClientStateSample *a,
+                                 const NetworkClientStateSample *b,
+                                 float t,
+                                 NetworkRemotePlayer *out)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        out->position[axis] = a->position[axis] + (b->position[axis] - a->position[axis]) * t;
+    }
 
-    uint32_t remote_count = 0;
-    for (size_t i = 0; i < stored; ++i) {
-        const NetworkRemotePlayer *rp = &client->remote_players[i];
-        if (rp->active && rp->id != client->self_id) {
-            ++remote_count;
+    const float two_pi = 6.28318531f;
+    float delta = fmodf(b->yaw - a->yaw + 3.14159265f, two_pi);
+    if (delta < 0.0f) {
+        delta += two_pi;
+    }
+    delta -= 3.14159265f;
+    float yaw = fmodf(a->yaw + delta * t, two_pi);
+    out->yaw = (yaw < 0.0f) ? yaw + two_pi : yaw;
+}
+
+static void network_client_sample_track(const NetworkClientTrack *track, double render_time, NetworkRemotePlayer *out)
+{
+    const NetworkClientStateSample *newest = network_client_track_sample(track, track->count - 1);
+    if (track->count == 1 || render_time <= network_client_track_sample(track, 0)->time) {
+        const NetworkClientStateSample *held = (track->count == 1) ? newest : network_client_track_sample(track, 0);
+        memcpy(out->position, held->position, sizeof(out->position));
+        out->yaw = held->yaw;
+        return;
+    }
+
+    if (render_time >= newest->time) {
+        /* out of snapshots: carry on along the last segment, for a while */
+        const NetworkClientStateSample *previous = network_client_track_sample(track, track->count - 2);
+        double span = newest->time - previous->time;
+        double ahead = render_time - newest->time;
+        if (ahead > NETWORK_CLIENT_MAX_EXTRAPOLATION) {
+            ahead = NETWORK_CLIENT_MAX_EXTRAPOLATION;
+        }
+        network_client_blend(previous, newest, span > 0.0 ? (float)(1.0 + ahead / span) : 1.0f, out);
+        return;
+    }
+
+    for (size_t i = track->count - 1; i > 0; --i) {
+        const NetworkClientStateSample *a = network_client_track_sample(track, i - 1);
+        if (a->time <= render_time) {
+            const NetworkClientStateSample *b = network_client_track_sample(track, i);
+            double span = b->time - a->time;
+            network_client_blend(a, b, span > 0.0 ? (float)((render_time - a->time) / span) : 1.0f, out);
+            return;
         }
     }
-    client->stats.remote_player_count = remote_count;
+}
+
+/* Positions remote players at interpolation_delay behind the server clock
+ * estimate. Players that left the snapshots are dropped once played out. */
+static void network_client_interpolate(NetworkClient *client)
+{
+    client->interpolated_count = 0;
+    if (!client->has_server_time) {
+        return;
+    }
+
+    double render_time = client->server_time - client->interpolation_delay;
+    double buffered = client->newest_snapshot_time - render_time;
+    client->stats.interpolation_buffer_ms = (float)(buffered * 1000.0);
+    if (buffered < 0.0) {
+        client->stats.interpolation_underruns += 1;
+    }
+
+    for (size_t i = 0; i < NETWORK_MAX_REMOTE_PLAYERS; ++i) {
+        NetworkClientTrack *track = &client->tracks[i];
+        if (!track->in_use || track->count == 0) {
+            continue;
+        }
+        if (!track->present && render_time > network_client_track_sample(track, track->count - 1)->time) {
+            client->track_by_id[track->id] = NETWORK_CLIENT_NO_TRACK;
+            memset(track, 0, sizeof(*track));
+            continue;
+        }
+
+        NetworkRemotePlayer *out = &client->interpolated_players[client->interpolated_count++];
+        memset(out, 0, sizeof(*out));
+        out->id = track->id;
+        out->active = true;
+        memcpy(out->name, track->name, sizeof(out->name));
+        network_client_sample_track(track, render_time, out);
+    }
+}
+
+static void network_client_handle_snapshot(NetworkClient *client, const enet_uint8 *data, size_t size)
+{
+    if (!client || !data || size < NETWORK_SNAPSHOT_HEADER_SIZE) {
+        return;
+    }
+    if (client->self_id == 0xFF) {
+        /* WELCOME (quantization table, tick interval) not in yet: decoding
+         * with the defaults would store and ack a wrong baseline */
+        return;
+    }
+
+    uint16_t sequence = (uint16_t)(data[1] | ((uint16_t)data[2] << 8));
+    uint16_t baseline_sequence = (uint16_t)(data[3] | ((uint16_t)data[4] << 8));
+    uint8_t flags = data[5];
+    uint8_t reported_count = data[6];
+    uint32_t tick = (uint32_t)data[7] | ((uint32_t)data[8] << 8) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 24);
+
+    if (client->has_snapshot && (int16_t)(uint16_t)(sequence - client->latest_snapshot_sequence) <= 0) {
+        /* stale or duplicate snapshot */
+        return;
+    }
+
+    const NetworkClientSnapshotFrame *baseline = NULL;
+    if (flags & NETWORK_SNAPSHOT_FLAG_DELTA) {
+        baseline = network_client_find_snapshot(client, baseline_sequence);
+        if (!baseline) {
+            /* baseline evicted; skip and let the server fall back to a full snapshot */
+            return;
+        }
+    }
+
+    NetworkClientSnapshotFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.sequence = sequence;
+    bool deferred[NETWORK_MAX_REMOTE_PLAYERS];
+
+    const NetworkQuantization *quant = &client->quantization;
+    NetworkBitReader reader;
+    network_bit_reader_init(&reader, data + NETWORK_SNAPSHOT_HEADER_SIZE, size - NETWORK_SNAPSHOT_HEADER_SIZE);
+    for (uint8_t i = 0; i < reported_count; ++i) {
+        uint8_t id = (uint8_t)network_bit_read(&reader, 8);
+        uint8_t mask = (uint8_t)network_bit_read(&reader, NETWORK_SNAPSHOT_FIELD_BITS);
+        bool entity_deferred = mask == 0U && network_bit_read(&reader, 1) != 0U;
+
+        NetworkRemotePlayer entity;
+        memset(&entity, 0, sizeof(entity));
+        if (baseline) {
+            for (uint8_t j = 0; j < baseline->count; ++j) {
+                if (baseline->entities[j].id == id) {
+                    entity = baseline->entities[j];
+                    break;
+                }
+            }
+        }
+        entity.id = id;
+        entity.active = true;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (mask & (NETWORK_SNAPSHOT_FIELD_POS_X << axis)) {
+                entity.position[axis] =
+                    network_dequantize_position(quant, axis, network_bit_read(&reader, quant->position_bits[axis]));
+            }
+        }
+        if (mask & NETWORK_SNAPSHOT_FIELD_YAW) {
+            entity.yaw = network_bit_read_yaw(&reader, quant);
+        }
+        if (mask & NETWORK_SNAPSHOT_FIELD_NAME) {
+            memset(entity.name, 0, sizeof(entity.name));
+            uint32_t name_len = network_bit_read(&reader, NETWORK_SNAPSHOT_NAME_LENGTH_BITS);
+            for (uint32_t c = 0; c < name_len && c < NETWORK_MAX_PLAYER_NAME - 1; ++c) {
+                entity.name[c] = (char)network_bit_read(&reader, 8);
+            }
+        }
+
+        if (reader.overflow) {
+            return;
+        }
+
+        if (frame.count < NETWORK_MAX_REMOTE_PLAYERS) {
+            deferred[frame.count] = entity_deferred;
+            frame.entities[frame.count++] = entity;
+        }
+    }
+
+    frame.valid = 1;
+    client->snapshot_history[sequence % NETWORK_CLIENT_SNAPSHOT_HISTORY] = frame;
+    client->latest_snapshot_sequence = sequence;
+    client->has_snapshot = 1;
+
+    client->stats.snapshots_received += 1;
+    network_client_apply_snapshot_frame(client, &frame);
+    network_client_buffer_snapshot(client, &frame, deferred, tick);
+    network_client_send_snapshot_ack(client, sequence);
+}
+
+static void network_client_handle_player_state(NetworkClient *client, const enet_uint8 *data, size_t size)
+{
+    if (size < NETWORK_PLAYER_STATE_SIZE) {
+        return;
+    }
+
+    NetworkClientPlayerState state;
+    size_t offset = 1;
+    memcpy(&state.command_sequence, data + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    memcpy(state.position, data + offset, sizeof(state.position));
+    offset += sizeof(state.position);
+    memcpy(state.velocity, data + offset, sizeof(state.velocity));
+    offset += sizeof(state.velocity);
+    state.grounded = (data[offset] & NETWORK_PLAYER_STATE_GROUNDED) != 0;
+    state.double_jump_available = (data[offset] & NETWORK_PLAYER_STATE_DOUBLE_JUMP) != 0;
+    offset += 1;
+    memcpy(&state.double_jump_timer, data + offset, sizeof(float));
+
+    /* states travel unreliably; one older than what we have is stale */
+    if ((int32_t)(state.command_sequence - client->player_state.command_sequence) < 0) {
+        return;
+    }
+
+    while (client->pending_count > 0U) {
+        const NetworkPlayerCommand *oldest = &client->pending_commands[client->pending_head];
+        if ((int32_t)(oldest->sequence - state.command_sequence) > 0) {
+            break;
+        }
+        client->pending_head = (client->pending_head + 1U) % NETWORK_CLIENT_PENDING_COMMANDS;
+        client->pending_count -= 1U;
+    }
+
+    client->player_state = state;
+    client->has_player_state = 1;
+    client->stats.prediction_pending_commands = (uint32_t)client->pending_count;
 }
 
 NetworkClient *network_client_create(const NetworkClientConfig *config)
@@ -228,14 +701,29 @@ NetworkClient *network_client_create(const NetworkClientConfig *config)
     client->config = *config;
     client->stats.connected = false;
     client->stats.time_since_last_packet = 0.0f;
-    client->stats.simulated_ping_ms = 0.0f;
+    client->stats.ping_ms = 0.0f;
+    client->stats.ping_variance_ms = 0.0f;
     client->stats.remote_player_count = 0;
+    client->stats.interpolation_buffer_ms = 0.0f;
+    client->stats.interpolation_underruns = 0;
+    client->stats.prediction_corrections = 0;
+    client->stats.prediction_error_average_m = 0.0f;
+    client->correction_error_sum = 0.0;
+    client->stats.command_uploads = 0;
+    float command_rate = config->command_rate > 0.0f ? config->command_rate : NETWORK_CLIENT_DEFAULT_COMMAND_RATE;
+    client->command_interval = 1.0 / (double)command_rate;
+    client->tick_interval = NETWORK_CLIENT_DEFAULT_TICK_INTERVAL;
+    float delay_ms = config->interpolation_delay_ms > 0.0f ? config->interpolation_delay_ms
+                                                           : NETWORK_CLIENT_DEFAULT_INTERPOLATION_DELAY_MS;
+    client->interpolation_delay = (double)delay_ms / 1000.0;
     client->time_since_last_packet = 0.0;
     client->handshake_timer = 0.0;
-    client->handshake_start = 0.0;
     client->connecting = 0;
     client->self_id = 0xFF;
+    network_quantization_default(&client->quantization);
     network_client_clear_remote_players(client);
+    network_client_clear_snapshots(client);
+    network_client_clear_prediction(client);
     network_client_clear_weapon_events(client);
     network_client_clear_voice_packets(client);
 
@@ -248,6 +736,9 @@ NetworkClient *network_client_create(const NetworkClientConfig *config)
         }
         return NULL;
     }
+    if (client->config.simulate_latency && !network_conditions_apply(client->host, &client->config.conditions)) {
+        fprintf(stderr, "[network] failed to enable the network simulator\n");
+    }
 
     return client;
 }
@@ -292,11 +783,21 @@ void network_client_connect(NetworkClient *client)
     client->connecting = 1;
     client->stats.connected = false;
     client->stats.time_since_last_packet = 0.0f;
-    client->stats.simulated_ping_ms = 0.0f;
+    client->stats.ping_ms = 0.0f;
+    client->stats.ping_variance_ms = 0.0f;
     client->stats.remote_player_count = 0;
-    client->handshake_start = network_get_time_seconds();
-   client->self_id = 0xFF;
-   network_client_clear_remote_players(client);
+    client->stats.bytes_received = 0;
+    client->stats.snapshots_received = 0;
+    client->stats.interpolation_buffer_ms = 0.0f;
+    client->stats.interpolation_underruns = 0;
+    client->stats.prediction_corrections = 0;
+    client->stats.prediction_error_average_m = 0.0f;
+    client->correction_error_sum = 0.0;
+    client->stats.command_uploads = 0;
+    client->self_id = 0xFF;
+    network_client_clear_remote_players(client);
+    network_client_clear_snapshots(client);
+    network_client_clear_prediction(client);
     network_client_clear_weapon_events(client);
     network_client_clear_voice_packets(client);
 }
@@ -309,6 +810,7 @@ void network_client_disconnect(NetworkClient *client)
 
     if (client->peer) {
         enet_peer_disconnect(client->peer, 0);
+        enet_host_flush(client->host);
         enet_peer_reset(client->peer);
     }
 
@@ -317,20 +819,15 @@ void network_client_disconnect(NetworkClient *client)
     client->stats.connected = false;
     client->self_id = 0xFF;
     network_client_clear_remote_players(client);
+    network_client_clear_snapshots(client);
+    network_client_clear_prediction(client);
     network_client_clear_weapon_events(client);
     network_client_clear_voice_packets(client);
 }
 
-static void network_client_handle_packet(NetworkClient *client, const ENetEvent *event)
+static void network_client_handle_message(NetworkClient *client, const enet_uint8 *data, size_t size)
 {
-    if (!client || !event || !event->packet) {
-        return;
-    }
-
-    const enet_uint8 *data = event->packet->data;
-    size_t size = event->packet->dataLength;
     if (size == 0) {
-        enet_packet_destroy(event->packet);
         return;
     }
 
@@ -341,11 +838,22 @@ static void network_client_handle_packet(NetworkClient *client, const ENetEvent
         client->connecting = 0;
         if (size >= 4) {
             client->stats.remote_player_count = data[1];
-            client->stats.simulated_ping_ms = (float)((network_get_time_seconds() - client->handshake_start) * 1000.0);
             client->self_id = data[3];
+            client->next_command_sequence = 1U;
+            network_client_clear_prediction(client);
+            if (!network_quantization_read(&client->quantization, data + 4, size - 4)) {
+                network_quantization_default(&client->quantization);
+            }
+            if (size >= 4 + NETWORK_QUANTIZATION_WIRE_SIZE + 4) {
+                const enet_uint8 *interval = data + 4 + NETWORK_QUANTIZATION_WIRE_SIZE;
+                uint32_t tick_us = (uint32_t)interval[0] | ((uint32_t)interval[1] << 8) |
+                                   ((uint32_t)interval[2] << 16) | ((uint32_t)interval[3] << 24);
+                if (tick_us > 0U) {
+                    client->tick_interval = (double)tick_us / 1000000.0;
+                }
+            }
         } else if (size >= 3) {
             client->stats.remote_player_count = data[1];
-            client->stats.simulated_ping_ms = (float)((network_get_time_seconds() - client->handshake_start) * 1000.0);
         }
         break;
     case NETWORK_MESSAGE_PLAYER_COUNT:
@@ -356,6 +864,9 @@ static void network_client_handle_packet(NetworkClient *client, const ENetEvent
     case NETWORK_MESSAGE_SERVER_SNAPSHOT:
         network_client_handle_snapshot(client, data, size);
         break;
+    case NETWORK_MESSAGE_PLAYER_STATE:
+        network_client_handle_player_state(client, data, size);
+        break;
     case NETWORK_MESSAGE_WEAPON_EVENT:
         if (size >= 2 + NETWORK_WEAPON_EVENT_DATA_SIZE) {
             NetworkWeaponEvent weapon_event = {0};
@@ -384,9 +895,16 @@ static void network_client_handle_packet(NetworkClient *client, const ENetEvent
             memcpy(&weapon_event.pickup_id, payload + offset, sizeof(uint32_t));
             offset += sizeof(uint32_t);
 
-            if (offset + sizeof(float) * 3 <= NETWORK_WEAPON_EVENT_DATA_SIZE) {
-                memcpy(weapon_event.position, payload + offset, sizeof(float) * 3);
-            }
+            memcpy(weapon_event.position, payload + offset, sizeof(float) * 3);
+            offset += sizeof(float) * 3;
+
+            memcpy(weapon_event.direction, payload + offset, sizeof(float) * 3);
+            offset += sizeof(float) * 3;
+
+            memcpy(&weapon_event.view_time, payload + offset, sizeof(double));
+            offset += sizeof(double);
+
+            weapon_event.hit_id = payload[offset];
 
             network_client_enqueue_weapon_event(client, &weapon_event);
         }
@@ -394,22 +912,18 @@ static void network_client_handle_packet(NetworkClient *client, const ENetEvent
     case NETWORK_MESSAGE_VOICE_DATA:
         if (size > 9U) {
             NetworkVoicePacket packet = {0};
-            packet.speaker_id = data[1];
-            packet.codec = (NetworkVoiceCodec)data[2];
-            packet.channels = data[3];
-            packet.sample_rate = (uint16_t)(data[4] | ((uint16_t)data[5] << 8));
-            packet.frame_count = (uint16_t)(data[6] | ((uint16_t)data[7] << 8));
-            uint8_t volume_byte = data[8];
+            /* [type][volume] per-listener header, then the shared body */
+            uint8_t volume_byte = data[1];
+            packet.speaker_id = data[2];
+            packet.codec = (NetworkVoiceCodec)data[3];
+            packet.channels = data[4];
+            packet.sample_rate = (uint16_t)(data[5] | ((uint16_t)data[6] << 8));
+            packet.frame_count = (uint16_t)(data[7] | ((uint16_t)data[8] << 8));
             packet.volume = (float)volume_byte / 255.0f;
 
-            if (packet.channels == 0U || packet.channels > NETWORK_VOICE_MAX_CHANNELS) {
-                break;
-            }
-
             size_t payload_size = size - 9U;
-            size_t expected_size = (size_t)packet.frame_count * packet.channels * sizeof(int16_t);
-            if (packet.codec != NETWORK_VOICE_CODEC_PCM16 || payload_size != expected_size ||
-                payload_size > NETWORK_VOICE_MAX_DATA) {
+            size_t expected_size = network_voice_payload_size(packet.codec, packet.frame_count, packet.channels);
+            if (expected_size == 0U || payload_size != expected_size) {
                 break;
             }
 
@@ -421,12 +935,96 @@ static void network_client_handle_packet(NetworkClient *client, const ENetEvent
     default:
         break;
     }
+}
+
+static void network_client_handle_packet(NetworkClient *client, const ENetEvent *event)
+{
+    if (!client || !event || !event->packet) {
+        return;
+    }
+
+    const enet_uint8 *data = event->packet->data;
+    size_t size = event->packet->dataLength;
+    if (size == 0) {
+        enet_packet_destroy(event->packet);
+        return;
+    }
+
+    client->stats.bytes_received += (uint64_t)size;
+
+    if (data[0] == NETWORK_MESSAGE_BUNDLE) {
+        /* [BUNDLE]([len u16][message])...: everything the server queued for us in one update */
+        size_t offset = 1;
+        while (offset + NETWORK_BUNDLE_LENGTH_SIZE <= size) {
+            size_t length = (size_t)(data[offset] | ((size_t)data[offset + 1] << 8));
+            offset += NETWORK_BUNDLE_LENGTH_SIZE;
+            if (length == 0U || length > size - offset) {
+                break;
+            }
+            network_client_handle_message(client, data + offset, length);
+            offset += length;
+        }
+    } else {
+        network_client_handle_message(client, data, size);
+    }
 
     client->stats.time_since_last_packet = 0.0f;
 
     enet_packet_destroy(event->packet);
 }
 
+/* Sends the commands not uploaded yet along with those of the previous
+ * NETWORK_CLIENT_COMMAND_REDUNDANCY uploads the server has not simulated,
+ * oldest first: [CLIENT_COMMAND][count] then the bit-packed commands. */
+static bool network_client_upload_commands(NetworkClient *client)
+{
+    size_t skip = 0;
+    while (skip < client->pending_count) {
+        const NetworkPlayerCommand *command =
+            &client->pending_commands[(client->pending_head + skip) % NETWORK_CLIENT_PENDING_COMMANDS];
+        if ((int32_t)(command->sequence - client->upload_starts[0]) >= 0) {
+            break;
+        }
+        ++skip;
+    }
+    size_t count = client->pending_count - skip;
+    if (count == 0U) {
+        return true;
+    }
+    if (count > NETWORK_CLIENT_MAX_UPLOAD_COMMANDS) {
+        skip += count - NETWORK_CLIENT_MAX_UPLOAD_COMMANDS;
+        count = NETWORK_CLIENT_MAX_UPLOAD_COMMANDS;
+    }
+
+    enet_uint8 payload[2 + NETWORK_CLIENT_MAX_UPLOAD_COMMANDS * NETWORK_CLIENT_COMMAND_MAX_SIZE];
+    payload[0] = NETWORK_MESSAGE_CLIENT_COMMAND;
+    payload[1] = (enet_uint8)count;
+
+    NetworkBitWriter writer;
+    network_bit_writer_init(&writer, payload + 2, sizeof(payload) - 2);
+    for (size_t i = 0; i < count; ++i) {
+        const NetworkPlayerCommand *command =
+            &client->pending_commands[(client->pending_head + skip + i) % NETWORK_CLIENT_PENDING_COMMANDS];
+        network_player_command_write(&writer, &client->quantization, command);
+    }
+    if (writer.overflow) {
+        return false;
+    }
+
+    ENetPacket *packet = enet_packet_create(payload, 2 + network_bit_writer_bytes(&writer), 0);
+    if (!packet || !network_client_send_now(client, packet)) {
+        return false;
+    }
+
+    for (size_t i = 0; i + 1U < NETWORK_CLIENT_COMMAND_REDUNDANCY; ++i) {
+        client->upload_starts[i] = client->upload_starts[i + 1U];
+    }
+    client->upload_starts[NETWORK_CLIENT_COMMAND_REDUNDANCY - 1U] = client->next_upload_sequence;
+    client->next_upload_sequence = client->next_command_sequence;
+    client->stats.command_uploads += 1;
+    return true;
+}
+
 void network_client_update(NetworkClient *client, float dt)
 {
     if (!client || !client->host) {
@@ -434,6 +1032,10 @@ void network_client_update(NetworkClient *client, float dt)
     }
 
     client->stats.time_since_last_packet += dt;
+    client->command_timer += dt;
+    if (client->has_server_time) {
+        client->server_time += dt;
+    }
 
     ENetEvent event;
     while (enet_host_service(client->host, &event, 0) > 0) {
@@ -441,8 +1043,8 @@ void network_client_update(NetworkClient *client, float dt)
         case ENET_EVENT_TYPE_CONNECT: {
             enet_uint8 hello = NETWORK_MESSAGE_HELLO;
             ENetPacket *packet = enet_packet_create(&hello, 1, ENET_PACKET_FLAG_RELIABLE);
-            if (packet) {
-                enet_peer_send(event.peer, 0, packet);
+            if (packet && enet_peer_send(event.peer, 0, packet) != 0) {
+                enet_packet_destroy(packet);
             }
             break;
         }
@@ -455,11 +1057,28 @@ void network_client_update(NetworkClient *client, float dt)
             client->peer = NULL;
             client->self_id = 0xFF;
             network_client_clear_remote_players(client);
+            network_client_clear_snapshots(client);
+            network_client_clear_prediction(client);
             break;
         default:
             break;
         }
     }
+
+    /* commands queued just before the caller stopped sending (a pause) would
+     * otherwise wait for the next one; uploads from
+     * network_client_send_player_command keep the timer below this */
+    if (client->peer && client->command_timer >= 2.0 * client->command_interval &&
+        client->next_upload_sequence != client->next_command_sequence) {
+        client->command_timer = 0.0;
+        (void)network_client_upload_commands(client);
+    }
+
+    if (client->peer) {
+        client->stats.ping_ms = (float)client->peer->roundTripTime;
+        client->stats.ping_variance_ms = (float)client->peer->roundTripTimeVariance;
+    }
+    network_client_interpolate(client);
 }
 
 bool network_client_is_connected(const NetworkClient *client)
@@ -495,26 +1114,113 @@ const NetworkRemotePlayer *network_client_remote_players(const NetworkClient *cl
     return client->remote_players;
 }
 
-bool network_client_send_player_state(NetworkClient *client, const NetworkClientPlayerState *state)
+const NetworkRemotePlayer *network_client_interpolated_players(const NetworkClient *client, size_t *out_count)
+{
+    if (!client) {
+        if (out_count) {
+            *out_count = 0;
+        }
+        return NULL;
+    }
+
+    if (out_count) {
+        *out_count = client->interpolated_count;
+    }
+    return client->interpolated_players;
+}
+
+double network_client_view_time(const NetworkClient *client)
 {
-    if (!client || !state || !client->peer) {
+    if (!client || !client->has_server_time) {
+        return 0.0;
+    }
+    return client->server_time - client->interpolation_delay;
+}
+
+bool network_client_send_player_command(NetworkClient *client, NetworkPlayerCommand *command)
+{
+    if (!client || !command || !client->peer) {
         return false;
     }
     if (!client->stats.connected || client->self_id == 0xFF) {
         return false;
     }
 
-    enet_uint8 payload[1 + sizeof(float) * 4];
-    payload[0] = NETWORK_MESSAGE_CLIENT_STATE;
-    memcpy(payload + 1, state->position, sizeof(float) * 3);
-    memcpy(payload + 1 + sizeof(float) * 3, &state->yaw, sizeof(float));
+    command->sequence = client->next_command_sequence++;
+    if (command->duration > NETWORK_MAX_COMMAND_DURATION) {
+        command->duration = NETWORK_MAX_COMMAND_DURATION;
+    }
 
-    ENetPacket *packet = enet_packet_create(payload, sizeof(payload), ENET_PACKET_FLAG_RELIABLE);
-    if (!packet) {
+    /* predict with what the server will simulate, not what was asked for */
+    enet_uint8 encoded[NETWORK_CLIENT_COMMAND_MAX_SIZE];
+    NetworkBitWriter writer;
+    network_bit_writer_init(&writer, encoded, sizeof(encoded));
+    network_player_command_write(&writer, &client->quantization, command);
+    if (writer.overflow) {
+        return false;
+    }
+    NetworkBitReader reader;
+    network_bit_reader_init(&reader, encoded, network_bit_writer_bytes(&writer));
+    if (!network_player_command_read(&reader, &client->quantization, command)) {
         return false;
     }
 
-    return enet_peer_send(client->peer, 0, packet) == 0;
+    if (client->pending_count >= NETWORK_CLIENT_PENDING_COMMANDS) {
+        /* the server is far behind; the oldest command can no longer be replayed */
+        client->pending_head = (client->pending_head + 1U) % NETWORK_CLIENT_PENDING_COMMANDS;
+        client->pending_count -= 1U;
+    }
+    size_t slot = (client->pending_head + client->pending_count) % NETWORK_CLIENT_PENDING_COMMANDS;
+    client->pending_commands[slot] = *command;
+    client->pending_count += 1U;
+    client->stats.prediction_pending_commands = (uint32_t)client->pending_count;
+
+    /* at most one upload per interval, and per frame when frames are slower */
+    if (client->command_timer >= client->command_interval) {
+        client->command_timer -= client->command_interval;
+        if (client->command_timer >= client->command_interval) {
+            client->command_timer = 0.0;
+        }
+        (void)network_client_upload_commands(client);
+    }
+    return true;
+}
+
+bool network_client_reconcile(NetworkClient *client,
+                              PlayerState *player,
+                              const GameConfig *config,
+                              GameWorld *world,
+                              size_t player_entity_index)
+{
+    if (!client || !player || !config || !world || !client->has_player_state) {
+        return false;
+    }
+    client->has_player_state = 0;
+
+    const vec3 predicted = player->position;
+    const NetworkClientPlayerState *state = &client->player_state;
+    player->position = vec3_make(state->position[0], state->position[1], state->position[2]);
+    player->velocity = vec3_make(state->velocity[0], state->velocity[1], state->velocity[2]);
+    player->grounded = state->grounded;
+    player->double_jump_available = state->double_jump_available;
+    player->double_jump_timer = state->double_jump_timer;
+
+    for (size_t i = 0; i < client->pending_count; ++i) {
+        const NetworkPlayerCommand *command =
+            &client->pending_commands[(client->pending_head + i) % NETWORK_CLIENT_PENDING_COMMANDS];
+        PlayerCommand input;
+        network_player_command_to_input(command, &input);
+        player_update_physics(player, &input, config, world, command->duration, player_entity_index);
+    }
+
+    float error = vec3_length(vec3_sub(player->position, predicted));
+    if (error > NETWORK_CLIENT_CORRECTION_EPSILON) {
+        client->stats.prediction_corrections += 1;
+        client->correction_error_sum += (double)error;
+        client->stats.prediction_error_average_m =
+            (float)(client->correction_error_sum / (double)client->stats.prediction_corrections);
+    }
+    return true;
 }
 
 bool network_client_send_weapon_event(NetworkClient *client, const NetworkWeaponEvent *event)
@@ -550,13 +1256,22 @@ bool network_client_send_weapon_event(NetworkClient *client, const NetworkWeapon
     offset += sizeof(uint32_t);
 
     memcpy(write + offset, event->position, sizeof(float) * 3);
+    offset += sizeof(float) * 3;
+
+    memcpy(write + offset, event->direction, sizeof(float) * 3);
+    offset += sizeof(float) * 3;
+
+    memcpy(write + offset, &event->view_time, sizeof(double));
+    offset += sizeof(double);
+
+    write[offset] = NETWORK_WEAPON_EVENT_NO_HIT;
 
     ENetPacket *packet = enet_packet_create(payload, sizeof(payload), ENET_PACKET_FLAG_RELIABLE);
     if (!packet) {
         return false;
     }
 
-    return enet_peer_send(client->peer, 0, packet) == 0;
+    return network_client_send_now(client, packet);
 }
 
 bool network_client_send_voice_packet(NetworkClient *client, const NetworkVoicePacket *packet)
@@ -567,15 +1282,9 @@ bool network_client_send_voice_packet(NetworkClient *client, const NetworkVoiceP
     if (!client->stats.connected || client->self_id == 0xFF) {
         return false;
     }
-    if (packet->codec != NETWORK_VOICE_CODEC_PCM16) {
-        return false;
-    }
-    if (packet->channels == 0U || packet->channels > NETWORK_VOICE_MAX_CHANNELS) {
-        return false;
-    }
 
-    size_t expected_size = (size_t)packet->frame_count * packet->channels * sizeof(int16_t);
-    if (packet->data_size == 0U || packet->data_size != expected_size || packet->data_size > NETWORK_VOICE_MAX_DATA) {
+    size_t expected_size = network_voice_payload_size(packet->codec, packet->frame_count, packet->channels);
+    if (expected_size == 0U || packet->data_size != expected_size) {
         return false;
     }
 
@@ -613,7 +1322,7 @@ bool network_client_send_voice_packet(NetworkClient *client, const NetworkVoiceP
         return false;
     }
 
-    return enet_peer_send(client->peer, 0, enet_packet) == 0;
+    return network_client_send_now(client, enet_packet);
 }
 
 size_t network_client_dequeue_weapon_events(NetworkClient *client,
@@ -0,0 +1,470 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* clock_gettime, nanosleep */
+#endif
+
+#include "engine/network.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+#define LOADGEN_PI 3.14159265358979323846
+#define LOADGEN_DEFAULT_BOTS 100U
+#define LOADGEN_DEFAULT_COMMAND_RATE 30.0
+#define LOADGEN_DEFAULT_DURATION 30.0
+#define LOADGEN_DEFAULT_CONNECT_RATE 50.0
+#define LOADGEN_DEFAULT_VOICE_FRACTION 0.1
+#define LOADGEN_FRAME_SECONDS (1.0 / 120.0)
+#define LOADGEN_REPORT_INTERVAL 5.0
+#define LOADGEN_VOICE_FRAME_SECONDS 0.02
+#define LOADGEN_VOICE_SAMPLE_RATE 16000U
+/* commands carry yaw = marker * 2pi / LOADGEN_YAW_MARKERS, so the bot's own
+ * entity in a snapshot tells which command the server last applied */
+#define LOADGEN_YAW_MARKERS 32U
+
+typedef struct LoadgenBot {
+    NetworkClient *client;
+    uint32_t index;
+    uint32_t rng;
+    int started;
+    int talker;
+    double command_timer;
+    double voice_timer;
+    double weapon_timer;
+    double voice_phase;
+    float heading;
+    float turn_rate;
+    uint32_t commands_sent;
+    double marker_sent_at[LOADGEN_YAW_MARKERS];
+    int observed_marker;
+    uint32_t weapon_id;
+    int holding;
+    uint64_t voice_failed;
+    uint64_t report_bytes;
+    uint64_t report_snapshots;
+    uint64_t report_voice_failed;
+} LoadgenBot;
+
+typedef struct LoadgenSamples {
+    float *values;
+    size_t count;
+    size_t capacity;
+} LoadgenSamples;
+
+static double loadgen_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void loadgen_sleep(double seconds)
+{
+    if (seconds <= 0.0) {
+        return;
+    }
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/* xorshift32; bots are seeded from their index so runs are repeatable */
+static uint32_t loadgen_rand(LoadgenBot *bot)
+{
+    uint32_t x = bot->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bot->rng = x;
+    return x;
+}
+
+static float loadgen_randf(LoadgenBot *bot)
+{
+    return (float)(loadgen_rand(bot) >> 8) / 16777216.0f;
+}
+
+static void loadgen_samples_push(LoadgenSamples *samples, float value)
+{
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity ? samples->capacity * 2U : 4096U;
+        float *values = (float *)realloc(samples->values, capacity * sizeof(float));
+        if (!values) {
+            return;
+        }
+        samples->values = values;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int loadgen_compare_float(const void *a, const void *b)
+{
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+static float loadgen_percentile(const LoadgenSamples *samples, double p)
+{
+    if (samples->count == 0U) {
+        return 0.0f;
+    }
+    size_t index = (size_t)(p * (double)(samples->count - 1U) + 0.5);
+    return samples->values[index];
+}
+
+static void loadgen_send_command(LoadgenBot *bot, double now, double interval)
+{
+    /* scripted movement: walk a slowly turning circle, sprint and jump now and then */
+    bot->heading += bot->turn_rate * (float)interval;
+
+    NetworkPlayerCommand command;
+    memset(&command, 0, sizeof(command));
+    command.duration = (float)interval;
+    command.move_direction[0] = cosf(bot->heading);
+    command.move_direction[2] = sinf(bot->heading);
+    command.move_magnitude = 1.0f;
+    command.sprint = (loadgen_rand(bot) & 7U) == 0U;
+    command.jump = (loadgen_rand(bot) & 63U) == 0U;
+
+    uint32_t marker = bot->commands_sent % LOADGEN_YAW_MARKERS;
+    command.yaw = (float)((double)marker * 2.0 * LOADGEN_PI / (double)LOADGEN_YAW_MARKERS);
+
+    if (network_client_send_player_command(bot->client, &command)) {
+        bot->marker_sent_at[marker] = now;
+        bot->commands_sent += 1;
+    }
+}
+
+static void loadgen_send_voice(LoadgenBot *bot)
+{
+    NetworkVoicePacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.codec = NETWORK_VOICE_CODEC_PCM16;
+    packet.channels = 1;
+    packet.sample_rate = (uint16_t)LOADGEN_VOICE_SAMPLE_RATE;
+    packet.frame_count = (uint16_t)(LOADGEN_VOICE_SAMPLE_RATE * LOADGEN_VOICE_FRAME_SECONDS);
+    packet.volume = 1.0f;
+    packet.data_size = network_voice_payload_size(packet.codec, packet.frame_count, packet.channels);
+    if (packet.data_size == 0U) {
+        return;
+    }
+
+    /* a tone per bot so captures can tell talkers apart */
+    double frequency = 220.0 + 20.0 * (double)(bot->index % 16U);
+    for (uint16_t i = 0; i < packet.frame_count; ++i) {
+        int16_t sample = (int16_t)(8000.0 * sin(bot->voice_phase));
+        bot->voice_phase += 2.0 * LOADGEN_PI * frequency / (double)LOADGEN_VOICE_SAMPLE_RATE;
+        packet.data[i * 2] = (uint8_t)((uint16_t)sample & 0xFF);
+        packet.data[i * 2 + 1] = (uint8_t)(((uint16_t)sample >> 8) & 0xFF);
+    }
+    bot->voice_phase = fmod(bot->voice_phase, 2.0 * LOADGEN_PI);
+
+    if (!network_client_send_voice_packet(bot->client, &packet)) {
+        bot->voice_failed += 1;
+    }
+}
+
+static void loadgen_send_weapon_event(LoadgenBot *bot)
+{
+    NetworkWeaponEvent event;
+    memset(&event, 0, sizeof(event));
+    if (bot->holding) {
+        event.type = NETWORK_WEAPON_EVENT_DROP;
+    } else {
+        event.type = NETWORK_WEAPON_EVENT_PICKUP;
+        bot->weapon_id = 1U + (loadgen_rand(bot) % 4U);
+    }
+    event.weapon_id = (uint16_t)bot->weapon_id;
+    event.pickup_id = (bot->index << 16) | (loadgen_rand(bot) & 0xFFFFU);
+    event.ammo_in_clip = 30;
+    event.ammo_reserve = 90;
+
+    size_t count = 0;
+    const NetworkRemotePlayer *players = network_client_remote_players(bot->client, &count);
+    for (size_t i = 0; i < count; ++i) {
+        if (players[i].id == network_client_self_id(bot->client)) {
+            memcpy(event.position, players[i].position, sizeof(event.position));
+            break;
+        }
+    }
+
+    if (network_client_send_weapon_event(bot->client, &event)) {
+        bot->holding = !bot->holding;
+    }
+}
+
+/* Looks for the bot's own entity and, when its yaw marker moved, records how
+ * long ago the command carrying that marker was sent. */
+static void loadgen_observe_state(LoadgenBot *bot, double now, double marker_window, LoadgenSamples *latency)
+{
+    uint8_t self_id = network_client_self_id(bot->client);
+    if (self_id == 0xFF) {
+        return;
+    }
+
+    size_t count = 0;
+    const NetworkRemotePlayer *players = network_client_remote_players(bot->client, &count);
+    for (size_t i = 0; i < count; ++i) {
+        if (players[i].id != self_id) {
+            continue;
+        }
+
+        double turns = (double)players[i].yaw / (2.0 * LOADGEN_PI);
+        turns -= floor(turns);
+        int marker = (int)lround(turns * (double)LOADGEN_YAW_MARKERS) % (int)LOADGEN_YAW_MARKERS;
+        if (marker != bot->observed_marker) {
+            bot->observed_marker = marker;
+            double sent_at = bot->marker_sent_at[marker];
+            /* markers repeat; anything older than one cycle is ambiguous */
+            if (sent_at > 0.0 && now - sent_at < marker_window) {
+                loadgen_samples_push(latency, (float)((now - sent_at) * 1000.0));
+            }
+        }
+        return;
+    }
+}
+
+static void loadgen_report(LoadgenBot *bots, uint32_t bot_count, double interval, LoadgenSamples *latency, const char *label)
+{
+    uint32_t connected = 0;
+    uint64_t snapshots = 0;
+    uint64_t bytes = 0;
+    uint64_t min_bytes = UINT64_MAX;
+    uint64_t max_bytes = 0;
+    uint64_t voice_failed = 0;
+
+    for (uint32_t i = 0; i < bot_count; ++i) {
+        LoadgenBot *bot = &bots[i];
+        if (!bot->started) {
+            continue;
+        }
+        const NetworkClientStats *stats = network_client_stats(bot->client);
+        uint64_t bot_bytes = stats->bytes_received - bot->report_bytes;
+        snapshots += stats->snapshots_received - bot->report_snapshots;
+        bot->report_bytes = stats->bytes_received;
+        bot->report_snapshots = stats->snapshots_received;
+        voice_failed += bot->voice_failed - bot->report_voice_failed;
+        bot->report_voice_failed = bot->voice_failed;
+        if (!stats->connected) {
+            continue;
+        }
+        connected += 1;
+        bytes += bot_bytes;
+        if (bot_bytes < min_bytes) {
+            min_bytes = bot_bytes;
+        }
+        if (bot_bytes > max_bytes) {
+            max_bytes = bot_bytes;
+        }
+    }
+
+    if (connected == 0U || interval <= 0.0) {
+        printf("[loadgen] %s: no bots connected\n", label);
+        return;
+    }
+
+    qsort(latency->values, latency->count, sizeof(float), loadgen_compare_float);
+    printf("[loadgen] %s: %u/%u bots, %.1f snapshots/s per bot, rx %.1f KB/s per bot (min %.1f max %.1f), "
+           "state latency p50 %.1f ms p90 %.1f ms p99 %.1f ms max %.1f ms over %zu samples, %llu voice sends failed\n",
+           label,
+           connected,
+           bot_count,
+           (double)snapshots / interval / (double)connected,
+           (double)bytes / interval / (double)connected / 1024.0,
+           (double)min_bytes / interval / 1024.0,
+           (double)max_bytes / interval / 1024.0,
+           loadgen_percentile(latency, 0.50),
+           loadgen_percentile(latency, 0.90),
+           loadgen_percentile(latency, 0.99),
+           loadgen_percentile(latency, 1.0),
+           latency->count,
+           (unsigned long long)voice_failed);
+}
+
+int main(int argc, char** argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 26015;
+    uint32_t bot_count = LOADGEN_DEFAULT_BOTS;
+    double command_rate = LOADGEN_DEFAULT_COMMAND_RATE;
+    double duration = LOADGEN_DEFAULT_DURATION;
+    double connect_rate = LOADGEN_DEFAULT_CONNECT_RATE;
+    double voice_fraction = LOADGEN_DEFAULT_VOICE_FRACTION;
+    double weapon_interval = 5.0;
+    NetworkConditions conditions;
+    memset(&conditions, 0, sizeof(conditions));
+    bool simulate = false;
+
+    // args: --host 127.0.0.1 --port 26015 --bots 100 --rate 30 --duration 30 ...
+    for (int i=1; i+1<argc; ++i){
+        if (strcmp(argv[i], "--host")==0) host = argv[++i];
+        else if (strcmp(argv[i], "--port")==0) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bots")==0) bot_count = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate")==0) command_rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--duration")==0) duration = atof(argv[++i]);
+        else if (strcmp(argv[i], "--connect-rate")==0) connect_rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--voice")==0) voice_fraction = atof(argv[++i]);
+        else if (strcmp(argv[i], "--weapon-interval")==0) weapon_interval = atof(argv[++i]);
+        else if (strncmp(argv[i], "--sim-", 6)==0) {
+            if (network_conditions_set(&conditions, argv[i] + 6, argv[i + 1])) simulate = true;
+            ++i;
+        }
+    }
+    if (bot_count == 0U || command_rate <= 0.0 || connect_rate <= 0.0) {
+        fprintf(stderr, "usage: loadgen [--host h] [--port p] [--bots n] [--rate hz] [--duration s] "
+                        "[--connect-rate bots/s] [--voice fraction] [--weapon-interval s] "
+                        "[--sim-latency ms --sim-jitter ms --sim-loss p ...]\n");
+        return 1;
+    }
+
+    LoadgenBot *bots = (LoadgenBot *)calloc(bot_count, sizeof(LoadgenBot));
+    if (!bots) {
+        return 1;
+    }
+
+    NetworkClientConfig config;
+    memset(&config, 0, sizeof(config));
+    config.host = host;
+    config.port = port;
+    config.simulate_latency = simulate;
+    config.conditions = conditions;
+    for (uint32_t i = 0; i < bot_count; ++i) {
+        LoadgenBot *bot = &bots[i];
+        /* each bot gets its own loss pattern */
+        config.conditions.seed = conditions.seed + i;
+        bot->index = i;
+        bot->rng = 0x9E3779B9U ^ (i * 2654435761U);
+        if (bot->rng == 0U) {
+            bot->rng = 1U;
+        }
+        bot->client = network_client_create(&config);
+        if (!bot->client) {
+            fprintf(stderr, "[loadgen] failed to create bot %u\n", i);
+            bot_count = i;
+            break;
+        }
+        bot->talker = loadgen_randf(bot) < (float)voice_fraction;
+        bot->heading = loadgen_randf(bot) * (float)(2.0 * LOADGEN_PI);
+        bot->turn_rate = 0.2f + loadgen_randf(bot);
+        bot->weapon_timer = loadgen_randf(bot) * weapon_interval;
+        bot->observed_marker = -1;
+    }
+
+    printf("[loadgen] %u bots -> %s:%u, commands at %.0f Hz, %.0f%% talking, for %.0f s\n",
+           bot_count, host, (unsigned)port, command_rate, voice_fraction * 100.0, duration);
+
+    double command_interval = 1.0 / command_rate;
+    double marker_window = command_interval * (double)LOADGEN_YAW_MARKERS;
+    LoadgenSamples interval_latency = {0};
+    LoadgenSamples total_latency = {0};
+    uint32_t started = 0;
+
+    double start = loadgen_now();
+    double last = start;
+    double last_report = start;
+    double measure_start = start;
+    for (;;){
+        double now = loadgen_now();
+        double dt = now - last;
+        last = now;
+        if (now - start >= duration) {
+            break;
+        }
+
+        // Connexions échelonnées pour ne pas saturer le buffer UDP du serveur
+        uint32_t due = (uint32_t)fmin((double)bot_count, (now - start) * connect_rate + 1.0);
+        while (started < due) {
+            network_client_connect(bots[started].client);
+            bots[started].started = 1;
+            ++started;
+        }
+
+        for (uint32_t i = 0; i < started; ++i) {
+            LoadgenBot *bot = &bots[i];
+            network_client_update(bot->client, (float)dt);
+            if (network_client_self_id(bot->client) == 0xFF) {
+                continue;
+            }
+
+            bot->command_timer += dt;
+            while (bot->command_timer >= command_interval) {
+                bot->command_timer -= command_interval;
+                loadgen_send_command(bot, now, command_interval);
+            }
+
+            if (bot->talker) {
+                bot->voice_timer += dt;
+                while (bot->voice_timer >= LOADGEN_VOICE_FRAME_SECONDS) {
+                    bot->voice_timer -= LOADGEN_VOICE_FRAME_SECONDS;
+                    loadgen_send_voice(bot);
+                }
+            }
+
+            bot->weapon_timer -= dt;
+            if (weapon_interval > 0.0 && bot->weapon_timer <= 0.0) {
+                bot->weapon_timer = weapon_interval * (0.5 + loadgen_randf(bot));
+                loadgen_send_weapon_event(bot);
+            }
+
+            /* relays are only counted through bytes_received */
+            NetworkVoicePacket voice[8];
+            while (network_client_dequeue_voice_packets(bot->client, voice, 8) == 8) {
+            }
+            NetworkWeaponEvent weapons[16];
+            while (network_client_dequeue_weapon_events(bot->client, weapons, 16) == 16) {
+            }
+
+            loadgen_observe_state(bot, now, marker_window, &interval_latency);
+        }
+
+        if (now - last_report >= LOADGEN_REPORT_INTERVAL) {
+            for (size_t i = 0; i < interval_latency.count; ++i) {
+                loadgen_samples_push(&total_latency, interval_latency.values[i]);
+            }
+            loadgen_report(bots, bot_count, now - last_report, &interval_latency, "interval");
+            interval_latency.count = 0;
+            last_report = now;
+        }
+
+        loadgen_sleep(LOADGEN_FRAME_SECONDS - (loadgen_now() - now));
+    }
+
+    for (size_t i = 0; i < interval_latency.count; ++i) {
+        loadgen_samples_push(&total_latency, interval_latency.values[i]);
+    }
+    for (uint32_t i = 0; i < bot_count; ++i) {
+        bots[i].report_bytes = 0;
+        bots[i].report_snapshots = 0;
+        bots[i].report_voice_failed = 0;
+    }
+    loadgen_report(bots, bot_count, loadgen_now() - measure_start, &total_latency, "total");
+
+    for (uint32_t i = 0; i < bot_count; ++i) {
+        network_client_destroy(bots[i].client);
+    }
+    free(interval_latency.values);
+    free(total_latency.values);
+    free(bots);
+    return 0;
+}
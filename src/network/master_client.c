@@ -1,3 +1,7 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#    define _POSIX_C_SOURCE 200809L /* getaddrinfo */
+#endif
+
 #include "engine/network_master.h"
 
 #include <stdlib.h>
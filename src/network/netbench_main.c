@@ -0,0 +1,605 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#endif
+
+#include "enet.h"
+#include "engine/network.h"
+#include "engine/network_server.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#endif
+
+#define NETBENCH_MAX_CLIENTS 1024
+#define NETBENCH_MAX_SIZE 1100
+#define NETBENCH_MAX_SENDERS 16
+#define NETBENCH_VOICE_MAX_LISTENERS 64
+#define NETBENCH_VOICE_TICK (1.0f / 60.0f)
+/* 20 ms of 16 kHz mono PCM, the frame loadgen's talkers send */
+#define NETBENCH_VOICE_SAMPLE_RATE 16000U
+#define NETBENCH_VOICE_FRAME_COUNT 320U
+
+typedef struct NetbenchCounters {
+    uint64_t server_received;
+    uint64_t server_sent;
+    uint64_t clients_received;
+    double server_cpu;
+} NetbenchCounters;
+
+static double netbench_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* CPU time of the calling thread, so only the server's share is measured */
+static double netbench_cpu_now(void)
+{
+#ifdef _WIN32
+    FILETIME creation, exit_time, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit_time, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* Receive-only mode: each sender thread floods from its share of the clients
+ * for the whole run, while the main thread only drains the server. */
+typedef struct NetbenchSender {
+    ENetHost **clients;
+    ENetPeer **peers;
+    size_t count;
+    const uint8_t *payload;
+    size_t size;
+    size_t burst;
+    double duration;
+    uint64_t sent;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} NetbenchSender;
+
+static void netbench_sender_loop(NetbenchSender *sender)
+{
+    double end = netbench_now() + sender->duration;
+    while (netbench_now() < end) {
+        for (size_t i = 0; i < sender->count; ++i) {
+            for (size_t b = 0; b < sender->burst; ++b) {
+                ENetPacket *packet = enet_packet_create(sender->payload, sender->size, 0);
+                if (packet && enet_peer_send(sender->peers[i], 0, packet) != 0) {
+                    enet_packet_destroy(packet);
+                    continue;
+                }
+                sender->sent += 1;
+            }
+            enet_host_flush(sender->clients[i]);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI netbench_sender_thread(LPVOID param)
+{
+    netbench_sender_loop((NetbenchSender *)param);
+    return 0;
+}
+#else
+static void *netbench_sender_thread(void *param)
+{
+    netbench_sender_loop((NetbenchSender *)param);
+    return NULL;
+}
+#endif
+
+static int netbench_run_receive_only(ENetHost *server,
+                                     ENetHost **clients,
+                                     ENetPeer **peers,
+                                     size_t client_count,
+                                     const uint8_t *payload,
+                                     size_t size,
+                                     size_t burst,
+                                     double duration,
+                                     size_t sender_count,
+                                     size_t shards)
+{
+    NetbenchSender senders[NETBENCH_MAX_SENDERS];
+    memset(senders, 0, sizeof(senders));
+    size_t per_sender = (client_count + sender_count - 1) / sender_count;
+    size_t started = 0;
+    for (size_t t = 0; t < sender_count; ++t) {
+        NetbenchSender *sender = &senders[t];
+        size_t first = t * per_sender;
+        if (first >= client_count) {
+            break;
+        }
+        sender->clients = clients + first;
+        sender->peers = peers + first;
+        sender->count = (client_count - first < per_sender) ? client_count - first : per_sender;
+        sender->payload = payload;
+        sender->size = size;
+        sender->burst = burst;
+        sender->duration = duration;
+#ifdef _WIN32
+        sender->thread = CreateThread(NULL, 0, netbench_sender_thread, sender, 0, NULL);
+        if (!sender->thread) {
+            break;
+        }
+#else
+        if (pthread_create(&sender->thread, NULL, netbench_sender_thread, sender) != 0) {
+            break;
+        }
+#endif
+        ++started;
+    }
+
+    uint64_t received = 0;
+    double cpu = netbench_cpu_now();
+    double start = netbench_now();
+    double end = start + duration;
+    while (netbench_now() < end) {
+        ENetEvent event;
+        while (enet_host_service(server, &event, 1) > 0) {
+            if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                received += 1;
+                enet_packet_destroy(event.packet);
+            }
+        }
+    }
+    double wall = netbench_now() - start;
+    cpu = netbench_cpu_now() - cpu;
+
+    uint64_t sent = 0;
+    for (size_t t = 0; t < started; ++t) {
+#ifdef _WIN32
+        WaitForSingleObject(senders[t].thread, INFINITE);
+        CloseHandle(senders[t].thread);
+#else
+        pthread_join(senders[t].thread, NULL);
+#endif
+        sent += senders[t].sent;
+    }
+
+    printf("[netbench] receive only, %zu shards, %zu sender threads: sent %llu, server received %llu in %.2f s "
+           "(%.0f/s, %.1f%% delivered), server thread cpu %.2f s\n",
+           shards,
+           started,
+           (unsigned long long)sent,
+           (unsigned long long)received,
+           wall,
+           (double)received / wall,
+           sent > 0 ? 100.0 * (double)received / (double)sent : 0.0,
+           cpu);
+    return started == sender_count ? 0 : 1;
+}
+
+/* Relay mode: the server fans `burst` bodies out to every peer behind a
+ * two-byte per-peer header, the shape of a voice relay. `shared` sends one
+ * packet per body with enet_peer_send_with_header; otherwise every peer gets
+ * its own packet with the header and a copy of the body. Returns the server
+ * thread CPU time spent. */
+static double netbench_relay_pass(ENetHost *server,
+                                  ENetHost **clients,
+                                  ENetPeer **server_peers,
+                                  size_t client_count,
+                                  const uint8_t *payload,
+                                  size_t size,
+                                  size_t burst,
+                                  double duration,
+                                  int shared,
+                                  uint64_t *relayed)
+{
+    uint8_t copy[2 + NETBENCH_MAX_SIZE];
+    double cpu = 0.0;
+    double end = netbench_now() + duration;
+    while (netbench_now() < end) {
+        double start = netbench_cpu_now();
+        for (size_t b = 0; b < burst; ++b) {
+            ENetPacket *body = shared ? enet_packet_create(payload, size, 0) : NULL;
+            for (size_t i = 0; i < client_count; ++i) {
+                uint8_t header[2] = {0x08, (uint8_t)i};
+                if (shared) {
+                    if (body && enet_peer_send_with_header(server_peers[i], 0, header, sizeof(header), body) == 0) {
+                        *relayed += 1;
+                    }
+                    continue;
+                }
+                memcpy(copy, header, sizeof(header));
+                memcpy(copy + sizeof(header), payload, size);
+                ENetPacket *packet = enet_packet_create(copy, sizeof(header) + size, 0);
+                if (packet && enet_peer_send(server_peers[i], 0, packet) != 0) {
+                    enet_packet_destroy(packet);
+                    continue;
+                }
+                *relayed += 1;
+            }
+            if (body) {
+                enet_packet_destroy(body);
+            }
+        }
+        enet_host_flush(server);
+        cpu += netbench_cpu_now() - start;
+
+        for (size_t i = 0; i < client_count; ++i) {
+            ENetEvent event;
+            while (enet_host_service(clients[i], &event, 0) > 0) {
+                if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                    enet_packet_destroy(event.packet);
+                }
+            }
+        }
+    }
+    return cpu;
+}
+
+static void netbench_run_relay(ENetHost *server,
+                               ENetHost **clients,
+                               ENetPeer **server_peers,
+                               size_t client_count,
+                               const uint8_t *payload,
+                               size_t size,
+                               size_t burst,
+                               double duration)
+{
+    printf("[netbench] relay, %zu peers, %zu byte bodies, %zu per round, %.1f s per mode\n",
+           client_count, size, burst, duration);
+
+    double rates[2];
+    for (int shared = 0; shared < 2; ++shared) {
+        uint64_t relayed = 0;
+        double cpu = netbench_relay_pass(server, clients, server_peers, client_count, payload, size, burst, duration, shared, &relayed);
+        rates[shared] = cpu > 0.0 ? (double)relayed / cpu : 0.0;
+        printf("[netbench] relay %s: %llu datagrams, server cpu %.2f s, %.0f datagrams/s per core\n",
+               shared ? "with shared body" : "with per-peer copy",
+               (unsigned long long)relayed,
+               cpu,
+               rates[shared]);
+    }
+    if (rates[0] > 0.0) {
+        printf("[netbench] shared body relays %.2fx the per-peer copy\n", rates[1] / rates[0]);
+    }
+}
+
+/* Voice mode: a NetworkServer with one talker and `listener_count`
+ * listeners on loopback, everyone in range. Each round the talker sends
+ * `burst` frames and the server thread drains them with a zero-length
+ * network_server_update, so no tick runs and the CPU time measured is the
+ * receive plus network_server_relay_voice for those frames. */
+static int netbench_voice_pass(uint16_t port, size_t listener_count, size_t burst, double duration)
+{
+    NetworkServerConfig server_config;
+    memset(&server_config, 0, sizeof(server_config));
+    server_config.port = port;
+    server_config.max_clients = (uint32_t)listener_count + 1U;
+    server_config.name = "netbench";
+    server_config.voice_mode = NETWORK_VOICE_CHAT_GLOBAL;
+    NetworkServer *server = network_server_create(&server_config);
+    if (!server) {
+        fprintf(stderr, "[netbench] failed to create the server on port %u\n", (unsigned)port);
+        return 1;
+    }
+
+    NetworkClient *clients[NETBENCH_VOICE_MAX_LISTENERS + 1];
+    size_t client_count = listener_count + 1;
+    NetworkClientConfig client_config;
+    memset(&client_config, 0, sizeof(client_config));
+    client_config.host = "127.0.0.1";
+    client_config.port = port;
+    for (size_t i = 0; i < client_count; ++i) {
+        clients[i] = network_client_create(&client_config);
+        if (!clients[i]) {
+            fprintf(stderr, "[netbench] failed to create client %zu\n", i);
+            return 1;
+        }
+        network_client_connect(clients[i]);
+    }
+
+    // Tout le monde doit avoir un état côté serveur avant d'être relayé
+    NetworkPlayerCommand command;
+    memset(&command, 0, sizeof(command));
+    command.duration = NETBENCH_VOICE_TICK;
+    double deadline = netbench_now() + 5.0;
+    while (netbench_now() < deadline && network_server_stats(server)->commands_processed < client_count * 30U) {
+        network_server_update(server, NETBENCH_VOICE_TICK);
+        for (size_t i = 0; i < client_count; ++i) {
+            network_client_update(clients[i], NETBENCH_VOICE_TICK);
+            (void)network_client_send_player_command(clients[i], &command);
+        }
+    }
+    if (network_server_stats(server)->connected_clients < client_count) {
+        fprintf(stderr, "[netbench] only %u/%zu voice clients connected\n",
+                network_server_stats(server)->connected_clients, client_count);
+        return 1;
+    }
+
+    NetworkVoicePacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.codec = NETWORK_VOICE_CODEC_PCM16;
+    packet.channels = 1;
+    packet.sample_rate = (uint16_t)NETBENCH_VOICE_SAMPLE_RATE;
+    packet.frame_count = (uint16_t)NETBENCH_VOICE_FRAME_COUNT;
+    packet.volume = 1.0f;
+    packet.data_size = network_voice_payload_size(packet.codec, packet.frame_count, packet.channels);
+    for (size_t i = 0; i < packet.data_size; ++i) {
+        packet.data[i] = (uint8_t)(i * 7U);
+    }
+
+    uint64_t sent = 0;
+    uint64_t relays = network_server_stats(server)->messages_sent;
+    double cpu = 0.0;
+    double end = netbench_now() + duration;
+    while (netbench_now() < end) {
+        for (size_t b = 0; b < burst; ++b) {
+            sent += network_client_send_voice_packet(clients[0], &packet) ? 1U : 0U;
+        }
+
+        double start = netbench_cpu_now();
+        network_server_update(server, 0.0f);
+        cpu += netbench_cpu_now() - start;
+
+        NetworkVoicePacket received[8];
+        for (size_t i = 1; i < client_count; ++i) {
+            network_client_update(clients[i], 0.0f);
+            while (network_client_dequeue_voice_packets(clients[i], received, 8) == 8) {
+            }
+        }
+    }
+    relays = network_server_stats(server)->messages_sent - relays;
+
+    /* each relayed frame is one message per listener */
+    double frames = (double)relays / (double)listener_count;
+    printf("[netbench] voice relay, %2zu listeners: %llu frames sent, %.0f relayed, server cpu %.3f s, "
+           "%.2f us per frame (%.0f ns per listener)\n",
+           listener_count,
+           (unsigned long long)sent,
+           frames,
+           cpu,
+           frames > 0.0 ? cpu * 1e6 / frames : 0.0,
+           relays > 0U ? cpu * 1e9 / (double)relays : 0.0);
+
+    for (size_t i = 0; i < client_count; ++i) {
+        network_client_destroy(clients[i]);
+    }
+    network_server_destroy(server);
+    return frames > 0.0 ? 0 : 1;
+}
+
+static int netbench_run_voice(uint16_t port, size_t burst, double duration)
+{
+    static const size_t listener_counts[] = {8, 32, 64};
+    const size_t sweeps = sizeof(listener_counts) / sizeof(listener_counts[0]);
+    printf("[netbench] voice relay through the server, %u byte frames, %zu per round, %.1f s per listener count\n",
+           (unsigned)network_voice_payload_size(NETWORK_VOICE_CODEC_PCM16, NETBENCH_VOICE_FRAME_COUNT, 1),
+           burst,
+           duration);
+
+    int result = 0;
+    for (size_t i = 0; i < sweeps; ++i) {
+        result |= netbench_voice_pass((uint16_t)(port + i), listener_counts[i], burst, duration);
+    }
+    return result;
+}
+
+/* Services the server until it has nothing left and answers with one
+ * broadcast, which is what a tick of the game server amounts to. */
+static void netbench_server_round(ENetHost *server, const uint8_t *payload, size_t size, size_t peers, NetbenchCounters *counters)
+{
+    double start = netbench_cpu_now();
+
+    ENetEvent event;
+    while (enet_host_service(server, &event, 0) > 0) {
+        if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+            counters->server_received += 1;
+            enet_packet_destroy(event.packet);
+        }
+    }
+
+    ENetPacket *packet = enet_packet_create(payload, size, 0);
+    if (packet) {
+        enet_host_broadcast(server, 0, packet);
+        enet_host_flush(server);
+        counters->server_sent += peers;
+    }
+
+    counters->server_cpu += netbench_cpu_now() - start;
+}
+
+int main(int argc, char** argv)
+{
+    size_t client_count = 64;
+    size_t size = 64;
+    size_t burst = 4;
+    double duration = 5.0;
+    uint16_t port = 26200;
+    size_t shards = 1;
+    size_t senders = 0;
+    int relay = 0;
+    int voice = 0;
+
+    // Arguments minimalistes: --clients 64 --size 64 --burst 4 --duration 5
+    // --shards n: sockets de réception du serveur; --senders n: mode réception seule
+    // --relay: diffusion d'un même corps à tous les pairs (copie vs corps partagé)
+    // --voice: relais vocal du serveur vers 8, 32 puis 64 auditeurs
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--clients")==0 && i + 1 < argc) client_count = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size")==0 && i + 1 < argc) size = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--burst")==0 && i + 1 < argc) burst = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--duration")==0 && i + 1 < argc) duration = atof(argv[++i]);
+        else if (strcmp(argv[i], "--port")==0 && i + 1 < argc) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--shards")==0 && i + 1 < argc) shards = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--senders")==0 && i + 1 < argc) senders = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--relay")==0) relay = 1;
+        else if (strcmp(argv[i], "--voice")==0) voice = 1;
+        else {
+            fprintf(stderr, "usage: netbench [--clients n] [--size bytes] [--burst n] [--duration s] [--port p] "
+                            "[--shards n] [--senders n] [--relay] [--voice]\n");
+            return 1;
+        }
+    }
+    if (client_count == 0 || client_count > NETBENCH_MAX_CLIENTS) client_count = 64;
+    if (size == 0 || size > NETBENCH_MAX_SIZE) size = 64;
+    if (senders > NETBENCH_MAX_SENDERS) senders = NETBENCH_MAX_SENDERS;
+
+    if (voice) {
+        return netbench_run_voice(port, burst, duration / 3.0);
+    }
+
+    if (enet_initialize() != 0) {
+        fprintf(stderr, "[netbench] enet_initialize failed\n");
+        return 1;
+    }
+
+    ENetAddress address;
+    address.host = 0;
+    address.port = port;
+    ENetHost *server = enet_host_create_sharded(&address, client_count, 1, 0, 0, shards);
+    ENetHost **clients = (ENetHost **)calloc(client_count, sizeof(ENetHost *));
+    ENetPeer **peers = (ENetPeer **)calloc(client_count, sizeof(ENetPeer *));
+    ENetPeer **server_peers = (ENetPeer **)calloc(client_count, sizeof(ENetPeer *));
+    if (!server || !clients || !peers || !server_peers) {
+        fprintf(stderr, "[netbench] failed to create the server on port %u\n", (unsigned)port);
+        return 1;
+    }
+
+    uint8_t payload[NETBENCH_MAX_SIZE];
+    for (size_t i = 0; i < sizeof(payload); ++i) {
+        payload[i] = (uint8_t)i;
+    }
+
+    // Connexion de tous les clients en boucle locale avant de mesurer
+    address.host = 0x7F000001u;
+    size_t connected = 0;
+    size_t accepted = 0;
+    for (size_t i = 0; i < client_count; ++i) {
+        clients[i] = enet_host_create(NULL, 1, 1, 0, 0);
+        peers[i] = clients[i] ? enet_host_connect(clients[i], &address, 1, 0) : NULL;
+    }
+    double deadline = netbench_now() + 5.0;
+    while ((connected < client_count || accepted < client_count) && netbench_now() < deadline) {
+        ENetEvent event;
+        while (enet_host_service(server, &event, 0) > 0) {
+            if (event.type == ENET_EVENT_TYPE_CONNECT && accepted < client_count) {
+                server_peers[accepted++] = event.peer;
+            }
+        }
+        for (size_t i = 0; i < client_count; ++i) {
+            while (clients[i] && enet_host_service(clients[i], &event, 0) > 0) {
+                if (event.type == ENET_EVENT_TYPE_CONNECT) {
+                    ++connected;
+                }
+            }
+        }
+    }
+    if (connected < client_count || accepted < client_count) {
+        fprintf(stderr, "[netbench] only %zu/%zu clients connected\n", connected, client_count);
+        return 1;
+    }
+
+
+    if (senders > 0 || relay) {
+        int result = 0;
+        if (relay) {
+            netbench_run_relay(server, clients, server_peers, client_count, payload, size, burst, duration / 2.0);
+        } else {
+            result = netbench_run_receive_only(server, clients, peers, client_count, payload, size, burst, duration, senders, shards);
+        }
+        for (size_t i = 0; i < client_count; ++i) {
+            enet_host_destroy(clients[i]);
+        }
+        enet_host_destroy(server);
+        free(clients);
+        free(peers);
+        free(server_peers);
+        enet_deinitialize();
+        return result;
+    }
+
+    printf("[netbench] %zu clients, %zu byte packets, %zu per client per round, %.1f s\n",
+           client_count, size, burst, duration);
+
+    NetbenchCounters counters;
+    memset(&counters, 0, sizeof(counters));
+    uint64_t rounds = 0;
+    double start = netbench_now();
+    double end = start + duration;
+    while (netbench_now() < end) {
+        for (size_t i = 0; i < client_count; ++i) {
+            for (size_t b = 0; b < burst; ++b) {
+                ENetPacket *packet = enet_packet_create(payload, size, 0);
+                if (packet && enet_peer_send(peers[i], 0, packet) != 0) {
+                    enet_packet_destroy(packet);
+                }
+            }
+            enet_host_flush(clients[i]);
+        }
+
+        netbench_server_round(server, payload, size, client_count, &counters);
+
+        for (size_t i = 0; i < client_count; ++i) {
+            ENetEvent event;
+            while (enet_host_service(clients[i], &event, 0) > 0) {
+                if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                    counters.clients_received += 1;
+                    enet_packet_destroy(event.packet);
+                }
+            }
+        }
+        ++rounds;
+    }
+    double wall = netbench_now() - start;
+
+    uint64_t server_packets = counters.server_received + counters.server_sent;
+    printf("[netbench] %llu rounds in %.2f s: server received %llu (%.0f/s), sent %llu (%.0f/s), "
+           "clients received %llu\n",
+           (unsigned long long)rounds,
+           wall,
+           (unsigned long long)counters.server_received,
+           (double)counters.server_received / wall,
+           (unsigned long long)counters.server_sent,
+           (double)counters.server_sent / wall,
+           (unsigned long long)counters.clients_received);
+    printf("[netbench] server cpu %.2f s: %.0f packets/s per core\n",
+           counters.server_cpu,
+           counters.server_cpu > 0.0 ? (double)server_packets / counters.server_cpu : 0.0);
+
+    ENetPacketPoolStats pool;
+    enet_host_packet_pool_stats(server, &pool);
+    printf("[netbench] server packet pool: %llu hits, %llu misses, %llu pooled\n",
+           (unsigned long long)pool.hits,
+           (unsigned long long)pool.misses,
+           (unsigned long long)pool.pooled);
+
+    for (size_t i = 0; i < client_count; ++i) {
+        enet_host_destroy(clients[i]);
+    }
+    enet_host_destroy(server);
+    free(clients);
+    free(peers);
+    free(server_peers);
+    enet_deinitialize();
+    return 0;
+}
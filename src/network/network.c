@@ -1,5 +1,49 @@
 #include "engine/network.h"
 
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "enet.h"
+
+#include "engine/network_adpcm.h"
+#include "engine/network_conditions.h"
+#include "engine/player.h"
+
+size_t network_voice_payload_size(NetworkVoiceCodec codec, uint16_t frame_count, uint8_t channels)
+{
+    if (frame_count == 0U || channels == 0U || channels > NETWORK_VOICE_MAX_CHANNELS) {
+        return 0;
+    }
+
+    size_t pcm_size = (size_t)frame_count * channels * sizeof(int16_t);
+    if (pcm_size > NETWORK_VOICE_MAX_DATA) {
+        return 0;
+    }
+
+    switch (codec) {
+    case NETWORK_VOICE_CODEC_PCM16:
+        return pcm_size;
+    case NETWORK_VOICE_CODEC_IMA_ADPCM:
+        return network_adpcm_encoded_size(frame_count, channels);
+    default:
+        return 0;
+    }
+}
+
+void network_player_command_to_input(const NetworkPlayerCommand *command, PlayerCommand *input)
+{
+    if (!command || !input) {
+        return;
+    }
+
+    player_reset_command(input);
+    input->move_direction = vec3_make(command->move_direction[0], command->move_direction[1], command->move_direction[2]);
+    input->move_magnitude = command->move_magnitude;
+    input->vertical_axis = command->vertical_axis;
+    input->jump_requested = command->jump;
+    input->sprint = command->sprint;
+}
+
 bool network_fetch_master_list(const MasterClientConfig *config,
                                MasterServerEntry *out_entries,
                                size_t max_entries,
@@ -31,3 +75,88 @@ bool network_fetch_master_list(const MasterClientConfig *config,
 
     return success;
 }
+
+/* case-insensitive, with '-' and '_' interchangeable */
+static bool network_conditions_name_equal(const char *a, const char *b)
+{
+    while (*a && *b) {
+        char ca = (*a == '-') ? '_' : (char)tolower((unsigned char)*a);
+        char cb = (*b == '-') ? '_' : (char)tolower((unsigned char)*b);
+        if (ca != cb) {
+            return false;
+        }
+        ++a;
+        ++b;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+bool network_conditions_set(NetworkConditions *conditions, const char *name, const char *value)
+{
+    if (!conditions || !name || !value) {
+        return false;
+    }
+
+    if (network_conditions_name_equal(name, "latency")) {
+        conditions->latency_ms = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "jitter")) {
+        conditions->jitter_ms = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "jitter_dist")) {
+        if (network_conditions_name_equal(value, "uniform")) {
+            conditions->jitter_distribution = NETWORK_JITTER_UNIFORM;
+        } else if (network_conditions_name_equal(value, "normal")) {
+            conditions->jitter_distribution = NETWORK_JITTER_NORMAL;
+        } else if (network_conditions_name_equal(value, "pareto")) {
+            conditions->jitter_distribution = NETWORK_JITTER_PARETO;
+        } else {
+            return false;
+        }
+    } else if (network_conditions_name_equal(name, "loss")) {
+        conditions->loss = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "loss_burst")) {
+        conditions->loss_burst = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "duplicate")) {
+        conditions->duplicate = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "reorder")) {
+        conditions->reorder = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "reorder_ms")) {
+        conditions->reorder_ms = strtof(value, NULL);
+    } else if (network_conditions_name_equal(name, "seed")) {
+        conditions->seed = (uint32_t)strtoul(value, NULL, 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool network_conditions_apply(ENetHost *host, const NetworkConditions *conditions)
+{
+    if (!host) {
+        return false;
+    }
+    if (!conditions) {
+        return enet_host_simulate(host, NULL) == 0;
+    }
+
+    ENetSimulatorSettings settings;
+    settings.seed = conditions->seed;
+    settings.latencyMs = conditions->latency_ms;
+    settings.jitterMs = conditions->jitter_ms;
+    switch (conditions->jitter_distribution) {
+    case NETWORK_JITTER_NORMAL:
+        settings.jitterDistribution = ENET_SIMULATOR_NORMAL;
+        break;
+    case NETWORK_JITTER_PARETO:
+        settings.jitterDistribution = ENET_SIMULATOR_PARETO;
+        break;
+    default:
+        settings.jitterDistribution = ENET_SIMULATOR_UNIFORM;
+        break;
+    }
+    settings.loss = conditions->loss;
+    settings.lossBurst = conditions->loss_burst;
+    settings.duplicate = conditions->duplicate;
+    settings.reorder = conditions->reorder;
+    settings.reorderMs = conditions->reorder_ms;
+    return enet_host_simulate(host, &settings) == 0;
+}
@@ -0,0 +1,238 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#endif
+
+#include "engine/network_server.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+/* trace layout written by enet_host_capture_start */
+#define REPLAY_MAGIC "SPTRACE1"
+#define REPLAY_MAGIC_SIZE 8
+#define REPLAY_RECORD_HEADER 11
+#define REPLAY_RECEIVED 0
+
+typedef struct ReplayTrace {
+    uint8_t *data;
+    size_t size;
+    uint64_t received;
+    uint64_t sent;
+    double duration;
+} ReplayTrace;
+
+typedef struct ReplayResult {
+    double wall_seconds;
+    uint64_t injected;
+    NetworkServerStats stats;
+} ReplayResult;
+
+static double replay_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static uint32_t replay_read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Loads the whole trace and checks every record fits before anything is replayed. */
+static int replay_load(const char *path, ReplayTrace *trace)
+{
+    memset(trace, 0, sizeof(*trace));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "[replay] cannot open %s\n", path);
+        return 0;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (length < REPLAY_MAGIC_SIZE) {
+        fprintf(stderr, "[replay] %s is not a trace\n", path);
+        fclose(fp);
+        return 0;
+    }
+
+    trace->data = (uint8_t *)malloc((size_t)length);
+    if (!trace->data || fread(trace->data, 1, (size_t)length, fp) != (size_t)length) {
+        fprintf(stderr, "[replay] failed to read %s\n", path);
+        free(trace->data);
+        trace->data = NULL;
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    trace->size = (size_t)length;
+
+    if (memcmp(trace->data, REPLAY_MAGIC, REPLAY_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "[replay] %s is not a trace\n", path);
+        return 0;
+    }
+
+    size_t offset = REPLAY_MAGIC_SIZE;
+    while (offset + REPLAY_RECORD_HEADER <= trace->size) {
+        const uint8_t *record = trace->data + offset;
+        size_t datagram = (size_t)(record[9] | ((size_t)record[10] << 8));
+        if (offset + REPLAY_RECORD_HEADER + datagram > trace->size) {
+            break;
+        }
+        trace->duration += (double)replay_read_u32(record + 1) * 1e-6;
+        if (record[0] == REPLAY_RECEIVED) {
+            trace->received += 1;
+        } else {
+            trace->sent += 1;
+        }
+        offset += REPLAY_RECORD_HEADER + datagram;
+    }
+    if (offset != trace->size) {
+        /* a live capture can end mid-record; replay what is complete */
+        printf("[replay] ignoring %zu trailing bytes\n", trace->size - offset);
+        trace->size = offset;
+    }
+    return 1;
+}
+
+/* Feeds every received datagram through a fresh offline server. Time follows
+ * the trace, not the wall clock: each update gets the trace time elapsed since
+ * the previous one, so ticks line up with the capture and runs are
+ * repeatable. */
+static int replay_run(const ReplayTrace *trace, const NetworkServerConfig *base, ReplayResult *result)
+{
+    NetworkServerConfig cfg = *base;
+    cfg.offline = true;
+    cfg.capture_path = NULL;
+
+    NetworkServer *server = network_server_create(&cfg);
+    if (!server) {
+        fprintf(stderr, "[replay] failed to create offline server\n");
+        return 0;
+    }
+
+    memset(result, 0, sizeof(*result));
+    double pending = 0.0;
+    double start = replay_now();
+
+    size_t offset = REPLAY_MAGIC_SIZE;
+    while (offset < trace->size) {
+        const uint8_t *record = trace->data + offset;
+        size_t datagram = (size_t)(record[9] | ((size_t)record[10] << 8));
+        offset += REPLAY_RECORD_HEADER + datagram;
+
+        pending += (double)replay_read_u32(record + 1) * 1e-6;
+        if (record[0] != REPLAY_RECEIVED) {
+            continue;
+        }
+
+        uint32_t peer = replay_read_u32(record + 5);
+        if (!network_server_inject(server, peer, record + REPLAY_RECORD_HEADER, datagram)) {
+            continue;
+        }
+        result->injected += 1;
+        network_server_update(server, (float)pending);
+        pending = 0.0;
+    }
+    network_server_update(server, (float)pending);
+
+    result->wall_seconds = replay_now() - start;
+    result->stats = *network_server_stats(server);
+    network_server_destroy(server);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: replay <trace> [--max n] [--tick-rate hz] [--snapshot-rate hz] "
+                        "[--relevance r] [--voice-mode global|proximity] [--repeat n]\n");
+        return 1;
+    }
+
+    // Doit correspondre à la config du serveur capturé pour reproduire le même trafic
+    NetworkServerConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.max_clients = 255;
+    cfg.name = "replay";
+    cfg.voice_mode = NETWORK_VOICE_CHAT_PROXIMITY;
+    cfg.voice_range = 22.0f;
+    cfg.tick_rate = 60.0f;
+    cfg.snapshot_rate = 20.0f;
+    cfg.relevance_radius = 120.0f;
+    network_quantization_default(&cfg.quantization);
+
+    unsigned repeat = 3;
+    for (int i=2; i+1<argc; ++i){
+        if (strcmp(argv[i], "--max")==0) cfg.max_clients = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tick-rate")==0) cfg.tick_rate = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--snapshot-rate")==0) cfg.snapshot_rate = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--relevance")==0) cfg.relevance_radius = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--voice-mode")==0) {
+            cfg.voice_mode = strcmp(argv[++i], "global")==0 ? NETWORK_VOICE_CHAT_GLOBAL : NETWORK_VOICE_CHAT_PROXIMITY;
+        }
+        else if (strcmp(argv[i], "--repeat")==0) repeat = (unsigned)atoi(argv[++i]);
+    }
+    if (repeat == 0U) {
+        repeat = 1;
+    }
+
+    ReplayTrace trace;
+    if (!replay_load(argv[1], &trace)) {
+        free(trace.data);
+        return 1;
+    }
+    printf("[replay] %s: %llu received, %llu sent datagrams over %.1f s\n",
+           argv[1],
+           (unsigned long long)trace.received,
+           (unsigned long long)trace.sent,
+           trace.duration);
+
+    double best = 0.0;
+    for (unsigned run = 0; run < repeat; ++run) {
+        ReplayResult result;
+        if (!replay_run(&trace, &cfg, &result)) {
+            free(trace.data);
+            return 1;
+        }
+        double rate = result.wall_seconds > 0.0 ? (double)result.injected / result.wall_seconds : 0.0;
+        if (rate > best) {
+            best = rate;
+        }
+        printf("[replay] run %u: %llu datagrams in %.3f s (%.0f/s, %.0fx real time), %u ticks, "
+               "%llu commands, %llu messages in %llu datagrams sent (trace: %llu), "
+               "packet pool %llu hits / %llu misses\n",
+               run + 1U,
+               (unsigned long long)result.injected,
+               result.wall_seconds,
+               rate,
+               result.wall_seconds > 0.0 ? trace.duration / result.wall_seconds : 0.0,
+               result.stats.tick,
+               (unsigned long long)result.stats.commands_processed,
+               (unsigned long long)result.stats.messages_sent,
+               (unsigned long long)result.stats.datagrams_sent,
+               (unsigned long long)trace.sent,
+               (unsigned long long)result.stats.packet_pool_hits,
+               (unsigned long long)result.stats.packet_pool_misses);
+    }
+    printf("[replay] best: %.0f datagrams/s\n", best);
+
+    free(trace.data);
+    return 0;
+}
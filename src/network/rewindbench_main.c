@@ -0,0 +1,194 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#endif
+
+#include "engine/network.h"
+#include "engine/network_server.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+#define REWINDBENCH_MAX_PLAYERS 200
+#define REWINDBENCH_TICK (1.0f / 60.0f)
+/* a second of history plus time for everyone to connect and spread out */
+#define REWINDBENCH_WARMUP_SECONDS 3.0f
+#define REWINDBENCH_PI 3.14159265358979323846f
+
+static double rewindbench_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static uint32_t rewindbench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static float rewindbench_randf(uint32_t *state)
+{
+    return (float)(rewindbench_rand(state) & 0xFFFFFFU) / (float)0x1000000;
+}
+
+/* Runs the server and its bots for `seconds` of simulation time, each bot
+ * walking out from the spawn along its own heading and back. */
+static void rewindbench_simulate(NetworkServer *server, NetworkClient **clients, size_t count, float seconds, float *clock)
+{
+    int frames = (int)(seconds / REWINDBENCH_TICK);
+    for (int f = 0; f < frames; ++f) {
+        network_server_update(server, REWINDBENCH_TICK);
+        for (size_t i = 0; i < count; ++i) {
+            network_client_update(clients[i], REWINDBENCH_TICK);
+
+            float heading = 2.0f * REWINDBENCH_PI * (float)i / (float)count;
+            float sign = fmodf(*clock, 4.0f) < 2.0f ? 1.0f : -1.0f;
+            NetworkPlayerCommand command;
+            memset(&command, 0, sizeof(command));
+            command.duration = REWINDBENCH_TICK;
+            command.move_direction[0] = cosf(heading) * sign;
+            command.move_direction[2] = sinf(heading) * sign;
+            command.move_magnitude = 1.0f;
+            command.yaw = heading;
+            (void)network_client_send_player_command(clients[i], &command);
+        }
+        *clock += REWINDBENCH_TICK;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t player_count = 64;
+    size_t ray_count = 1000000;
+    uint16_t port = 26300;
+
+    // Arguments minimalistes: --players 64 --rays 1000000 --port 26300
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) player_count = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) ray_count = (size_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) port = (uint16_t)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: rewindbench [--players n] [--rays n] [--port p]\n");
+            return 1;
+        }
+    }
+    if (player_count < 2 || player_count > REWINDBENCH_MAX_PLAYERS) player_count = 64;
+    if (ray_count == 0) ray_count = 1000000;
+
+    NetworkServerConfig server_config;
+    memset(&server_config, 0, sizeof(server_config));
+    server_config.port = port;
+    server_config.max_clients = (uint32_t)player_count;
+    server_config.name = "rewindbench";
+    NetworkServer *server = network_server_create(&server_config);
+    if (!server) {
+        fprintf(stderr, "[rewindbench] failed to create the server on port %u\n", (unsigned)port);
+        return 1;
+    }
+
+    NetworkClient *clients[REWINDBENCH_MAX_PLAYERS];
+    NetworkClientConfig client_config;
+    memset(&client_config, 0, sizeof(client_config));
+    client_config.host = "127.0.0.1";
+    client_config.port = port;
+    for (size_t i = 0; i < player_count; ++i) {
+        clients[i] = network_client_create(&client_config);
+        if (!clients[i]) {
+            fprintf(stderr, "[rewindbench] failed to create client %zu\n", i);
+            return 1;
+        }
+        network_client_connect(clients[i]);
+    }
+
+    float clock = 0.0f;
+    rewindbench_simulate(server, clients, player_count, REWINDBENCH_WARMUP_SECONDS, &clock);
+
+    const NetworkServerStats *stats = network_server_stats(server);
+    if (stats->connected_clients < player_count) {
+        fprintf(stderr, "[rewindbench] only %u/%zu players connected\n", stats->connected_clients, player_count);
+        return 1;
+    }
+
+    // Cibles: les joueurs tels que le premier client les voit
+    size_t target_count = 0;
+    const NetworkRemotePlayer *remote = network_client_remote_players(clients[0], &target_count);
+    NetworkRemotePlayer targets[REWINDBENCH_MAX_PLAYERS];
+    target_count = target_count < REWINDBENCH_MAX_PLAYERS ? target_count : REWINDBENCH_MAX_PLAYERS;
+    memcpy(targets, remote, sizeof(NetworkRemotePlayer) * target_count);
+    if (target_count == 0) {
+        fprintf(stderr, "[rewindbench] no players in the snapshots\n");
+        return 1;
+    }
+
+    printf("[rewindbench] %zu players, %zu rays over the last second of history\n", player_count, ray_count);
+
+    /* shots from 10-40 m away at a random target, aimed off by up to ~2 m,
+     * at a random time in the rewind window */
+    uint32_t rng = 0x9E3779B9u;
+    double now = network_server_time(server);
+    uint64_t hits = 0;
+    double checksum = 0.0;
+    double start = rewindbench_now();
+    for (size_t r = 0; r < ray_count; ++r) {
+        const NetworkRemotePlayer *target = &targets[rewindbench_rand(&rng) % target_count];
+        float angle = rewindbench_randf(&rng) * 2.0f * REWINDBENCH_PI;
+        float range = 10.0f + rewindbench_randf(&rng) * 30.0f;
+        float origin[3] = {
+            target->position[0] + cosf(angle) * range,
+            target->position[1] + 0.5f,
+            target->position[2] + sinf(angle) * range,
+        };
+        float direction[3];
+        float length = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float aim = target->position[axis] + (rewindbench_randf(&rng) - 0.5f) * 4.0f;
+            direction[axis] = aim - origin[axis];
+            length += direction[axis] * direction[axis];
+        }
+        length = sqrtf(length);
+        for (int axis = 0; axis < 3; ++axis) {
+            direction[axis] /= length;
+        }
+
+        double timestamp = now - (double)rewindbench_randf(&rng);
+        NetworkServerRewindHit hit;
+        if (network_server_rewind_raycast(server, timestamp, origin, direction, 250.0f, 0xFF, &hit)) {
+            hits += 1;
+            checksum += hit.distance;
+        }
+    }
+    double wall = rewindbench_now() - start;
+
+    printf("[rewindbench] %.3f s: %.0f rays/s, %.1f ns per ray, %.1f%% hit (checksum %.1f)\n",
+           wall,
+           (double)ray_count / wall,
+           wall * 1e9 / (double)ray_count,
+           100.0 * (double)hits / (double)ray_count,
+           checksum);
+
+    for (size_t i = 0; i < player_count; ++i) {
+        network_client_destroy(clients[i]);
+    }
+    network_server_destroy(server);
+    return 0;
+}
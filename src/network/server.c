@@ -1,3 +1,7 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#    define _POSIX_C_SOURCE 200809L /* getaddrinfo */
+#endif
+
 #include "engine/network_server.h"
 
 #include <math.h>
@@ -7,8 +11,12 @@
 
 #include "enet.h"
 
+#include "engine/game.h"
 #include "engine/master_protocol.h"
 #include "engine/network.h"
+#include "engine/network_bitpack.h"
+#include "engine/player.h"
+#include "engine/world.h"
 
 #if defined(_WIN32)
 #    define WIN32_LEAN_AND_MEAN
@@ -30,19 +38,74 @@ typedef int master_socket_t;
 #define NETWORK_MESSAGE_HELLO 0x01
 #define NETWORK_MESSAGE_WELCOME 0x02
 #define NETWORK_MESSAGE_PLAYER_COUNT 0x03
-#define NETWORK_MESSAGE_CLIENT_STATE 0x04
 #define NETWORK_MESSAGE_SERVER_SNAPSHOT 0x05
 #define NETWORK_MESSAGE_WEAPON_EVENT 0x06
 #define NETWORK_MESSAGE_CLIENT_WEAPON_EVENT 0x07
 #define NETWORK_MESSAGE_CLIENT_VOICE_DATA 0x08
 #define NETWORK_MESSAGE_VOICE_DATA 0x09
-
-#define NETWORK_WEAPON_EVENT_DATA_SIZE (1 + sizeof(uint16_t) + sizeof(int16_t) + sizeof(int16_t) + sizeof(uint32_t) + (sizeof(float) * 3))
-
-#define NETWORK_SERVER_SNAPSHOT_INTERVAL 0.05f
+#define NETWORK_MESSAGE_SNAPSHOT_ACK 0x0A
+#define NETWORK_MESSAGE_CLIENT_COMMAND 0x0B
+#define NETWORK_MESSAGE_BUNDLE 0x0C
+#define NETWORK_MESSAGE_PLAYER_STATE 0x0D
+
+#define NETWORK_WEAPON_EVENT_DATA_SIZE (1 + sizeof(uint16_t) + sizeof(int16_t) + sizeof(int16_t) + sizeof(uint32_t) + (sizeof(float) * 6) + sizeof(double) + 1)
+/* offsets into the weapon event payload: muzzle, aim, view time, hit id */
+#define NETWORK_WEAPON_EVENT_ORIGIN_OFFSET 11
+#define NETWORK_WEAPON_EVENT_DIRECTION_OFFSET 23
+#define NETWORK_WEAPON_EVENT_VIEW_TIME_OFFSET 35
+#define NETWORK_WEAPON_EVENT_HIT_OFFSET 43
+
+/* [type][sequence u16][baseline u16][flags][count][tick u32] */
+#define NETWORK_SNAPSHOT_HEADER_SIZE 11
+#define NETWORK_SNAPSHOT_FLAG_DELTA 0x01
+#define NETWORK_SNAPSHOT_FIELD_POS_X 0x01
+#define NETWORK_SNAPSHOT_FIELD_POS_Y 0x02
+#define NETWORK_SNAPSHOT_FIELD_POS_Z 0x04
+#define NETWORK_SNAPSHOT_FIELD_YAW 0x08
+#define NETWORK_SNAPSHOT_FIELD_NAME 0x10
+#define NETWORK_SNAPSHOT_FIELD_ALL 0x1F
+#define NETWORK_SNAPSHOT_FIELD_BITS 5
+#define NETWORK_SNAPSHOT_NAME_LENGTH_BITS 4
+#define NETWORK_SNAPSHOT_MAX_ENTITY_SIZE (2 + (sizeof(float) * 4) + NETWORK_MAX_PLAYER_NAME)
+
+#define NETWORK_SERVER_SNAPSHOT_HISTORY 32
+#define NETWORK_SERVER_MAX_SNAPSHOT_ENTITIES 256
+#define NETWORK_SERVER_GRID_BUCKETS 1024U
+#define NETWORK_SERVER_DEFAULT_RELEVANCE_RADIUS 120.0f
+#define NETWORK_SERVER_AOI_NEAR_FRACTION 0.35f
+#define NETWORK_SERVER_AOI_MID_FRACTION 0.7f
+#define NETWORK_SERVER_AOI_MID_DIVISOR 2U
+#define NETWORK_SERVER_AOI_FAR_DIVISOR 4U
+#define NETWORK_SERVER_DEFAULT_TICK_RATE 60.0f
+#define NETWORK_SERVER_DEFAULT_SNAPSHOT_RATE 20.0f
+#define NETWORK_SERVER_MAX_CATCHUP_TICKS 5U
+#define NETWORK_SERVER_COMMAND_QUEUE 32U
+/* seconds of simulation a client may bank; commands beyond it wait for later ticks */
+#define NETWORK_SERVER_MAX_COMMAND_BUDGET 0.25f
+#define NETWORK_SERVER_SPAWN_Z 6.0f
+#define NETWORK_SERVER_HISTORY_SECONDS 1.0f
+#define NETWORK_SERVER_FIRE_RANGE 250.0f
+/* how far a shot's muzzle may be from where the server has the shooter */
+#define NETWORK_SERVER_FIRE_ORIGIN_SLACK 3.0f
 #define MASTER_DEFAULT_HEARTBEAT 5.0f
 
 #define NETWORK_VOICE_RANGE 22.0f
+#define NETWORK_VOICE_RELAY_HEADER_SIZE 2
+#define NETWORK_VOICE_RELAY_BODY_SIZE 7
+
+/* [type][command sequence u32][position f32 x3][velocity f32 x3][flags][double jump timer f32] */
+#define NETWORK_PLAYER_STATE_SIZE (1 + 4 + 12 + 12 + 1 + 4)
+#define NETWORK_PLAYER_STATE_GROUNDED 0x01
+#define NETWORK_PLAYER_STATE_DOUBLE_JUMP 0x02
+
+/* outgoing frames stay under ENet's default MTU and the stub's datagram limit */
+#define NETWORK_SERVER_BUNDLE_MTU 1152U
+#define NETWORK_SERVER_BUNDLE_LENGTH_SIZE 2U
+/* flushed in index order: reliable first, so WELCOME leaves ahead of the
+ * first snapshot queued on the same tick */
+#define NETWORK_SERVER_BUNDLE_RELIABLE 0
+#define NETWORK_SERVER_BUNDLE_UNRELIABLE 1
+#define NETWORK_SERVER_BUNDLE_KINDS 2
 
 typedef struct NetworkServerMaster {
     int enabled;
@@ -55,6 +118,22 @@ typedef struct NetworkServerMaster {
     int registered;
 } NetworkServerMaster;
 
+typedef struct NetworkServerClientView {
+    uint16_t sequence;
+    uint8_t count;
+    int valid;
+    uint8_t ids[NETWORK_MAX_REMOTE_PLAYERS];
+    uint16_t source_sequence[NETWORK_MAX_REMOTE_PLAYERS];
+} NetworkServerClientView;
+
+/* [BUNDLE]([len u16][message])... packed into one datagram */
+typedef struct NetworkServerBundle {
+    enet_uint8 data[NETWORK_SERVER_BUNDLE_MTU];
+    size_t size;
+    uint32_t count;
+    enet_uint32 flags;
+} NetworkServerBundle;
+
 typedef struct NetworkServerClient {
     ENetPeer *peer;
     uint8_t id;
@@ -63,8 +142,64 @@ typedef struct NetworkServerClient {
     float yaw;
     int connected;
     int has_state;
+    uint16_t acked_sequence;
+    int has_ack;
+    NetworkServerClientView views[NETWORK_SERVER_SNAPSHOT_HISTORY];
+    PlayerState player;
+    NetworkPlayerCommand commands[NETWORK_SERVER_COMMAND_QUEUE];
+    uint32_t command_head;
+    uint32_t command_count;
+    uint32_t last_command_sequence;
+    uint32_t processed_command_sequence; /* newest command simulated, echoed to the client */
+    float command_budget;
+    /* messages queued since the last tick, sent by network_server_flush_client;
+     * reliable ones get their own bundle so snapshots and other unreliable
+     * messages are never retransmitted along with them */
+    NetworkServerBundle outgoing[NETWORK_SERVER_BUNDLE_KINDS];
 } NetworkServerClient;
 
+typedef struct NetworkServerSnapshotFrame {
+    uint16_t sequence;
+    uint32_t tick; /* server tick the state is from */
+    uint16_t count;
+    int valid;
+    uint16_t index_by_id[256];
+    NetworkRemotePlayer entities[NETWORK_SERVER_MAX_SNAPSHOT_ENTITIES];
+} NetworkServerSnapshotFrame;
+
+typedef struct NetworkServerSnapshotCandidate {
+    const NetworkRemotePlayer *entity;
+    float distance_sq;
+} NetworkServerSnapshotCandidate;
+
+/* Uniform XZ grid over client positions, hashed into a fixed bucket table and
+ * rebuilt every tick. Cells are relevance_radius wide. */
+typedef struct NetworkServerGrid {
+    float cell_size;
+    int32_t heads[NETWORK_SERVER_GRID_BUCKETS];
+    int32_t *next;
+    int32_t *cells;
+} NetworkServerGrid;
+
+typedef struct NetworkServerHistorySample {
+    uint8_t id;
+    uint8_t valid;
+    float position[3];
+    float half_extents[3];
+} NetworkServerHistorySample;
+
+/* Per-tick collider history for lag compensation. Frame for tick T lives in
+ * slot T % frame_capacity; its samples are the client_capacity entries at
+ * samples[slot * client_capacity], indexed by client slot. */
+typedef struct NetworkServerHistory {
+    uint32_t frame_capacity;
+    uint32_t *frame_ticks;
+    NetworkServerHistorySample *samples;
+    uint32_t oldest_tick;
+    uint32_t newest_tick;
+    int has_frames;
+} NetworkServerHistory;
+
 typedef struct NetworkServer {
     NetworkServerConfig config;
     ENetHost *host;
@@ -72,8 +207,24 @@ typedef struct NetworkServer {
     NetworkServerMaster master;
     NetworkServerClient *clients;
     uint32_t client_capacity;
-    uint8_t next_client_id;
-    float snapshot_timer;
+    uint32_t *free_slots;
+    uint32_t free_slot_count;
+    uint8_t free_ids[NETWORK_SERVER_MAX_CLIENTS];
+    uint16_t free_id_head;
+    uint16_t free_id_count;
+    int32_t slot_by_id[256];
+    float tick_interval;
+    float tick_accumulator;
+    uint32_t ticks_per_snapshot;
+    uint32_t ticks_since_snapshot;
+    NetworkServerSnapshotFrame snapshot_history[NETWORK_SERVER_SNAPSHOT_HISTORY];
+    uint16_t snapshot_sequence;
+    NetworkServerGrid grid;
+    GameWorld *world;
+    GameConfig game_config;
+    NetworkServerHistory history;
+    double tick_jitter_mean;
+    double tick_jitter_m2;
 } NetworkServer;
 
 static int g_enet_server_refcount = 0;
@@ -98,91 +249,205 @@ static void network_server_decrement_ref(void)
         enet_deinitialize();
     }
 }
+/* Connected peers carry their client slot in ENetPeer::data. */
 static NetworkServerClient *network_server_find_client(NetworkServer *server, ENetPeer *peer)
 {
-    if (!server || !server->clients || !peer) {
+    if (!server || !server->clients || !peer || !peer->data) {
         return NULL;
     }
 
-    for (uint32_t i = 0; i < server->client_capacity; ++i) {
-        NetworkServerClient *client = &server->clients[i];
-        if (client->connected && client->peer == peer) {
-            return client;
-        }
+    NetworkServerClient *client = (NetworkServerClient *)peer->data;
+    if (!client->connected || client->peer != peer) {
+        return NULL;
     }
-    return NULL;
+    return client;
 }
 
-static uint8_t network_server_generate_id(NetworkServer *server)
+static NetworkServerClient *network_server_acquire_client(NetworkServer *server, ENetPeer *peer)
 {
-    if (!server) {
-        return 0;
+    if (!server || !server->clients || !peer) {
+        return NULL;
+    }
+    if (server->free_slot_count == 0U || server->free_id_count == 0U) {
+        return NULL;
     }
 
-    for (uint16_t attempt = 0; attempt < 256; ++attempt) {
-        uint8_t candidate = server->next_client_id++;
-        if (candidate == 0xFF) {
-            continue;
-        }
+    /* ids are recycled first-in first-out so a reconnecting player does not
+     * immediately inherit the id (and client-side state) of one who just left */
+    uint8_t id = server->free_ids[server->free_id_head];
+    server->free_id_head = (uint16_t)((server->free_id_head + 1U) % NETWORK_SERVER_MAX_CLIENTS);
+    server->free_id_count -= 1U;
+
+    uint32_t slot = server->free_slots[--server->free_slot_count];
+    NetworkServerClient *client = &server->clients[slot];
+    memset(client, 0, sizeof(*client));
+    client->connected = 1;
+    client->peer = peer;
+    client->id = id;
+    snprintf(client->name, sizeof(client->name), "Player %02u", (unsigned)(client->id + 1U));
+    vec3 spawn = vec3_make(0.0f, server->game_config.player_height, NETWORK_SERVER_SPAWN_Z);
+    player_init(&client->player, &server->game_config, spawn);
+    client->position[0] = spawn.x;
+    client->position[1] = spawn.y;
+    client->position[2] = spawn.z;
+    client->yaw = 0.0f;
+    client->has_state = 1;
+
+    server->slot_by_id[id] = (int32_t)slot;
+    peer->data = client;
+    return client;
+}
 
-        int in_use = 0;
-        if (server->clients) {
-            for (uint32_t i = 0; i < server->client_capacity; ++i) {
-                const NetworkServerClient *client = &server->clients[i];
-                if (client->connected && client->id == candidate) {
-                    in_use = 1;
-                    break;
-                }
-            }
-        }
+static void network_server_release_client(NetworkServer *server, NetworkServerClient *client)
+{
+    if (!server || !server->clients || !client || !client->connected) {
+        return;
+    }
+
+    uint32_t slot = (uint32_t)(client - server->clients);
+    uint32_t tail = (server->free_id_head + server->free_id_count) % NETWORK_SERVER_MAX_CLIENTS;
+    server->free_ids[tail] = client->id;
+    server->free_id_count += 1U;
+    server->slot_by_id[client->id] = -1;
+    server->free_slots[server->free_slot_count++] = slot;
 
-        if (!in_use) {
-            return candidate;
+    if (client->peer) {
+        client->peer->data = NULL;
+    }
+    memset(client, 0, sizeof(*client));
+}
+
+/* Sends one of the client's bundles as a datagram. A bundle holding a single
+ * message goes out bare, without the bundle framing; it is only unordered if
+ * none of its messages needs ordering. */
+static void network_server_flush_bundle(NetworkServer *server, NetworkServerClient *client, NetworkServerBundle *bundle)
+{
+    if (bundle->count == 0U) {
+        return;
+    }
+
+    const enet_uint8 *data = bundle->data;
+    size_t size = bundle->size;
+    if (bundle->count == 1U) {
+        data += 1U + NETWORK_SERVER_BUNDLE_LENGTH_SIZE;
+        size -= 1U + NETWORK_SERVER_BUNDLE_LENGTH_SIZE;
+    }
+
+    ENetPacket *packet = client->peer ? enet_packet_create(data, size, bundle->flags) : NULL;
+    if (packet) {
+        if (enet_peer_send(client->peer, 0, packet) == 0) {
+            server->stats.datagrams_sent += 1;
+        } else {
+            enet_packet_destroy(packet);
         }
     }
 
-    return 0;
+    bundle->size = 0;
+    bundle->count = 0;
+    bundle->flags = 0;
 }
 
-static NetworkServerClient *network_server_acquire_client(NetworkServer *server, ENetPeer *peer)
+static void network_server_flush_client(NetworkServer *server, NetworkServerClient *client)
 {
-    if (!server || !server->clients || !peer) {
-        return NULL;
+    if (!server || !client) {
+        return;
+    }
+    for (int kind = 0; kind < NETWORK_SERVER_BUNDLE_KINDS; ++kind) {
+        network_server_flush_bundle(server, client, &client->outgoing[kind]);
     }
+}
 
-    for (uint32_t i = 0; i < server->client_capacity; ++i) {
-        NetworkServerClient *client = &server->clients[i];
-        if (!client->connected) {
-            memset(client, 0, sizeof(*client));
-            client->connected = 1;
-            client->peer = peer;
-            client->id = network_server_generate_id(server);
-            snprintf(client->name, sizeof(client->name), "Player %02u", (unsigned)(client->id + 1U));
-            client->position[0] = 0.0f;
-            client->position[1] = 0.0f;
-            client->position[2] = 0.0f;
-            client->yaw = 0.0f;
-            client->has_state = 0;
-            return client;
+/* Queues [header][data] as one message for the client. Messages are packed
+ * into MTU-sized frames and flushed after the next tick, so a peer gets one
+ * datagram per tick and reliability class instead of one per message. */
+static int network_server_queue_message(NetworkServer *server,
+                                        NetworkServerClient *client,
+                                        const enet_uint8 *header,
+                                        size_t header_size,
+                                        const enet_uint8 *data,
+                                        size_t size,
+                                        enet_uint32 flags)
+{
+    size_t message_size = header_size + size;
+    if (!server || !client || !client->peer || message_size == 0U) {
+        return 0;
+    }
+
+    server->stats.messages_sent += 1;
+    NetworkServerBundle *bundle = &client->outgoing[(flags & ENET_PACKET_FLAG_RELIABLE) ? NETWORK_SERVER_BUNDLE_RELIABLE
+                                                                                         : NETWORK_SERVER_BUNDLE_UNRELIABLE];
+
+    if (message_size > NETWORK_SERVER_BUNDLE_MTU - 1U - NETWORK_SERVER_BUNDLE_LENGTH_SIZE) {
+        /* too large to share a frame; flush first so ordering is kept */
+        network_server_flush_bundle(server, client, bundle);
+        ENetPacket *packet = enet_packet_create(NULL, message_size, flags);
+        if (!packet) {
+            return 0;
+        }
+        if (header_size > 0U) {
+            memcpy(packet->data, header, header_size);
+        }
+        if (size > 0U) {
+            memcpy(packet->data + header_size, data, size);
+        }
+        if (enet_peer_send(client->peer, 0, packet) != 0) {
+            enet_packet_destroy(packet);
+            return 0;
         }
+        server->stats.datagrams_sent += 1;
+        return 1;
     }
 
-    return NULL;
+    if (bundle->size + NETWORK_SERVER_BUNDLE_LENGTH_SIZE + message_size > NETWORK_SERVER_BUNDLE_MTU) {
+        network_server_flush_bundle(server, client, bundle);
+    }
+    if (bundle->count == 0U) {
+        bundle->data[0] = NETWORK_MESSAGE_BUNDLE;
+        bundle->size = 1U;
+    }
+
+    enet_uint8 *out = bundle->data + bundle->size;
+    out[0] = (enet_uint8)(message_size & 0xFF);
+    out[1] = (enet_uint8)((message_size >> 8) & 0xFF);
+    out += NETWORK_SERVER_BUNDLE_LENGTH_SIZE;
+    if (header_size > 0U) {
+        memcpy(out, header, header_size);
+    }
+    if (size > 0U) {
+        memcpy(out + header_size, data, size);
+    }
+
+    bundle->size += NETWORK_SERVER_BUNDLE_LENGTH_SIZE + message_size;
+    /* unsequenced only if all of the bundle's messages are */
+    enet_uint32 unsequenced = flags & ENET_PACKET_FLAG_UNSEQUENCED;
+    if (bundle->count > 0U) {
+        unsequenced &= bundle->flags;
+    }
+    bundle->flags = ((bundle->flags | flags) & ~(enet_uint32)ENET_PACKET_FLAG_UNSEQUENCED) | unsequenced;
+    bundle->count += 1U;
+    return 1;
 }
 
-static void network_server_release_client(NetworkServer *server, ENetPeer *peer)
+static void network_server_queue_broadcast(NetworkServer *server, const enet_uint8 *data, size_t size, enet_uint32 flags)
 {
-    if (!server || !server->clients || !peer) {
-        return;
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        NetworkServerClient *client = &server->clients[i];
+        if (client->connected) {
+            network_server_queue_message(server, client, NULL, 0, data, size, flags);
+        }
     }
+}
 
+static void network_server_flush_all(NetworkServer *server)
+{
     for (uint32_t i = 0; i < server->client_capacity; ++i) {
         NetworkServerClient *client = &server->clients[i];
-        if (client->connected && client->peer == peer) {
-            memset(client, 0, sizeof(*client));
-            break;
+        if (client->connected) {
+            network_server_flush_client(server, client);
         }
     }
+    /* the frames were only queued; hand them to the socket together */
+    enet_host_flush(server->host);
 }
 
 static enet_uint8 network_server_remote_count(const NetworkServer *server)
@@ -203,67 +468,408 @@ static enet_uint8 network_server_remote_count(const NetworkServer *server)
     return (enet_uint8)connected;
 }
 
-static ENetPacket *network_server_create_snapshot_packet(NetworkServer *server)
+static const NetworkServerSnapshotFrame *network_server_find_snapshot(const NetworkServer *server, uint16_t sequence)
 {
-    if (!server || !server->clients || server->client_capacity == 0U) {
+    const NetworkServerSnapshotFrame *frame = &server->snapshot_history[sequence % NETWORK_SERVER_SNAPSHOT_HISTORY];
+    if (!frame->valid || frame->sequence != sequence) {
         return NULL;
     }
+    return frame;
+}
 
-    size_t active = 0;
-    for (uint32_t i = 0; i < server->client_capacity; ++i) {
-        const NetworkServerClient *client = &server->clients[i];
-        if (client->connected && client->has_state) {
-            ++active;
-        }
+static const NetworkRemotePlayer *network_server_frame_entity(const NetworkServerSnapshotFrame *frame, uint8_t id)
+{
+    if (!frame) {
+        return NULL;
     }
 
-    if (active == 0) {
+    uint16_t index = frame->index_by_id[id];
+    return index < frame->count ? &frame->entities[index] : NULL;
+}
+
+static const NetworkServerSnapshotFrame *network_server_capture_snapshot(NetworkServer *server)
+{
+    if (!server || !server->clients) {
         return NULL;
     }
 
-    if (active > NETWORK_MAX_REMOTE_PLAYERS) {
-        active = NETWORK_MAX_REMOTE_PLAYERS;
+    uint16_t sequence = ++server->snapshot_sequence;
+    NetworkServerSnapshotFrame *frame = &server->snapshot_history[sequence % NETWORK_SERVER_SNAPSHOT_HISTORY];
+    frame->sequence = sequence;
+    frame->tick = server->stats.tick;
+    frame->count = 0;
+    frame->valid = 0;
+    memset(frame->index_by_id, 0xFF, sizeof(frame->index_by_id));
+
+    for (uint32_t i = 0; i < server->client_capacity && frame->count < NETWORK_SERVER_MAX_SNAPSHOT_ENTITIES; ++i) {
+        const NetworkServerClient *client = &server->clients[i];
+        if (!client->connected || !client->has_state) {
+            continue;
+        }
+
+        frame->index_by_id[client->id] = frame->count;
+        NetworkRemotePlayer *entity = &frame->entities[frame->count++];
+        memset(entity, 0, sizeof(*entity));
+        entity->id = client->id;
+        entity->active = true;
+        memcpy(entity->position, client->position, sizeof(entity->position));
+        entity->yaw = client->yaw;
+        memcpy(entity->name, client->name, NETWORK_MAX_PLAYER_NAME);
+        entity->name[NETWORK_MAX_PLAYER_NAME - 1] = '\0';
     }
 
-    const size_t stride = 1 + (sizeof(float) * 4) + NETWORK_MAX_PLAYER_NAME;
-    const size_t payload_size = 2 + stride * active;
+    frame->valid = 1;
+    return frame;
+}
 
-    ENetPacket *packet = enet_packet_create(NULL, payload_size, ENET_PACKET_FLAG_RELIABLE);
-    if (!packet || !packet->data) {
-        return NULL;
+static int32_t network_server_grid_coord(const NetworkServerGrid *grid, float value)
+{
+    return (int32_t)floorf(value / grid->cell_size);
+}
+
+static uint32_t network_server_grid_bucket(int32_t cx, int32_t cz)
+{
+    uint32_t hash = ((uint32_t)cx * 73856093U) ^ ((uint32_t)cz * 19349663U);
+    return hash & (NETWORK_SERVER_GRID_BUCKETS - 1U);
+}
+
+static void network_server_rebuild_grid(NetworkServer *server)
+{
+    NetworkServerGrid *grid = &server->grid;
+    if (!grid->next) {
+        return;
     }
 
-    memset(packet->data, 0, payload_size);
-    enet_uint8 *write = packet->data;
-    write[0] = NETWORK_MESSAGE_SERVER_SNAPSHOT;
+    for (uint32_t i = 0; i < NETWORK_SERVER_GRID_BUCKETS; ++i) {
+        grid->heads[i] = -1;
+    }
 
-    size_t offset = 2;
-    size_t written = 0;
-    for (uint32_t i = 0; i < server->client_capacity && written < active; ++i) {
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
         const NetworkServerClient *client = &server->clients[i];
+        grid->next[i] = -1;
         if (!client->connected || !client->has_state) {
             continue;
         }
 
-        enet_uint8 *entry = write + offset;
-        entry[0] = client->id;
-        memcpy(entry + 1, client->position, sizeof(float) * 3);
-        memcpy(entry + 1 + sizeof(float) * 3, &client->yaw, sizeof(float));
+        int32_t cx = network_server_grid_coord(grid, client->position[0]);
+        int32_t cz = network_server_grid_coord(grid, client->position[2]);
+        uint32_t bucket = network_server_grid_bucket(cx, cz);
+        grid->cells[i * 2] = cx;
+        grid->cells[i * 2 + 1] = cz;
+        grid->next[i] = grid->heads[bucket];
+        grid->heads[bucket] = (int32_t)i;
+    }
+}
 
-        size_t name_offset = 1 + sizeof(float) * 4;
-        memset(entry + name_offset, 0, NETWORK_MAX_PLAYER_NAME);
-        size_t name_len = strlen(client->name);
-        if (name_len >= NETWORK_MAX_PLAYER_NAME) {
-            name_len = NETWORK_MAX_PLAYER_NAME - 1;
+static int network_server_compare_candidates(const void *a, const void *b)
+{
+    const NetworkServerSnapshotCandidate *lhs = (const NetworkServerSnapshotCandidate *)a;
+    const NetworkServerSnapshotCandidate *rhs = (const NetworkServerSnapshotCandidate *)b;
+    if (lhs->distance_sq < rhs->distance_sq) {
+        return -1;
+    }
+    return lhs->distance_sq > rhs->distance_sq ? 1 : 0;
+}
+
+/* Nearest-first list of entities the viewer should receive, with the viewer
+ * itself forced in at distance -1. Returns the number of candidates. */
+static size_t network_server_gather_relevant(NetworkServer *server,
+                                             const NetworkServerClient *viewer,
+                                             const NetworkServerSnapshotFrame *frame,
+                                             NetworkServerSnapshotCandidate *out,
+                                             size_t capacity)
+{
+    size_t count = 0;
+    const NetworkRemotePlayer *self = network_server_frame_entity(frame, viewer->id);
+    if (self && count < capacity) {
+        out[count].entity = self;
+        out[count].distance_sq = -1.0f;
+        ++count;
+    }
+    if (!viewer->has_state || !server->grid.next) {
+        /* no position yet: nothing to filter against, send everyone */
+        for (uint16_t i = 0; i < frame->count && count < capacity; ++i) {
+            if (&frame->entities[i] == self) {
+                continue;
+            }
+            out[count].entity = &frame->entities[i];
+            out[count].distance_sq = 0.0f;
+            ++count;
         }
-        memcpy(entry + name_offset, client->name, name_len);
+        return count;
+    }
+
+    const NetworkServerGrid *grid = &server->grid;
+    const float radius = server->config.relevance_radius;
+    const float radius_sq = radius * radius;
+    int32_t min_x = network_server_grid_coord(grid, viewer->position[0] - radius);
+    int32_t max_x = network_server_grid_coord(grid, viewer->position[0] + radius);
+    int32_t min_z = network_server_grid_coord(grid, viewer->position[2] - radius);
+    int32_t max_z = network_server_grid_coord(grid, viewer->position[2] + radius);
+
+    for (int32_t cx = min_x; cx <= max_x; ++cx) {
+        for (int32_t cz = min_z; cz <= max_z; ++cz) {
+            for (int32_t slot = grid->heads[network_server_grid_bucket(cx, cz)]; slot >= 0; slot = grid->next[slot]) {
+                if (grid->cells[slot * 2] != cx || grid->cells[slot * 2 + 1] != cz) {
+                    continue;
+                }
+
+                const NetworkServerClient *target = &server->clients[slot];
+                if (target == viewer) {
+                    continue;
+                }
+
+                const NetworkRemotePlayer *entity = network_server_frame_entity(frame, target->id);
+                if (!entity) {
+                    continue;
+                }
+
+                float dx = entity->position[0] - viewer->position[0];
+                float dy = entity->position[1] - viewer->position[1];
+                float dz = entity->position[2] - viewer->position[2];
+                float distance_sq = dx * dx + dy * dy + dz * dz;
+                if (distance_sq > radius_sq || count >= capacity) {
+                    continue;
+                }
 
-        offset += stride;
-        ++written;
+                out[count].entity = entity;
+                out[count].distance_sq = distance_sq;
+                ++count;
+            }
+        }
+    }
+
+    qsort(out, count, sizeof(*out), network_server_compare_candidates);
+    return count;
+}
+
+/* Near entities update every snapshot, the middle band every 2nd and the
+ * outer band every 4th; the id offsets spread the far updates across ticks. */
+static int network_server_entity_due(const NetworkServer *server, float distance_sq, uint16_t sequence, uint8_t id)
+{
+    if (distance_sq < 0.0f) {
+        return 1;
+    }
+
+    float radius = server->config.relevance_radius;
+    float near_band = radius * NETWORK_SERVER_AOI_NEAR_FRACTION;
+    float mid_band = radius * NETWORK_SERVER_AOI_MID_FRACTION;
+    uint32_t divisor = 1U;
+    if (distance_sq > mid_band * mid_band) {
+        divisor = NETWORK_SERVER_AOI_FAR_DIVISOR;
+    } else if (distance_sq > near_band * near_band) {
+        divisor = NETWORK_SERVER_AOI_MID_DIVISOR;
+    }
+
+    return ((uint32_t)sequence + id) % divisor == 0U;
+}
+
+static uint8_t network_server_snapshot_changed_fields(const NetworkQuantization *quant,
+                                                      const NetworkRemotePlayer *current,
+                                                      const NetworkRemotePlayer *baseline)
+{
+    if (!baseline) {
+        return NETWORK_SNAPSHOT_FIELD_ALL;
+    }
+
+    uint8_t mask = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (network_quantize_position(quant, axis, current->position[axis]) !=
+            network_quantize_position(quant, axis, baseline->position[axis])) {
+            mask |= (uint8_t)(NETWORK_SNAPSHOT_FIELD_POS_X << axis);
+        }
+    }
+    if (network_quantize_yaw(quant, current->yaw) != network_quantize_yaw(quant, baseline->yaw)) {
+        mask |= NETWORK_SNAPSHOT_FIELD_YAW;
+    }
+    if (strncmp(current->name, baseline->name, NETWORK_MAX_PLAYER_NAME) != 0) {
+        mask |= NETWORK_SNAPSHOT_FIELD_NAME;
+    }
+    return mask;
+}
+
+/* [id][mask] then the fields in the mask; an empty mask is followed by one
+ * bit telling whether the entity was deferred (values older than this
+ * snapshot) or is unchanged as of it */
+static void network_server_write_snapshot_entity(NetworkBitWriter *writer,
+                                                 const NetworkQuantization *quant,
+                                                 const NetworkRemotePlayer *entity,
+                                                 uint8_t mask,
+                                                 bool deferred)
+{
+    network_bit_write(writer, entity->id, 8);
+    network_bit_write(writer, mask, NETWORK_SNAPSHOT_FIELD_BITS);
+    if (mask == 0U) {
+        network_bit_write(writer, deferred ? 1U : 0U, 1);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        if (mask & (NETWORK_SNAPSHOT_FIELD_POS_X << axis)) {
+            network_bit_write(writer,
+                              network_quantize_position(quant, axis, entity->position[axis]),
+                              quant->position_bits[axis]);
+        }
+    }
+    if (mask & NETWORK_SNAPSHOT_FIELD_YAW) {
+        network_bit_write_yaw(writer, quant, entity->yaw);
+    }
+    if (mask & NETWORK_SNAPSHOT_FIELD_NAME) {
+        size_t name_len = 0;
+        while (name_len < NETWORK_MAX_PLAYER_NAME - 1 && entity->name[name_len] != '\0') {
+            ++name_len;
+        }
+        network_bit_write(writer, (uint32_t)name_len, NETWORK_SNAPSHOT_NAME_LENGTH_BITS);
+        for (size_t c = 0; c < name_len; ++c) {
+            network_bit_write(writer, (uint8_t)entity->name[c], 8);
+        }
+    }
+}
+
+/* Writes the per-client message for `frame` into `buffer` and records what
+ * the client will hold after decoding it in client->views, so a later ack can
+ * serve as the delta baseline. Entities skipped by their update tier are sent
+ * with an empty mask and the deferred bit, and keep the source sequence of
+ * the values the client has, so it does not take them as new samples.
+ * Returns the message size, or 0 when there is nothing to send. */
+static size_t network_server_write_snapshot(NetworkServer *server,
+                                            NetworkServerClient *client,
+                                            const NetworkServerSnapshotFrame *frame,
+                                            enet_uint8 *buffer,
+                                            size_t capacity)
+{
+    const NetworkQuantization *quant = &server->config.quantization;
+
+    const NetworkServerClientView *baseline = NULL;
+    if (client->has_ack) {
+        baseline = &client->views[client->acked_sequence % NETWORK_SERVER_SNAPSHOT_HISTORY];
+        if (!baseline->valid || baseline->sequence != client->acked_sequence) {
+            baseline = NULL;
+        }
+    }
+
+    /* id -> (baseline value, source sequence); ids are a single byte so flat tables are enough */
+    const NetworkRemotePlayer *baseline_by_id[256];
+    uint16_t source_by_id[256];
+    memset(baseline_by_id, 0, sizeof(baseline_by_id));
+    if (baseline) {
+        for (uint8_t i = 0; i < baseline->count; ++i) {
+            uint8_t id = baseline->ids[i];
+            const NetworkServerSnapshotFrame *source = network_server_find_snapshot(server, baseline->source_sequence[i]);
+            baseline_by_id[id] = network_server_frame_entity(source, id);
+            source_by_id[id] = baseline->source_sequence[i];
+        }
+    }
+
+    NetworkServerSnapshotCandidate candidates[NETWORK_SERVER_MAX_SNAPSHOT_ENTITIES];
+    size_t candidate_count = network_server_gather_relevant(server, client, frame, candidates, NETWORK_SERVER_MAX_SNAPSHOT_ENTITIES);
+    if (candidate_count > NETWORK_MAX_REMOTE_PLAYERS) {
+        candidate_count = NETWORK_MAX_REMOTE_PLAYERS;
+    }
+    if (candidate_count == 0U || capacity < NETWORK_SNAPSHOT_HEADER_SIZE) {
+        return 0;
+    }
+
+    buffer[0] = NETWORK_MESSAGE_SERVER_SNAPSHOT;
+    buffer[1] = (enet_uint8)(frame->sequence & 0xFF);
+    buffer[2] = (enet_uint8)((frame->sequence >> 8) & 0xFF);
+    buffer[3] = (enet_uint8)(baseline ? (baseline->sequence & 0xFF) : 0);
+    buffer[4] = (enet_uint8)(baseline ? ((baseline->sequence >> 8) & 0xFF) : 0);
+    buffer[5] = baseline ? NETWORK_SNAPSHOT_FLAG_DELTA : 0;
+    buffer[6] = (enet_uint8)candidate_count;
+    buffer[7] = (enet_uint8)(frame->tick & 0xFF);
+    buffer[8] = (enet_uint8)((frame->tick >> 8) & 0xFF);
+    buffer[9] = (enet_uint8)((frame->tick >> 16) & 0xFF);
+    buffer[10] = (enet_uint8)((frame->tick >> 24) & 0xFF);
+
+    NetworkServerClientView *view = &client->views[frame->sequence % NETWORK_SERVER_SNAPSHOT_HISTORY];
+    view->valid = 0;
+    view->sequence = frame->sequence;
+    view->count = 0;
+
+    NetworkBitWriter writer;
+    network_bit_writer_init(&writer, buffer + NETWORK_SNAPSHOT_HEADER_SIZE, capacity - NETWORK_SNAPSHOT_HEADER_SIZE);
+    for (size_t i = 0; i < candidate_count; ++i) {
+        const NetworkRemotePlayer *entity = candidates[i].entity;
+        const NetworkRemotePlayer *known = baseline_by_id[entity->id];
+        uint16_t source = frame->sequence;
+        uint8_t mask;
+        bool deferred = false;
+
+        if (known && !network_server_entity_due(server, candidates[i].distance_sq, frame->sequence, entity->id)) {
+            mask = 0;
+            deferred = true;
+            source = source_by_id[entity->id];
+            server->stats.snapshot_entities_deferred += 1;
+        } else {
+            mask = network_server_snapshot_changed_fields(quant, entity, known);
+        }
+
+        network_server_write_snapshot_entity(&writer, quant, entity, mask, deferred);
+        view->ids[view->count] = entity->id;
+        view->source_sequence[view->count] = source;
+        ++view->count;
+    }
+
+    if (writer.overflow) {
+        return 0;
+    }
+
+    view->valid = 1;
+    server->stats.snapshot_entities_sent += view->count;
+    if (baseline) {
+        server->stats.snapshots_delta += 1;
+    }
+
+    return NETWORK_SNAPSHOT_HEADER_SIZE + network_bit_writer_bytes(&writer);
+}
+
+/* The client's own player as simulated so far and the newest of its commands
+ * that went into it, so it can replay the later ones over it. Unquantized:
+ * the client rewinds to exactly this state. */
+static void network_server_send_player_state(NetworkServer *server, NetworkServerClient *client)
+{
+    enet_uint8 payload[NETWORK_PLAYER_STATE_SIZE];
+    const PlayerState *player = &client->player;
+    float position[3] = {player->position.x, player->position.y, player->position.z};
+    float velocity[3] = {player->velocity.x, player->velocity.y, player->velocity.z};
+    size_t offset = 0;
+
+    payload[offset] = NETWORK_MESSAGE_PLAYER_STATE;
+    offset += 1;
+    memcpy(payload + offset, &client->processed_command_sequence, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    memcpy(payload + offset, position, sizeof(position));
+    offset += sizeof(position);
+    memcpy(payload + offset, velocity, sizeof(velocity));
+    offset += sizeof(velocity);
+    payload[offset] = (enet_uint8)((player->grounded ? NETWORK_PLAYER_STATE_GROUNDED : 0) |
+                                   (player->double_jump_available ? NETWORK_PLAYER_STATE_DOUBLE_JUMP : 0));
+    offset += 1;
+    memcpy(payload + offset, &player->double_jump_timer, sizeof(float));
+
+    network_server_queue_message(server, client, NULL, 0, payload, sizeof(payload), 0);
+}
+
+static void network_server_send_snapshot_frame(NetworkServer *server,
+                                               NetworkServerClient *client,
+                                               const NetworkServerSnapshotFrame *frame)
+{
+    if (!server || !client || !client->peer || !frame) {
+        return;
+    }
+
+    enet_uint8 buffer[NETWORK_SNAPSHOT_HEADER_SIZE + NETWORK_MAX_REMOTE_PLAYERS * NETWORK_SNAPSHOT_MAX_ENTITY_SIZE];
+    size_t bytes = network_server_write_snapshot(server, client, frame, buffer, sizeof(buffer));
+    if (bytes == 0U) {
+        return;
     }
 
-    write[1] = (enet_uint8)written;
-    return packet;
+    if (network_server_queue_message(server, client, NULL, 0, buffer, bytes, 0)) {
+        network_server_send_player_state(server, client);
+        server->stats.snapshots_sent += 1;
+        server->stats.snapshot_bytes_sent += (uint64_t)bytes;
+        server->stats.snapshot_entities_average =
+            (float)((double)server->stats.snapshot_entities_sent / (double)server->stats.snapshots_sent);
+    }
 }
 
 static void network_server_broadcast_snapshot(NetworkServer *server)
@@ -272,26 +878,54 @@ static void network_server_broadcast_snapshot(NetworkServer *server)
         return;
     }
 
-    ENetPacket *packet = network_server_create_snapshot_packet(server);
-    if (!packet) {
+    const NetworkServerSnapshotFrame *frame = network_server_capture_snapshot(server);
+    if (!frame || frame->count == 0U) {
         return;
     }
 
-    enet_host_broadcast(server->host, 0, packet);
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        NetworkServerClient *client = &server->clients[i];
+        if (!client->connected) {
+            continue;
+        }
+        network_server_send_snapshot_frame(server, client, frame);
+    }
 }
 
-static void network_server_send_snapshot_to(NetworkServer *server, ENetPeer *peer)
+static void network_server_send_snapshot_to(NetworkServer *server, NetworkServerClient *client)
 {
-    if (!server || !peer) {
+    if (!server || !client) {
         return;
     }
 
-    ENetPacket *packet = network_server_create_snapshot_packet(server);
-    if (!packet) {
+    const NetworkServerSnapshotFrame *frame = network_server_find_snapshot(server, server->snapshot_sequence);
+    if (!frame) {
         return;
     }
 
-    enet_peer_send(peer, 0, packet);
+    client->has_ack = 0;
+    network_server_send_snapshot_frame(server, client, frame);
+}
+
+static void network_server_handle_snapshot_ack(NetworkServer *server,
+                                               NetworkServerClient *client,
+                                               const enet_uint8 *data,
+                                               size_t size)
+{
+    if (!server || !client || !data || size < 3) {
+        return;
+    }
+
+    uint16_t sequence = (uint16_t)(data[1] | ((uint16_t)data[2] << 8));
+    if ((int16_t)(uint16_t)(server->snapshot_sequence - sequence) < 0) {
+        return;
+    }
+    if (client->has_ack && (int16_t)(uint16_t)(sequence - client->acked_sequence) <= 0) {
+        return;
+    }
+
+    client->acked_sequence = sequence;
+    client->has_ack = 1;
 }
 
 static void network_server_master_refresh_entry(NetworkServer *server)
@@ -584,6 +1218,12 @@ NetworkServer *network_server_create(const NetworkServerConfig *config)
     if (server->config.max_clients == 0) {
         server->config.max_clients = 8;
     }
+    if (server->config.max_clients > NETWORK_SERVER_MAX_CLIENTS) {
+        printf("[network] max_clients %u exceeds the %u player ids available, clamping\n",
+               server->config.max_clients,
+               NETWORK_SERVER_MAX_CLIENTS);
+        server->config.max_clients = NETWORK_SERVER_MAX_CLIENTS;
+    }
     if (!server->config.name || server->config.name[0] == '\0') {
         server->config.name = "Slashed Project 1986 Server";
     }
@@ -599,6 +1239,21 @@ NetworkServer *network_server_create(const NetworkServerConfig *config)
     if (server->config.master_heartbeat_interval <= 0.0f) {
         server->config.master_heartbeat_interval = MASTER_DEFAULT_HEARTBEAT;
     }
+    if (server->config.tick_rate <= 0.0f) {
+        server->config.tick_rate = NETWORK_SERVER_DEFAULT_TICK_RATE;
+    }
+    if (server->config.snapshot_rate <= 0.0f) {
+        server->config.snapshot_rate = NETWORK_SERVER_DEFAULT_SNAPSHOT_RATE;
+    }
+    if (server->config.snapshot_rate > server->config.tick_rate) {
+        server->config.snapshot_rate = server->config.tick_rate;
+    }
+    if (!network_quantization_valid(&server->config.quantization)) {
+        network_quantization_default(&server->config.quantization);
+    }
+    if (server->config.relevance_radius <= 0.0f) {
+        server->config.relevance_radius = NETWORK_SERVER_DEFAULT_RELEVANCE_RADIUS;
+    }
 
     server->stats.max_clients = server->config.max_clients;
     server->stats.connected_clients = 0;
@@ -606,18 +1261,65 @@ NetworkServer *network_server_create(const NetworkServerConfig *config)
     server->stats.master_registered = false;
     server->stats.master_time_since_contact = 0.0f;
     server->stats.master_failures = 0;
+    server->stats.tick = 0;
+    server->stats.snapshots_sent = 0;
+    server->stats.snapshots_suppressed = 0;
+    server->stats.snapshots_delta = 0;
+    server->stats.snapshot_bytes_sent = 0;
+    server->stats.snapshot_entities_sent = 0;
+    server->stats.snapshot_entities_deferred = 0;
+    server->stats.snapshot_entities_average = 0.0f;
+    server->stats.commands_processed = 0;
+    server->stats.commands_dropped = 0;
+    server->stats.commands_redundant = 0;
+    server->stats.commands_lost = 0;
+    server->stats.tick_jitter_samples = 0;
+    server->stats.tick_jitter_mean_ms = 0.0f;
+    server->stats.tick_jitter_stddev_ms = 0.0f;
+    server->stats.tick_jitter_max_ms = 0.0f;
+    server->stats.packet_pool_hits = 0;
+    server->stats.packet_pool_misses = 0;
+    server->stats.rtt_mean_ms = 0.0f;
+    server->stats.rtt_max_ms = 0.0f;
+    server->stats.simulated_drops = 0;
+    server->stats.simulated_queued = 0;
+
+    player_default_config(&server->game_config);
 
     ENetAddress address;
     address.host = htonl(INADDR_ANY);
     address.port = server->config.port;
 
-    server->host = enet_host_create(&address, server->stats.max_clients, 1, 0, 0);
+    if (server->config.offline) {
+        server->config.advertise = false;
+        server->host = enet_host_create_offline(server->stats.max_clients);
+    } else {
+        server->host = enet_host_create_sharded(&address, server->stats.max_clients, 1, 0, 0, server->config.receive_shards);
+    }
     if (!server->host) {
         fprintf(stderr, "[network] failed to create server host\n");
         free(server);
         network_server_decrement_ref();
         return NULL;
     }
+    if (server->config.capture_path && server->config.capture_path[0] != '\0') {
+        if (enet_host_capture_start(server->host, server->config.capture_path) == 0) {
+            printf("[network] capturing traffic to %s\n", server->config.capture_path);
+        } else {
+            fprintf(stderr, "[network] failed to open capture file %s\n", server->config.capture_path);
+        }
+    }
+    if (server->config.simulate_latency && !server->config.offline) {
+        const NetworkConditions *conditions = &server->config.conditions;
+        if (network_conditions_apply(server->host, conditions)) {
+            printf("[network] simulating %.0f ms +/- %.0f ms latency, %.1f%% loss on outgoing traffic\n",
+                   conditions->latency_ms,
+                   conditions->jitter_ms,
+                   conditions->loss * 100.0f);
+        } else {
+            fprintf(stderr, "[network] failed to enable the network simulator\n");
+        }
+    }
 
     server->client_capacity = server->stats.max_clients ? server->stats.max_clients : 1U;
     server->clients = (NetworkServerClient *)calloc(server->client_capacity, sizeof(NetworkServerClient));
@@ -628,10 +1330,94 @@ NetworkServer *network_server_create(const NetworkServerConfig *config)
         network_server_decrement_ref();
         return NULL;
     }
-    server->next_client_id = 0;
-    server->snapshot_timer = 0.0f;
+    server->grid.cell_size = server->config.relevance_radius;
+    server->grid.next = (int32_t *)calloc(server->client_capacity, sizeof(int32_t));
+    server->grid.cells = (int32_t *)calloc((size_t)server->client_capacity * 2U, sizeof(int32_t));
+    if (!server->grid.next || !server->grid.cells) {
+        fprintf(stderr, "[network] failed to allocate relevance grid\n");
+        free(server->grid.next);
+        free(server->grid.cells);
+        free(server->clients);
+        enet_host_destroy(server->host);
+        free(server);
+        network_server_decrement_ref();
+        return NULL;
+    }
+    network_server_rebuild_grid(server);
+
+    server->world = (GameWorld *)calloc(1, sizeof(GameWorld));
+    if (!server->world) {
+        fprintf(stderr, "[network] failed to allocate server world\n");
+        free(server->grid.next);
+        free(server->grid.cells);
+        free(server->clients);
+        enet_host_destroy(server->host);
+        free(server);
+        network_server_decrement_ref();
+        return NULL;
+    }
+    world_init(server->world);
+    world_spawn_default_geometry(server->world);
+
+    server->history.frame_capacity = (uint32_t)ceilf(server->config.tick_rate * NETWORK_SERVER_HISTORY_SECONDS) + 1U;
+    server->history.frame_ticks = (uint32_t *)malloc(sizeof(uint32_t) * server->history.frame_capacity);
+    server->history.samples = (NetworkServerHistorySample *)calloc((size_t)server->history.frame_capacity * server->client_capacity,
+                                                                   sizeof(NetworkServerHistorySample));
+    if (!server->history.frame_ticks || !server->history.samples) {
+        fprintf(stderr, "[network] failed to allocate lag compensation history\n");
+        free(server->history.frame_ticks);
+        free(server->history.samples);
+        free(server->world);
+        free(server->grid.next);
+        free(server->grid.cells);
+        free(server->clients);
+        enet_host_destroy(server->host);
+        free(server);
+        network_server_decrement_ref();
+        return NULL;
+    }
+    /* no tick maps to UINT32_MAX within the server's lifetime */
+    memset(server->history.frame_ticks, 0xFF, sizeof(uint32_t) * server->history.frame_capacity);
+
+    server->free_slots = (uint32_t *)malloc(sizeof(uint32_t) * server->client_capacity);
+    if (!server->free_slots) {
+        fprintf(stderr, "[network] failed to allocate client slot list\n");
+        free(server->history.frame_ticks);
+        free(server->history.samples);
+        free(server->world);
+        free(server->grid.next);
+        free(server->grid.cells);
+        free(server->clients);
+        enet_host_destroy(server->host);
+        free(server);
+        network_server_decrement_ref();
+        return NULL;
+    }
+    /* pop order hands out slot 0 first */
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        server->free_slots[i] = server->client_capacity - 1U - i;
+    }
+    server->free_slot_count = server->client_capacity;
+    for (uint32_t i = 0; i < NETWORK_SERVER_MAX_CLIENTS; ++i) {
+        server->free_ids[i] = (uint8_t)i;
+    }
+    server->free_id_head = 0;
+    server->free_id_count = NETWORK_SERVER_MAX_CLIENTS;
+    for (uint32_t i = 0; i < 256U; ++i) {
+        server->slot_by_id[i] = -1;
+    }
+    server->tick_interval = 1.0f / server->config.tick_rate;
+    server->tick_accumulator = 0.0f;
+    server->ticks_per_snapshot = (uint32_t)lroundf(server->config.tick_rate / server->config.snapshot_rate);
+    if (server->ticks_per_snapshot == 0U) {
+        server->ticks_per_snapshot = 1U;
+    }
+    server->ticks_since_snapshot = 0;
 
-    printf("[network] server listening on port %u\n", server->config.port);
+    printf("[network] server listening on port %u (tick %.0f Hz, snapshot every %u ticks)\n",
+           server->config.port,
+           server->config.tick_rate,
+           server->ticks_per_snapshot);
 
     network_server_master_init(server);
 
@@ -654,6 +1440,19 @@ void network_server_destroy(NetworkServer *server)
     free(server->clients);
     server->clients = NULL;
     server->client_capacity = 0;
+    free(server->free_slots);
+    server->free_slots = NULL;
+    server->free_slot_count = 0;
+    free(server->grid.next);
+    free(server->grid.cells);
+    server->grid.next = NULL;
+    server->grid.cells = NULL;
+    free(server->world);
+    server->world = NULL;
+    free(server->history.frame_ticks);
+    free(server->history.samples);
+    server->history.frame_ticks = NULL;
+    server->history.samples = NULL;
 
     free(server);
     network_server_decrement_ref();
@@ -665,16 +1464,22 @@ static void network_server_send_welcome(NetworkServer *server, NetworkServerClie
         return;
     }
 
-    enet_uint8 payload[4];
+    /* ..., then the tick interval in microseconds, which turns snapshot
+     * ticks into server time */
+    enet_uint8 payload[4 + NETWORK_QUANTIZATION_WIRE_SIZE + 4];
     payload[0] = NETWORK_MESSAGE_WELCOME;
     payload[1] = network_server_remote_count(server);
     payload[2] = (enet_uint8)(server->stats.max_clients & 0xFF);
     payload[3] = client->id;
-
-    ENetPacket *packet = enet_packet_create(payload, sizeof(payload), ENET_PACKET_FLAG_RELIABLE);
-    if (packet) {
-        enet_peer_send(client->peer, 0, packet);
-    }
+    network_quantization_write(&server->config.quantization, payload + 4, NETWORK_QUANTIZATION_WIRE_SIZE);
+    uint32_t tick_us = (uint32_t)(server->tick_interval * 1000000.0f + 0.5f);
+    enet_uint8 *interval = payload + 4 + NETWORK_QUANTIZATION_WIRE_SIZE;
+    interval[0] = (enet_uint8)(tick_us & 0xFF);
+    interval[1] = (enet_uint8)((tick_us >> 8) & 0xFF);
+    interval[2] = (enet_uint8)((tick_us >> 16) & 0xFF);
+    interval[3] = (enet_uint8)((tick_us >> 24) & 0xFF);
+
+    network_server_queue_message(server, client, NULL, 0, payload, sizeof(payload), ENET_PACKET_FLAG_RELIABLE);
 }
 
 static void network_server_broadcast_player_count(NetworkServer *server)
@@ -687,10 +1492,7 @@ static void network_server_broadcast_player_count(NetworkServer *server)
     payload[0] = NETWORK_MESSAGE_PLAYER_COUNT;
     payload[1] = network_server_remote_count(server);
 
-    ENetPacket *packet = enet_packet_create(payload, sizeof(payload), ENET_PACKET_FLAG_RELIABLE);
-    if (packet) {
-        enet_host_broadcast(server->host, 0, packet);
-    }
+    network_server_queue_broadcast(server, payload, sizeof(payload), ENET_PACKET_FLAG_RELIABLE);
 }
 
 static void network_server_master_push(NetworkServer *server)
@@ -713,6 +1515,415 @@ static void network_server_master_push(NetworkServer *server)
         master->registered = 1;
     }
 }
+/* Checks a FIRE event against the players as the shooter saw them. Returns
+ * false when the shot cannot have come from the shooter. */
+static bool network_server_validate_shot(NetworkServer *server, const NetworkServerClient *shooter, enet_uint8 *payload)
+{
+    float origin[3];
+    float direction[3];
+    double view_time = 0.0;
+    memcpy(origin, payload + NETWORK_WEAPON_EVENT_ORIGIN_OFFSET, sizeof(origin));
+    memcpy(direction, payload + NETWORK_WEAPON_EVENT_DIRECTION_OFFSET, sizeof(direction));
+    memcpy(&view_time, payload + NETWORK_WEAPON_EVENT_VIEW_TIME_OFFSET, sizeof(view_time));
+
+    float length_sq = 0.0f;
+    float offset_sq = 0.0f;
+    const float shooter_position[3] = {shooter->player.position.x, shooter->player.position.y, shooter->player.position.z};
+    for (int axis = 0; axis < 3; ++axis) {
+        if (!isfinite(origin[axis]) || !isfinite(direction[axis])) {
+            return false;
+        }
+        length_sq += direction[axis] * direction[axis];
+        float offset = origin[axis] - shooter_position[axis];
+        offset_sq += offset * offset;
+    }
+    if (length_sq < 1e-6f || !isfinite(view_time) ||
+        offset_sq > NETWORK_SERVER_FIRE_ORIGIN_SLACK * NETWORK_SERVER_FIRE_ORIGIN_SLACK) {
+        return false;
+    }
+
+    float inverse_length = 1.0f / sqrtf(length_sq);
+    for (int axis = 0; axis < 3; ++axis) {
+        direction[axis] *= inverse_length;
+    }
+
+    /* rewind_raycast clamps view_time to the history window, so a client
+     * claiming an older view gains at most NETWORK_SERVER_HISTORY_SECONDS */
+    NetworkServerRewindHit hit;
+    payload[NETWORK_WEAPON_EVENT_HIT_OFFSET] = NETWORK_WEAPON_EVENT_NO_HIT;
+    server->stats.shots_validated += 1;
+    if (network_server_rewind_raycast(server, view_time, origin, direction, NETWORK_SERVER_FIRE_RANGE, shooter->id, &hit)) {
+        payload[NETWORK_WEAPON_EVENT_HIT_OFFSET] = hit.client_id;
+        server->stats.shots_hit += 1;
+    }
+    return true;
+}
+
+static void network_server_relay_weapon_event(NetworkServer *server,
+                                              const NetworkServerClient *client,
+                                              const enet_uint8 *data,
+                                              size_t size)
+{
+    if (!client) {
+        return;
+    }
+
+    enet_uint8 buffer[2 + NETWORK_WEAPON_EVENT_DATA_SIZE];
+    buffer[0] = NETWORK_MESSAGE_WEAPON_EVENT;
+    buffer[1] = client->id;
+    memcpy(buffer + 2, data, size < NETWORK_WEAPON_EVENT_DATA_SIZE ? size : NETWORK_WEAPON_EVENT_DATA_SIZE);
+    buffer[2 + NETWORK_WEAPON_EVENT_HIT_OFFSET] = NETWORK_WEAPON_EVENT_NO_HIT;
+
+    if (buffer[2] == NETWORK_WEAPON_EVENT_FIRE && !network_server_validate_shot(server, client, buffer + 2)) {
+        server->stats.shots_rejected += 1;
+        return;
+    }
+
+    network_server_queue_broadcast(server, buffer, sizeof(buffer), ENET_PACKET_FLAG_RELIABLE);
+}
+
+/* Builds the relayed voice body once and sends it to every listener behind a
+ * two byte [type][volume] header with enet_peer_send_with_header, so the
+ * samples are never copied per listener. Voice skips the per-tick bundles
+ * and goes out as soon as it arrives. */
+static void network_server_relay_voice(NetworkServer *server,
+                                       NetworkServerClient *speaker,
+                                       const enet_uint8 *payload,
+                                       size_t size)
+{
+    if (!server || !speaker || !speaker->has_state || !payload || size <= 8) {
+        return;
+    }
+
+    uint8_t codec = payload[1];
+    uint8_t channels = payload[2];
+    uint16_t frame_count = (uint16_t)(payload[5] | ((uint16_t)payload[6] << 8));
+    uint8_t gain_byte = payload[7];
+    size_t voice_bytes = size - 8;
+
+    /* relayed as-is; the server never transcodes */
+    size_t expected_bytes = network_voice_payload_size((NetworkVoiceCodec)codec, frame_count, channels);
+    if (expected_bytes == 0U || voice_bytes != expected_bytes) {
+        /* counted rather than logged, so a misbehaving peer cannot flood stdout */
+        server->stats.voice_packets_invalid += 1;
+        return;
+    }
+
+    float emitter_gain = (float)gain_byte / 255.0f;
+    if (emitter_gain <= 0.0f) {
+        emitter_gain = 1.0f;
+    } else if (emitter_gain > 1.0f) {
+        emitter_gain = 1.0f;
+    }
+
+    NetworkVoiceChatMode voice_mode = server->config.voice_mode;
+    float voice_range = server->config.voice_range > 0.0f ? server->config.voice_range : NETWORK_VOICE_RANGE;
+
+    /* shared body: [speaker][codec][channels][rate u16][frames u16][samples],
+     * i.e. the client's payload with its type and gain bytes replaced */
+    ENetPacket *body = NULL;
+
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        NetworkServerClient *target = &server->clients[i];
+        if (!target->connected || !target->has_state || target->peer == speaker->peer) {
+            continue;
+        }
+
+        float volume_scale = emitter_gain;
+        if (voice_mode != NETWORK_VOICE_CHAT_GLOBAL) {
+            float dx = target->position[0] - speaker->position[0];
+            float dy = target->position[1] - speaker->position[1];
+            float dz = target->position[2] - speaker->position[2];
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+            if (distance > voice_range) {
+                continue;
+            }
+
+            float attenuation = 1.0f - (distance / voice_range);
+            if (attenuation <= 0.0f) {
+                continue;
+            }
+            volume_scale *= attenuation;
+        }
+
+        if (volume_scale <= 0.0f) {
+            continue;
+        }
+        if (volume_scale > 1.0f) {
+            volume_scale = 1.0f;
+        }
+
+        enet_uint8 volume_byte = (enet_uint8)(volume_scale * 255.0f);
+        if (volume_byte == 0U) {
+            continue;
+        }
+
+        if (!body) {
+            body = enet_packet_create(NULL,
+                                      NETWORK_VOICE_RELAY_BODY_SIZE + voice_bytes,
+                                      ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT);
+            if (!body) {
+                return;
+            }
+            body->data[0] = speaker->id;
+            memcpy(body->data + 1, payload + 1, 6);
+            memcpy(body->data + NETWORK_VOICE_RELAY_BODY_SIZE, payload + 8, voice_bytes);
+        }
+
+        enet_uint8 header[NETWORK_VOICE_RELAY_HEADER_SIZE];
+        header[0] = NETWORK_MESSAGE_VOICE_DATA;
+        header[1] = volume_byte;
+        server->stats.messages_sent += 1;
+        if (enet_peer_send_with_header(target->peer, 0, header, sizeof(header), body) == 0) {
+            server->stats.datagrams_sent += 1;
+        }
+    }
+
+    if (body) {
+        enet_packet_destroy(body);
+    }
+}
+
+/* [CLIENT_COMMAND][count] then `count` bit-packed commands, oldest first.
+ * Uploads are unreliable and repeat the commands of the previous ones, so
+ * most commands arrive several times and an upload may be lost or late. */
+static void network_server_queue_commands(NetworkServer *server,
+                                          NetworkServerClient *client,
+                                          const enet_uint8 *data,
+                                          size_t size)
+{
+    if (!server || !client || !data || size < 2) {
+        return;
+    }
+
+    uint8_t count = data[1];
+    NetworkBitReader reader;
+    network_bit_reader_init(&reader, data + 2, size - 2);
+    for (uint8_t i = 0; i < count; ++i) {
+        NetworkPlayerCommand command;
+        if (!network_player_command_read(&reader, &server->config.quantization, &command)) {
+            printf("[network] ignoring truncated command from %u\n", (unsigned)client->id);
+            return;
+        }
+
+        if (command.sequence == 0U) {
+            server->stats.commands_dropped += 1;
+            continue;
+        }
+        /* anything at or below the last queued sequence is a copy */
+        if (command.sequence <= client->last_command_sequence) {
+            server->stats.commands_redundant += 1;
+            continue;
+        }
+        /* left for a later upload to repeat */
+        if (client->command_count >= NETWORK_SERVER_COMMAND_QUEUE) {
+            server->stats.commands_dropped += 1;
+            continue;
+        }
+
+        if (command.duration > NETWORK_MAX_COMMAND_DURATION) {
+            command.duration = NETWORK_MAX_COMMAND_DURATION;
+        }
+
+        server->stats.commands_lost += command.sequence - client->last_command_sequence - 1U;
+        uint32_t slot = (client->command_head + client->command_count) % NETWORK_SERVER_COMMAND_QUEUE;
+        client->commands[slot] = command;
+        client->command_count += 1;
+        client->last_command_sequence = command.sequence;
+    }
+}
+
+static void network_server_simulate_client(NetworkServer *server, NetworkServerClient *client)
+{
+    client->command_budget += server->tick_interval;
+    if (client->command_budget > NETWORK_SERVER_MAX_COMMAND_BUDGET) {
+        client->command_budget = NETWORK_SERVER_MAX_COMMAND_BUDGET;
+    }
+
+    while (client->command_count > 0U) {
+        const NetworkPlayerCommand *command = &client->commands[client->command_head];
+        if (command->duration > client->command_budget) {
+            break;
+        }
+
+        PlayerCommand input;
+        network_player_command_to_input(command, &input);
+        player_update_physics(&client->player, &input, &server->game_config, server->world, command->duration, SIZE_MAX);
+
+        client->command_budget -= command->duration;
+        client->yaw = command->yaw;
+        client->processed_command_sequence = command->sequence;
+        client->command_head = (client->command_head + 1U) % NETWORK_SERVER_COMMAND_QUEUE;
+        client->command_count -= 1;
+        server->stats.commands_processed += 1;
+    }
+
+    client->position[0] = client->player.position.x;
+    client->position[1] = client->player.position.y;
+    client->position[2] = client->player.position.z;
+}
+
+static void network_server_record_history(NetworkServer *server)
+{
+    NetworkServerHistory *history = &server->history;
+    uint32_t tick = server->stats.tick;
+    uint32_t slot = tick % history->frame_capacity;
+    NetworkServerHistorySample *samples = &history->samples[(size_t)slot * server->client_capacity];
+
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        const NetworkServerClient *client = &server->clients[i];
+        NetworkServerHistorySample *sample = &samples[i];
+        sample->valid = client->connected ? 1U : 0U;
+        if (!sample->valid) {
+            continue;
+        }
+        sample->id = client->id;
+        sample->position[0] = client->player.position.x;
+        sample->position[1] = client->player.position.y;
+        sample->position[2] = client->player.position.z;
+        sample->half_extents[0] = client->player.collider_half_extents.x;
+        sample->half_extents[1] = client->player.collider_half_extents.y;
+        sample->half_extents[2] = client->player.collider_half_extents.z;
+    }
+
+    history->frame_ticks[slot] = tick;
+    history->newest_tick = tick;
+    if (!history->has_frames || tick - history->oldest_tick >= history->frame_capacity) {
+        history->oldest_tick = tick - (history->has_frames ? history->frame_capacity - 1U : 0U);
+    }
+    history->has_frames = 1;
+}
+
+static const NetworkServerHistorySample *network_server_history_frame(const NetworkServer *server, uint32_t tick)
+{
+    const NetworkServerHistory *history = &server->history;
+    uint32_t slot = tick % history->frame_capacity;
+    if (history->frame_ticks[slot] != tick) {
+        return NULL;
+    }
+    return &history->samples[(size_t)slot * server->client_capacity];
+}
+
+/* Slab test; returns the entry distance along the ray or -1 on a miss. */
+static float network_server_ray_aabb(const float origin[3],
+                                     const float direction[3],
+                                     const float center[3],
+                                     const float half_extents[3],
+                                     float max_distance)
+{
+    float t_min = 0.0f;
+    float t_max = max_distance;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        float lo = center[axis] - half_extents[axis];
+        float hi = center[axis] + half_extents[axis];
+        if (fabsf(direction[axis]) < 1e-8f) {
+            if (origin[axis] < lo || origin[axis] > hi) {
+                return -1.0f;
+            }
+            continue;
+        }
+
+        float inv = 1.0f / direction[axis];
+        float t0 = (lo - origin[axis]) * inv;
+        float t1 = (hi - origin[axis]) * inv;
+        if (t0 > t1) {
+            float swap = t0;
+            t0 = t1;
+            t1 = swap;
+        }
+        if (t0 > t_min) {
+            t_min = t0;
+        }
+        if (t1 < t_max) {
+            t_max = t1;
+        }
+        if (t_min > t_max) {
+            return -1.0f;
+        }
+    }
+
+    return t_min;
+}
+
+static void network_server_tick(NetworkServer *server)
+{
+    server->stats.tick += 1;
+
+    if (server->stats.connected_clients == 0U) {
+        server->ticks_since_snapshot = 0;
+        return;
+    }
+
+    float rtt_sum = 0.0f;
+    float rtt_max = 0.0f;
+    uint32_t rtt_count = 0;
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        NetworkServerClient *client = &server->clients[i];
+        if (client->connected) {
+            network_server_simulate_client(server, client);
+            float rtt = (float)client->peer->roundTripTime;
+            rtt_sum += rtt;
+            rtt_max = rtt > rtt_max ? rtt : rtt_max;
+            ++rtt_count;
+        }
+    }
+    server->stats.rtt_mean_ms = rtt_count > 0U ? rtt_sum / (float)rtt_count : 0.0f;
+    server->stats.rtt_max_ms = rtt_max;
+    network_server_record_history(server);
+
+    network_server_rebuild_grid(server);
+
+    server->ticks_since_snapshot += 1;
+    if (server->ticks_since_snapshot >= server->ticks_per_snapshot) {
+        server->ticks_since_snapshot = 0;
+        network_server_broadcast_snapshot(server);
+    } else {
+        server->stats.snapshots_suppressed += server->stats.connected_clients;
+    }
+}
+
+static void network_server_record_jitter(NetworkServer *server, float lateness_ms)
+{
+    NetworkServerStats *stats = &server->stats;
+    stats->tick_jitter_samples += 1;
+
+    /* Welford's running mean and variance */
+    double delta = (double)lateness_ms - server->tick_jitter_mean;
+    server->tick_jitter_mean += delta / (double)stats->tick_jitter_samples;
+    server->tick_jitter_m2 += delta * ((double)lateness_ms - server->tick_jitter_mean);
+    stats->tick_jitter_mean_ms = (float)server->tick_jitter_mean;
+    stats->tick_jitter_stddev_ms = (float)sqrt(server->tick_jitter_m2 / (double)stats->tick_jitter_samples);
+    if (lateness_ms > stats->tick_jitter_max_ms) {
+        stats->tick_jitter_max_ms = lateness_ms;
+    }
+}
+
+static uint32_t network_server_run_ticks(NetworkServer *server, float dt)
+{
+    if (dt > 0.0f) {
+        server->tick_accumulator += dt;
+    }
+
+    uint32_t ticks = 0;
+    while (server->tick_accumulator >= server->tick_interval) {
+        server->tick_accumulator -= server->tick_interval;
+        if (ticks >= NETWORK_SERVER_MAX_CATCHUP_TICKS) {
+            /* drop backlog after a stall instead of bursting snapshots */
+            server->tick_accumulator = 0.0f;
+            break;
+        }
+        network_server_tick(server);
+        ++ticks;
+    }
+
+    if (ticks > 0U && server->stats.connected_clients > 0U) {
+        /* what is left in the accumulator is how long ago the last tick was due */
+        network_server_record_jitter(server, server->tick_accumulator * 1000.0f);
+    }
+    return ticks;
+}
+
 void network_server_update(NetworkServer *server, float dt)
 {
     if (!server || !server->host) {
@@ -725,6 +1936,10 @@ void network_server_update(NetworkServer *server, float dt)
     while (enet_host_service(server->host, &event, 0) > 0) {
         switch (event.type) {
         case ENET_EVENT_TYPE_CONNECT: {
+            if (network_server_find_client(server, event.peer)) {
+                /* repeated handshake from a peer that already has a slot */
+                break;
+            }
             if (server->stats.connected_clients >= server->stats.max_clients) {
                 printf("[network] rejecting connection: server full\n");
                 enet_peer_disconnect(event.peer, 0);
@@ -757,120 +1972,16 @@ void network_server_update(NetworkServer *server, float dt)
                 } else if (type == NETWORK_MESSAGE_HELLO) {
                     network_server_send_welcome(server, client_slot);
                     network_server_broadcast_player_count(server);
-                    network_server_send_snapshot_to(server, event.peer);
+                    network_server_send_snapshot_to(server, client_slot);
                     network_server_master_push(server);
-                } else if (type == NETWORK_MESSAGE_CLIENT_STATE && event.packet->dataLength >= 1 + sizeof(float) * 4) {
-                    const float *payload = (const float *)(event.packet->data + 1);
-                    memcpy(client_slot->position, payload, sizeof(float) * 3);
-                    memcpy(&client_slot->yaw, payload + 3, sizeof(float));
-                    client_slot->has_state = 1;
-                    server->snapshot_timer = 0.0f;
-                    network_server_broadcast_snapshot(server);
+                } else if (type == NETWORK_MESSAGE_CLIENT_COMMAND) {
+                    network_server_queue_commands(server, client_slot, event.packet->data, event.packet->dataLength);
+                } else if (type == NETWORK_MESSAGE_SNAPSHOT_ACK) {
+                    network_server_handle_snapshot_ack(server, client_slot, event.packet->data, event.packet->dataLength);
                 } else if (type == NETWORK_MESSAGE_CLIENT_WEAPON_EVENT && event.packet->dataLength >= 1 + NETWORK_WEAPON_EVENT_DATA_SIZE) {
-                    if (client_slot) {
-                        size_t payload_size = event.packet->dataLength - 1;
-                        if (payload_size > NETWORK_WEAPON_EVENT_DATA_SIZE) {
-                            payload_size = NETWORK_WEAPON_EVENT_DATA_SIZE;
-                        }
-
-                        enet_uint8 buffer[2 + NETWORK_WEAPON_EVENT_DATA_SIZE];
-                        buffer[0] = NETWORK_MESSAGE_WEAPON_EVENT;
-                        buffer[1] = client_slot->id;
-                        memset(buffer + 2, 0, NETWORK_WEAPON_EVENT_DATA_SIZE);
-                        memcpy(buffer + 2, event.packet->data + 1, payload_size);
-
-                        ENetPacket *relay = enet_packet_create(buffer,
-                                                               sizeof(buffer),
-                                                               ENET_PACKET_FLAG_RELIABLE);
-                        if (relay) {
-                            enet_host_broadcast(server->host, 0, relay);
-                        }
-                    }
+                    network_server_relay_weapon_event(server, client_slot, event.packet->data + 1, event.packet->dataLength - 1);
                 } else if (type == NETWORK_MESSAGE_CLIENT_VOICE_DATA && event.packet->dataLength > 1 + 7) {
-                    if (client_slot && client_slot->has_state) {
-                        const enet_uint8 *payload = event.packet->data;
-                        uint8_t codec = payload[1];
-                        uint8_t channels = payload[2];
-                        uint16_t sample_rate = (uint16_t)(payload[3] | ((uint16_t)payload[4] << 8));
-                        uint16_t frame_count = (uint16_t)(payload[5] | ((uint16_t)payload[6] << 8));
-                        uint8_t gain_byte = payload[7];
-                        size_t voice_bytes = event.packet->dataLength - 8;
-
-                        if (codec != NETWORK_VOICE_CODEC_PCM16 ||
-                            channels == 0U || channels > NETWORK_VOICE_MAX_CHANNELS ||
-                            frame_count == 0U ||
-                            voice_bytes > NETWORK_VOICE_MAX_DATA ||
-                            voice_bytes != (size_t)frame_count * channels * sizeof(int16_t)) {
-                            /* ignore malformed voice packets */
-                            printf("[network] ignoring invalid voice packet from %u\n", (unsigned)client_slot->id);
-                        } else {
-                            float emitter_gain = (float)gain_byte / 255.0f;
-                            if (emitter_gain <= 0.0f) {
-                                emitter_gain = 1.0f;
-                            } else if (emitter_gain > 1.0f) {
-                                emitter_gain = 1.0f;
-                            }
-
-                            NetworkVoiceChatMode voice_mode = server->config.voice_mode;
-                            float voice_range = server->config.voice_range > 0.0f ? server->config.voice_range : NETWORK_VOICE_RANGE;
-
-                            for (uint32_t i = 0; i < server->client_capacity; ++i) {
-                                NetworkServerClient *target = &server->clients[i];
-                                if (!target->connected || !target->has_state || target->peer == client_slot->peer) {
-                                    continue;
-                                }
-
-                                float volume_scale = emitter_gain;
-                                if (voice_mode != NETWORK_VOICE_CHAT_GLOBAL) {
-                                    float dx = target->position[0] - client_slot->position[0];
-                                    float dy = target->position[1] - client_slot->position[1];
-                                    float dz = target->position[2] - client_slot->position[2];
-                                    float distance = sqrtf(dx * dx + dy * dy + dz * dz);
-                                    if (distance > voice_range) {
-                                        continue;
-                                    }
-
-                                    float attenuation = 1.0f - (distance / voice_range);
-                                    if (attenuation <= 0.0f) {
-                                        continue;
-                                    }
-                                    volume_scale *= attenuation;
-                                }
-
-                                if (volume_scale <= 0.0f) {
-                                    continue;
-                                }
-                                if (volume_scale > 1.0f) {
-                                    volume_scale = 1.0f;
-                                }
-
-                                enet_uint8 volume_byte = (enet_uint8)(volume_scale * 255.0f);
-                                if (volume_byte == 0U) {
-                                    continue;
-                                }
-
-                                enet_uint8 buffer[9 + NETWORK_VOICE_MAX_DATA];
-                                buffer[0] = NETWORK_MESSAGE_VOICE_DATA;
-                                buffer[1] = client_slot->id;
-                                buffer[2] = codec;
-                                buffer[3] = channels;
-                                buffer[4] = (enet_uint8)(sample_rate & 0xFF);
-                                buffer[5] = (enet_uint8)((sample_rate >> 8) & 0xFF);
-                                buffer[6] = (enet_uint8)(frame_count & 0xFF);
-                                buffer[7] = (enet_uint8)((frame_count >> 8) & 0xFF);
-                                buffer[8] = volume_byte;
-                                memcpy(buffer + 9, payload + 8, voice_bytes);
-
-                                ENetPacket *voice_packet =
-                                    enet_packet_create(buffer,
-                                                       9 + voice_bytes,
-                                                       ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT);
-                                if (voice_packet) {
-                                    enet_peer_send(target->peer, 0, voice_packet);
-                                }
-                            }
-                        }
-                    }
+                    network_server_relay_voice(server, client_slot, event.packet->data, event.packet->dataLength);
                 } else {
                     printf("[network] unknown message type: 0x%02X\n", type);
                 }
@@ -882,8 +1993,8 @@ void network_server_update(NetworkServer *server, float dt)
         }
         case ENET_EVENT_TYPE_DISCONNECT: {
             NetworkServerClient *slot = network_server_find_client(server, event.peer);
-            if (slot && slot->connected) {
-                network_server_release_client(server, event.peer);
+            if (slot) {
+                network_server_release_client(server, slot);
                 if (server->stats.connected_clients > 0) {
                     server->stats.connected_clients -= 1;
                 }
@@ -895,7 +2006,6 @@ void network_server_update(NetworkServer *server, float dt)
                    (unsigned)event.data);
             network_server_broadcast_player_count(server);
             network_server_master_push(server);
-            network_server_broadcast_snapshot(server);
             break;
         }
         default:
@@ -903,17 +2013,25 @@ void network_server_update(NetworkServer *server, float dt)
         }
     }
 
-    if (server->stats.connected_clients > 0U) {
-        server->snapshot_timer += dt;
-        if (server->snapshot_timer >= NETWORK_SERVER_SNAPSHOT_INTERVAL) {
-            server->snapshot_timer = 0.0f;
-            network_server_broadcast_snapshot(server);
-        }
-    } else {
-        server->snapshot_timer = 0.0f;
+    uint32_t ticks = network_server_run_ticks(server, dt);
+    /* outgoing frames go out once per tick; with nobody connected no tick is
+     * scheduled, so flush right away */
+    if (ticks > 0U || server->stats.connected_clients == 0U) {
+        network_server_flush_all(server);
     }
-
     network_server_master_update(server, dt);
+
+    ENetPacketPoolStats pool;
+    enet_host_packet_pool_stats(server->host, &pool);
+    server->stats.packet_pool_hits = pool.hits;
+    server->stats.packet_pool_misses = pool.misses;
+
+    if (server->config.simulate_latency) {
+        ENetSimulatorStats simulator;
+        enet_host_simulator_stats(server->host, &simulator);
+        server->stats.simulated_drops = simulator.dropped;
+        server->stats.simulated_queued = simulator.queued;
+    }
 }
 
 const NetworkServerStats *network_server_stats(const NetworkServer *server)
@@ -923,3 +2041,169 @@ const NetworkServerStats *network_server_stats(const NetworkServer *server)
     }
     return &server->stats;
 }
+
+float network_server_next_deadline(const NetworkServer *server)
+{
+    if (!server) {
+        return -1.0f;
+    }
+
+    float deadline = -1.0f;
+    if (server->stats.connected_clients > 0U) {
+        deadline = server->tick_interval - server->tick_accumulator;
+        if (deadline < 0.0f) {
+            deadline = 0.0f;
+        }
+    }
+
+    /* datagrams held back by the network simulator leave at 1 ms resolution */
+    if (server->stats.simulated_queued > 0U && (deadline < 0.0f || deadline > 0.001f)) {
+        deadline = 0.001f;
+    }
+
+    const NetworkServerMaster *master = &server->master;
+    if (master->enabled && master->socket != INVALID_SOCKET) {
+        float master_due = 0.0f;
+        if (master->retry_timer > 0.0f) {
+            master_due = master->retry_timer;
+        } else if (master->registered) {
+            master_due = master->heartbeat_interval - master->heartbeat_timer;
+            if (master_due < 0.0f) {
+                master_due = 0.0f;
+            }
+        }
+        if (deadline < 0.0f || master_due < deadline) {
+            deadline = master_due;
+        }
+    }
+
+    return deadline;
+}
+
+intptr_t network_server_socket(const NetworkServer *server)
+{
+    if (!server || !server->host) {
+        return -1;
+    }
+    return (intptr_t)enet_host_socket(server->host);
+}
+
+bool network_server_inject(NetworkServer *server, uint32_t peer, const uint8_t *data, size_t size)
+{
+    if (!server || !server->host || !server->config.offline) {
+        return false;
+    }
+    return enet_host_inject(server->host, peer, data, size) == 0;
+}
+
+bool network_server_client_rtt(const NetworkServer *server, uint8_t client_id, float *rtt_ms, float *rtt_variance_ms)
+{
+    if (!server || server->slot_by_id[client_id] < 0) {
+        return false;
+    }
+    const NetworkServerClient *client = &server->clients[server->slot_by_id[client_id]];
+    if (!client->connected || !client->peer) {
+        return false;
+    }
+    if (rtt_ms) {
+        *rtt_ms = (float)client->peer->roundTripTime;
+    }
+    if (rtt_variance_ms) {
+        *rtt_variance_ms = (float)client->peer->roundTripTimeVariance;
+    }
+    return true;
+}
+
+double network_server_time(const NetworkServer *server)
+{
+    if (!server) {
+        return 0.0;
+    }
+    return (double)server->stats.tick * (double)server->tick_interval;
+}
+
+bool network_server_rewind_raycast(const NetworkServer *server,
+                                   double timestamp,
+                                   const float origin[3],
+                                   const float direction[3],
+                                   float max_distance,
+                                   uint8_t ignore_id,
+                                   NetworkServerRewindHit *out_hit)
+{
+    if (!server || !origin || !direction || !server->history.has_frames || max_distance <= 0.0f) {
+        return false;
+    }
+
+    const NetworkServerHistory *history = &server->history;
+    double tick_position = timestamp / (double)server->tick_interval;
+    if (tick_position < (double)history->oldest_tick) {
+        tick_position = (double)history->oldest_tick;
+    } else if (tick_position > (double)history->newest_tick) {
+        tick_position = (double)history->newest_tick;
+    }
+
+    uint32_t older_tick = (uint32_t)tick_position;
+    uint32_t newer_tick = older_tick < history->newest_tick ? older_tick + 1U : older_tick;
+    float alpha = (float)(tick_position - (double)older_tick);
+
+    const NetworkServerHistorySample *older = network_server_history_frame(server, older_tick);
+    const NetworkServerHistorySample *newer = network_server_history_frame(server, newer_tick);
+    if (!older && !newer) {
+        return false;
+    }
+
+    int hit = 0;
+    NetworkServerRewindHit best;
+    memset(&best, 0, sizeof(best));
+    best.distance = max_distance;
+
+    for (uint32_t i = 0; i < server->client_capacity; ++i) {
+        const NetworkServerHistorySample *a = older && older[i].valid ? &older[i] : NULL;
+        const NetworkServerHistorySample *b = newer && newer[i].valid ? &newer[i] : NULL;
+
+        float center[3];
+        const float *half_extents = NULL;
+        uint8_t id = 0;
+        if (a && b && a->id == b->id) {
+            for (int axis = 0; axis < 3; ++axis) {
+                center[axis] = a->position[axis] + (b->position[axis] - a->position[axis]) * alpha;
+            }
+            half_extents = b->half_extents;
+            id = b->id;
+        } else {
+            /* slot changed owner or missed a tick: take the nearer sample */
+            const NetworkServerHistorySample *nearest = (alpha < 0.5f && a) || !b ? a : b;
+            if (!nearest) {
+                continue;
+            }
+            memcpy(center, nearest->position, sizeof(center));
+            half_extents = nearest->half_extents;
+            id = nearest->id;
+        }
+
+        if (id == ignore_id) {
+            continue;
+        }
+
+        float distance = network_server_ray_aabb(origin, direction, center, half_extents, best.distance);
+        if (distance < 0.0f) {
+            continue;
+        }
+
+        hit = 1;
+        best.client_id = id;
+        best.distance = distance;
+    }
+
+    if (!hit) {
+        return false;
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+        best.point[axis] = origin[axis] + direction[axis] * best.distance;
+    }
+    if (out_hit) {
+        *out_hit = best;
+    }
+    return true;
+}
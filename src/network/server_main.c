@@ -1,17 +1,17 @@
 #include "engine/network_server.h"
+#include "engine/network_server_pool.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
-#ifdef _WIN32
-#  include <windows.h>
-static void sleep_ms(unsigned ms){ Sleep(ms); }
-#else
-#  include <unistd.h>
-static void sleep_ms(unsigned ms){ usleep(ms*1000); }
-#endif
 
 #define SERVER_DEFAULT_VOICE_RANGE 22.0f
+#define SERVER_DEFAULT_TICK_RATE 60.0f
+#define SERVER_DEFAULT_SNAPSHOT_RATE 20.0f
+#define SERVER_DEFAULT_RELEVANCE_RADIUS 120.0f
+#define SERVER_REPORT_INTERVAL 10.0
+
+static char g_server_capture_path[260];
 
 static void server_trim(char *str)
 {
@@ -47,7 +47,7 @@ static int server_iequal(const char *a, const char *b)
     return *a == '\0' && *b == '\0';
 }
 
-static void server_load_config(NetworkServerConfig *cfg)
+static void server_load_config(NetworkServerConfig *cfg, unsigned *instances, unsigned *workers)
 {
     if (!cfg) {
         return;
@@ -86,6 +86,60 @@ static void server_load_config(NetworkServerConfig *cfg)
             if (parsed > 0.0f) {
                 cfg->voice_range = parsed;
             }
+        } else if (server_iequal(key, "tick_rate")) {
+            float parsed = (float)strtod(value, NULL);
+            if (parsed > 0.0f) {
+                cfg->tick_rate = parsed;
+            }
+        } else if (server_iequal(key, "snapshot_rate")) {
+            float parsed = (float)strtod(value, NULL);
+            if (parsed > 0.0f) {
+                cfg->snapshot_rate = parsed;
+            }
+        } else if (server_iequal(key, "relevance_radius")) {
+            float parsed = (float)strtod(value, NULL);
+            if (parsed > 0.0f) {
+                cfg->relevance_radius = parsed;
+            }
+        } else if (server_iequal(key, "world_min")) {
+            float v[3];
+            if (sscanf(value, "%f %f %f", &v[0], &v[1], &v[2]) == 3) {
+                memcpy(cfg->quantization.world_min, v, sizeof(v));
+            }
+        } else if (server_iequal(key, "world_max")) {
+            float v[3];
+            if (sscanf(value, "%f %f %f", &v[0], &v[1], &v[2]) == 3) {
+                memcpy(cfg->quantization.world_max, v, sizeof(v));
+            }
+        } else if (server_iequal(key, "position_bits")) {
+            unsigned v[3];
+            if (sscanf(value, "%u %u %u", &v[0], &v[1], &v[2]) == 3) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    cfg->quantization.position_bits[axis] = (uint8_t)v[axis];
+                }
+            }
+        } else if (server_iequal(key, "capture")) {
+            snprintf(g_server_capture_path, sizeof(g_server_capture_path), "%s", value);
+            cfg->capture_path = g_server_capture_path;
+        } else if (server_iequal(key, "instances")) {
+            unsigned parsed = (unsigned)strtoul(value, NULL, 10);
+            if (parsed > 0U) {
+                *instances = parsed;
+            }
+        } else if (server_iequal(key, "workers")) {
+            *workers = (unsigned)strtoul(value, NULL, 10);
+        } else if (server_iequal(key, "receive_shards")) {
+            cfg->receive_shards = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strncmp(key, "sim_", 4) == 0) {
+            /* sim_latency, sim_loss, ...: see network_conditions_set */
+            if (network_conditions_set(&cfg->conditions, key + 4, value)) {
+                cfg->simulate_latency = true;
+            }
+        } else if (server_iequal(key, "yaw_bits")) {
+            unsigned parsed = (unsigned)strtoul(value, NULL, 10);
+            if (parsed > 0U) {
+                cfg->quantization.yaw_bits = (uint8_t)parsed;
+            }
         }
     }
 
@@ -111,8 +165,16 @@ int main(int argc, char** argv)
     cfg.advertised_mode = 1;
     cfg.voice_mode = NETWORK_VOICE_CHAT_PROXIMITY;
     cfg.voice_range = SERVER_DEFAULT_VOICE_RANGE;
+    cfg.tick_rate = SERVER_DEFAULT_TICK_RATE;
+    cfg.snapshot_rate = SERVER_DEFAULT_SNAPSHOT_RATE;
+    network_quantization_default(&cfg.quantization);
+    cfg.relevance_radius = SERVER_DEFAULT_RELEVANCE_RADIUS;
 
-    server_load_config(&cfg);
+    // Instances hébergées par ce process (ports consécutifs), workers 0 = un par cœur
+    unsigned instances = 1;
+    unsigned workers = 0;
+
+    server_load_config(&cfg, &instances, &workers);
 
     // Parsing ultra simple des args: --port 26015 --name "xxx"
     for (int i=1; i+1<argc; ++i){
@@ -132,24 +194,35 @@ int main(int argc, char** argv)
             }
         }
         else if (strcmp(argv[i], "--voice-range")==0) cfg.voice_range = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--tick-rate")==0) cfg.tick_rate = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--snapshot-rate")==0) cfg.snapshot_rate = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--relevance")==0) cfg.relevance_radius = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--instances")==0) instances = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--workers")==0) workers = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--shards")==0) cfg.receive_shards = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--capture")==0) cfg.capture_path = argv[++i];
+        // --sim-latency 40 --sim-jitter 8 --sim-loss 0.01 ... (conditions réseau simulées)
+        else if (strncmp(argv[i], "--sim-", 6)==0) {
+            if (network_conditions_set(&cfg.conditions, argv[i] + 6, argv[i + 1])) cfg.simulate_latency = true;
+            ++i;
+        }
     }
 
-    NetworkServer* server = network_server_create(&cfg);
-    if (!server){
+    if (instances == 0U) {
+        instances = 1;
+    }
+
+    NetworkServerPool* pool = network_server_pool_create(&cfg, instances, workers);
+    if (!pool){
         fprintf(stderr, "Failed to start server on port %u\n", cfg.port);
         return 1;
     }
 
     printf("Server started on %u. Press Ctrl+C to quit.\n", cfg.port);
 
-    // Boucle principale ~60 Hz
-    const float dt = 1.0f/60.0f;
-    for (;;){
-        network_server_update(server, dt);
-        sleep_ms(16);
-    }
+    // Chaque worker attend ses sockets ou la prochaine échéance (tick, heartbeat)
+    network_server_pool_run(pool, SERVER_REPORT_INTERVAL);
 
-    // (jamais atteint)
-    // network_server_destroy(server);
-    // return 0;
+    network_server_pool_destroy(pool);
+    return 1;
 }
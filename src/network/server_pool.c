@@ -0,0 +1,533 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* clock_gettime */
+#endif
+
+#include "engine/network_server_pool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <winsock2.h>
+#    include <windows.h>
+#else
+#    include <errno.h>
+#    include <pthread.h>
+#    include <stdatomic.h>
+#    include <time.h>
+#    include <unistd.h>
+#    if defined(__linux__)
+#        include <sys/epoll.h>
+#    else
+#        include <sys/select.h>
+#    endif
+#endif
+
+#define NETWORK_SERVER_POOL_MAX_EVENTS 64
+#define NETWORK_SERVER_POOL_NAME_MAX 96
+#define NETWORK_SERVER_POOL_PATH_MAX 260
+/* longest a worker sleeps before checking whether the pool is stopping */
+#define NETWORK_SERVER_POOL_STOP_POLL_MS 250
+
+typedef struct NetworkServerInstance {
+    NetworkServer *server;
+    char name[NETWORK_SERVER_POOL_NAME_MAX];
+    char capture_path[NETWORK_SERVER_POOL_PATH_MAX];
+    uint16_t port;
+    intptr_t socket;
+    int ready;
+    double last_update;
+    double next_due;
+    /* tick-time accounting, touched only by the owning worker */
+    uint64_t updates;
+    double busy_seconds;
+    float max_update_ms;
+    uint64_t report_updates;
+    double report_busy_seconds;
+    uint32_t report_tick;
+    uint64_t report_messages;
+    uint64_t report_datagrams;
+} NetworkServerInstance;
+
+typedef struct NetworkServerWorker {
+    NetworkServerPool *pool;
+    uint32_t index;
+    int ok;
+#if defined(__linux__)
+    int epoll_fd;
+#endif
+#if defined(_WIN32)
+    HANDLE thread;
+#else
+    pthread_t thread;
+    int thread_started;
+#endif
+} NetworkServerWorker;
+
+struct NetworkServerPool {
+    NetworkServerInstance *instances;
+    uint32_t instance_count;
+    NetworkServerWorker *workers;
+    uint32_t worker_count;
+    double report_interval;
+    /* set when any worker fails; every worker then leaves its loop */
+#if defined(_WIN32)
+    volatile LONG stopping;
+#else
+    atomic_int stopping;
+#endif
+};
+
+static double network_server_pool_now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void network_server_pool_request_stop(NetworkServerPool *pool)
+{
+#if defined(_WIN32)
+    InterlockedExchange(&pool->stopping, 1);
+#else
+    atomic_store(&pool->stopping, 1);
+#endif
+}
+
+static int network_server_pool_stopping(NetworkServerPool *pool)
+{
+#if defined(_WIN32)
+    return InterlockedCompareExchange(&pool->stopping, 0, 0) != 0;
+#else
+    return atomic_load(&pool->stopping) != 0;
+#endif
+}
+
+static uint32_t network_server_pool_core_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1U;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (uint32_t)cores : 1U;
+#endif
+}
+
+static void network_server_pool_schedule(NetworkServerInstance *instance, double now)
+{
+    float deadline = network_server_next_deadline(instance->server);
+    instance->next_due = deadline < 0.0f ? -1.0 : now + (double)deadline;
+}
+
+static void network_server_pool_run_instance(NetworkServerInstance *instance, double now)
+{
+    network_server_update(instance->server, (float)(now - instance->last_update));
+    instance->last_update = now;
+
+    double finished = network_server_pool_now();
+    double elapsed = finished - now;
+    instance->updates += 1;
+    instance->busy_seconds += elapsed;
+    if ((float)(elapsed * 1000.0) > instance->max_update_ms) {
+        instance->max_update_ms = (float)(elapsed * 1000.0);
+    }
+
+    network_server_pool_schedule(instance, finished);
+}
+
+static void network_server_pool_report(NetworkServerWorker *worker, double interval)
+{
+    NetworkServerPool *pool = worker->pool;
+    for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+        NetworkServerInstance *instance = &pool->instances[i];
+        const NetworkServerStats *stats = network_server_stats(instance->server);
+        uint64_t updates = instance->updates - instance->report_updates;
+        double busy = instance->busy_seconds - instance->report_busy_seconds;
+        uint32_t ticks = stats->tick - instance->report_tick;
+        uint64_t messages = stats->messages_sent - instance->report_messages;
+        uint64_t datagrams = stats->datagrams_sent - instance->report_datagrams;
+
+        if (stats->connected_clients > 0U || updates > 0U) {
+            printf("[pool] instance %u port %u (worker %u): %u clients, %u ticks, %.3f ms/tick, max update %.3f ms, "
+                   "busy %.1f%%, jitter mean %.3f ms stddev %.3f ms max %.3f ms, %.0f msg/s in %.0f datagrams/s, "
+                   "rtt mean %.0f ms max %.0f ms\n",
+                   i,
+                   (unsigned)instance->port,
+                   worker->index,
+                   stats->connected_clients,
+                   ticks,
+                   ticks > 0U ? busy * 1000.0 / (double)ticks : 0.0,
+                   instance->max_update_ms,
+                   interval > 0.0 ? busy * 100.0 / interval : 0.0,
+                   stats->tick_jitter_mean_ms,
+                   stats->tick_jitter_stddev_ms,
+                   stats->tick_jitter_max_ms,
+                   interval > 0.0 ? (double)messages / interval : 0.0,
+                   interval > 0.0 ? (double)datagrams / interval : 0.0,
+                   stats->rtt_mean_ms,
+                   stats->rtt_max_ms);
+        }
+
+        instance->report_updates = instance->updates;
+        instance->report_busy_seconds = instance->busy_seconds;
+        instance->report_tick = stats->tick;
+        instance->report_messages = stats->messages_sent;
+        instance->report_datagrams = stats->datagrams_sent;
+        instance->max_update_ms = 0.0f;
+    }
+}
+
+static int network_server_pool_worker_init(NetworkServerWorker *worker)
+{
+#if defined(__linux__)
+    NetworkServerPool *pool = worker->pool;
+    worker->epoll_fd = epoll_create1(0);
+    if (worker->epoll_fd < 0) {
+        perror("[pool] epoll_create1");
+        return 0;
+    }
+
+    for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, (int)pool->instances[i].socket, &ev) != 0) {
+            perror("[pool] epoll_ctl");
+            close(worker->epoll_fd);
+            worker->epoll_fd = -1;
+            return 0;
+        }
+    }
+#else
+    (void)worker;
+#endif
+    return 1;
+}
+
+/* Waits until one of the worker's sockets is readable or timeout_ms passes
+ * (< 0 waits indefinitely) and flags the readable instances. */
+static int network_server_pool_wait(NetworkServerWorker *worker, int timeout_ms)
+{
+    NetworkServerPool *pool = worker->pool;
+
+#if defined(__linux__)
+    struct epoll_event events[NETWORK_SERVER_POOL_MAX_EVENTS];
+    int ready = epoll_wait(worker->epoll_fd, events, NETWORK_SERVER_POOL_MAX_EVENTS, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return 1;
+        }
+        perror("[pool] epoll_wait");
+        return 0;
+    }
+    for (int e = 0; e < ready; ++e) {
+        pool->instances[events[e].data.u32].ready = 1;
+    }
+    return 1;
+#else
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    intptr_t max_socket = 0;
+    for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+        FD_SET(pool->instances[i].socket, &read_fds);
+        if (pool->instances[i].socket > max_socket) {
+            max_socket = pool->instances[i].socket;
+        }
+    }
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    int ready = select((int)max_socket + 1, &read_fds, NULL, NULL, timeout_ms < 0 ? NULL : &tv);
+    if (ready < 0) {
+#    if !defined(_WIN32)
+        if (errno == EINTR) {
+            return 1;
+        }
+#    endif
+        fprintf(stderr, "[pool] select failed\n");
+        return 0;
+    }
+    for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+        if (FD_ISSET(pool->instances[i].socket, &read_fds)) {
+            pool->instances[i].ready = 1;
+        }
+    }
+    return 1;
+#endif
+}
+
+static void network_server_pool_worker_loop(NetworkServerWorker *worker)
+{
+    NetworkServerPool *pool = worker->pool;
+    double now = network_server_pool_now();
+    double last_report = now;
+
+    for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+        pool->instances[i].last_update = now;
+        network_server_pool_schedule(&pool->instances[i], now);
+    }
+
+    while (!network_server_pool_stopping(pool)) {
+        double earliest = -1.0;
+        for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+            double due = pool->instances[i].next_due;
+            if (due >= 0.0 && (earliest < 0.0 || due < earliest)) {
+                earliest = due;
+            }
+        }
+        if (pool->report_interval > 0.0) {
+            double report_due = last_report + pool->report_interval;
+            if (earliest < 0.0 || report_due < earliest) {
+                earliest = report_due;
+            }
+        }
+
+        int timeout_ms = NETWORK_SERVER_POOL_STOP_POLL_MS;
+        if (earliest >= 0.0) {
+            double wait = earliest - network_server_pool_now();
+            /* round up so we never wake just before the deadline */
+            timeout_ms = wait > 0.0 ? (int)ceil(wait * 1000.0) : 0;
+            if (timeout_ms > NETWORK_SERVER_POOL_STOP_POLL_MS) {
+                timeout_ms = NETWORK_SERVER_POOL_STOP_POLL_MS;
+            }
+        }
+
+        if (!network_server_pool_wait(worker, timeout_ms)) {
+            fprintf(stderr, "[pool] worker %u failed, stopping the pool\n", worker->index);
+            worker->ok = 0;
+            network_server_pool_request_stop(pool);
+            return;
+        }
+
+        now = network_server_pool_now();
+        for (uint32_t i = worker->index; i < pool->instance_count; i += pool->worker_count) {
+            NetworkServerInstance *instance = &pool->instances[i];
+            int due = instance->next_due >= 0.0 && now >= instance->next_due;
+            if (instance->ready || due) {
+                instance->ready = 0;
+                network_server_pool_run_instance(instance, now);
+            }
+        }
+
+        if (pool->report_interval > 0.0 && now - last_report >= pool->report_interval) {
+            network_server_pool_report(worker, now - last_report);
+            last_report = now;
+        }
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI network_server_pool_thread(LPVOID param)
+{
+    network_server_pool_worker_loop((NetworkServerWorker *)param);
+    return 0;
+}
+#else
+static void *network_server_pool_thread(void *param)
+{
+    network_server_pool_worker_loop((NetworkServerWorker *)param);
+    return NULL;
+}
+#endif
+
+NetworkServerPool *network_server_pool_create(const NetworkServerConfig *base,
+                                              uint32_t instance_count,
+                                              uint32_t worker_count)
+{
+    if (!base || instance_count == 0U) {
+        return NULL;
+    }
+    if ((uint32_t)base->port + instance_count - 1U > 65535U) {
+        fprintf(stderr, "[pool] %u instances from port %u exceed the port range\n", instance_count, (unsigned)base->port);
+        return NULL;
+    }
+
+    if (worker_count == 0U) {
+        worker_count = network_server_pool_core_count();
+    }
+    if (worker_count > instance_count) {
+        worker_count = instance_count;
+    }
+
+    NetworkServerPool *pool = (NetworkServerPool *)calloc(1, sizeof(NetworkServerPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->instances = (NetworkServerInstance *)calloc(instance_count, sizeof(NetworkServerInstance));
+    pool->workers = (NetworkServerWorker *)calloc(worker_count, sizeof(NetworkServerWorker));
+    if (!pool->instances || !pool->workers) {
+        free(pool->instances);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pool->worker_count = worker_count;
+#if !defined(_WIN32)
+    atomic_init(&pool->stopping, 0);
+#endif
+
+    const char *base_name = base->name && base->name[0] != '\0' ? base->name : "Slashed Project 1986 Server";
+    for (uint32_t i = 0; i < instance_count; ++i) {
+        NetworkServerInstance *instance = &pool->instances[i];
+        NetworkServerConfig config = *base;
+        config.port = (uint16_t)(base->port + i);
+        /* independent simulated losses per instance */
+        config.conditions.seed = base->conditions.seed + i;
+        if (instance_count > 1U) {
+            snprintf(instance->name, sizeof(instance->name), "%s #%u", base_name, i + 1U);
+        } else {
+            snprintf(instance->name, sizeof(instance->name), "%s", base_name);
+        }
+        config.name = instance->name;
+        if (instance_count > 1U && base->capture_path && base->capture_path[0] != '\0') {
+            /* one trace per instance */
+            snprintf(instance->capture_path, sizeof(instance->capture_path), "%s.%u", base->capture_path, i);
+            config.capture_path = instance->capture_path;
+        }
+
+        instance->server = network_server_create(&config);
+        if (!instance->server) {
+            fprintf(stderr, "[pool] failed to start instance %u on port %u\n", i, (unsigned)config.port);
+            network_server_pool_destroy(pool);
+            return NULL;
+        }
+        instance->port = config.port;
+        instance->socket = network_server_socket(instance->server);
+        instance->next_due = -1.0;
+        pool->instance_count = i + 1U;
+    }
+
+    for (uint32_t w = 0; w < worker_count; ++w) {
+        NetworkServerWorker *worker = &pool->workers[w];
+        worker->pool = pool;
+        worker->index = w;
+        worker->ok = 1;
+#if defined(__linux__)
+        worker->epoll_fd = -1;
+#endif
+    }
+
+    printf("[pool] %u instances on ports %u-%u, %u workers\n",
+           pool->instance_count,
+           (unsigned)base->port,
+           (unsigned)(base->port + pool->instance_count - 1U),
+           pool->worker_count);
+    return pool;
+}
+
+void network_server_pool_destroy(NetworkServerPool *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    if (pool->workers) {
+        for (uint32_t w = 0; w < pool->worker_count; ++w) {
+#if defined(__linux__)
+            if (pool->workers[w].epoll_fd >= 0) {
+                close(pool->workers[w].epoll_fd);
+            }
+#endif
+        }
+    }
+
+    for (uint32_t i = 0; i < pool->instance_count; ++i) {
+        network_server_destroy(pool->instances[i].server);
+    }
+
+    free(pool->instances);
+    free(pool->workers);
+    free(pool);
+}
+
+bool network_server_pool_run(NetworkServerPool *pool, double report_interval)
+{
+    if (!pool || pool->worker_count == 0U) {
+        return false;
+    }
+
+    pool->report_interval = report_interval;
+    for (uint32_t w = 0; w < pool->worker_count; ++w) {
+        if (!network_server_pool_worker_init(&pool->workers[w])) {
+            fprintf(stderr, "[pool] failed to set up worker %u\n", w);
+            return false;
+        }
+    }
+
+    /* instances are only ever touched by their own worker, so no locking */
+    bool started = true;
+    for (uint32_t w = 1; w < pool->worker_count && started; ++w) {
+        NetworkServerWorker *worker = &pool->workers[w];
+#if defined(_WIN32)
+        worker->thread = CreateThread(NULL, 0, network_server_pool_thread, worker, 0, NULL);
+        started = worker->thread != NULL;
+#else
+        started = pthread_create(&worker->thread, NULL, network_server_pool_thread, worker) == 0;
+        worker->thread_started = started ? 1 : 0;
+#endif
+        if (!started) {
+            fprintf(stderr, "[pool] failed to start worker %u\n", w);
+        }
+    }
+
+    if (started) {
+        network_server_pool_worker_loop(&pool->workers[0]);
+    } else {
+        /* the workers already running still use the instances; stop and
+         * join them before the caller destroys the pool */
+        network_server_pool_request_stop(pool);
+    }
+
+    bool ok = started && pool->workers[0].ok != 0;
+    for (uint32_t w = 1; w < pool->worker_count; ++w) {
+        NetworkServerWorker *worker = &pool->workers[w];
+#if defined(_WIN32)
+        if (worker->thread) {
+            WaitForSingleObject(worker->thread, INFINITE);
+            CloseHandle(worker->thread);
+            worker->thread = NULL;
+        }
+#else
+        if (worker->thread_started) {
+            pthread_join(worker->thread, NULL);
+            worker->thread_started = 0;
+        }
+#endif
+        ok = ok && worker->ok != 0;
+    }
+    return ok;
+}
+
+uint32_t network_server_pool_instance_count(const NetworkServerPool *pool)
+{
+    return pool ? pool->instance_count : 0U;
+}
+
+uint32_t network_server_pool_worker_count(const NetworkServerPool *pool)
+{
+    return pool ? pool->worker_count : 0U;
+}
+
+NetworkServer *network_server_pool_instance(NetworkServerPool *pool, uint32_t index)
+{
+    if (!pool || index >= pool->instance_count) {
+        return NULL;
+    }
+    return pool->instances[index].server;
+}
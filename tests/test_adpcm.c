@@ -0,0 +1,142 @@
+#include "engine/network_adpcm.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "test_common.h"
+
+#define TEST_PI 3.14159265358979323846
+
+/* one second of 16 kHz voice in 20 ms frames, as loadgen and the client send */
+#define TEST_SAMPLE_RATE 16000U
+#define TEST_FRAME_COUNT 320U
+#define TEST_FRAMES 50U
+#define TEST_TOTAL (TEST_FRAME_COUNT * TEST_FRAMES)
+
+/* the reference signal below measures 25.2 dB; a slip in the step tables or
+ * the nibble rounding costs several dB, which this floor catches */
+#define TEST_MIN_SNR_DB 23.0
+
+/* Three voice-band partials under a slow amplitude envelope, plus a chirp
+ * from 200 Hz to 4 kHz, peaking around -6 dBFS. */
+static void test_reference_signal(int16_t *samples, size_t count, uint8_t channels)
+{
+    for (size_t i = 0; i < count; ++i) {
+        double t = (double)i / (double)TEST_SAMPLE_RATE;
+        double envelope = 0.6 + 0.4 * sin(2.0 * TEST_PI * 3.0 * t);
+        double voice = 0.45 * sin(2.0 * TEST_PI * 220.0 * t) + 0.25 * sin(2.0 * TEST_PI * 1100.0 * t) +
+                       0.1 * sin(2.0 * TEST_PI * 2900.0 * t);
+        double chirp = 0.2 * sin(2.0 * TEST_PI * (200.0 * t + 1900.0 * t * t));
+        for (uint8_t c = 0; c < channels; ++c) {
+            /* the second channel is the first one attenuated, so a mixed-up
+             * interleave cannot pass */
+            double gain = c == 0 ? 1.0 : 0.5;
+            samples[i * channels + c] = (int16_t)lrint(16384.0 * gain * (envelope * voice + chirp));
+        }
+    }
+}
+
+static double test_snr_db(const int16_t *reference, const int16_t *decoded, size_t count)
+{
+    double signal = 0.0;
+    double noise = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        double error = (double)decoded[i] - (double)reference[i];
+        signal += (double)reference[i] * (double)reference[i];
+        noise += error * error;
+    }
+    return noise > 0.0 ? 10.0 * log10(signal / noise) : 200.0;
+}
+
+static double test_round_trip(uint8_t channels)
+{
+    static int16_t reference[TEST_TOTAL * 2];
+    static int16_t decoded[TEST_TOTAL * 2];
+    test_reference_signal(reference, TEST_TOTAL, channels);
+
+    NetworkAdpcmState encoder[2];
+    NetworkAdpcmState decoder[2];
+    for (uint8_t c = 0; c < 2; ++c) {
+        network_adpcm_state_reset(&encoder[c]);
+        network_adpcm_state_reset(&decoder[c]);
+    }
+
+    uint8_t packet[1024];
+    size_t encoded_size = network_adpcm_encoded_size(TEST_FRAME_COUNT, channels);
+    TEST_CHECK(encoded_size <= sizeof(packet));
+    for (size_t frame = 0; frame < TEST_FRAMES; ++frame) {
+        size_t offset = frame * TEST_FRAME_COUNT * channels;
+        size_t written = network_adpcm_encode(encoder, channels, reference + offset, TEST_FRAME_COUNT, packet, sizeof(packet));
+        TEST_CHECK(written == encoded_size);
+        size_t samples = network_adpcm_decode(decoder, channels, packet, written, TEST_FRAME_COUNT,
+                                              decoded + offset, (size_t)TEST_FRAME_COUNT * channels);
+        TEST_CHECK(samples == (size_t)TEST_FRAME_COUNT * channels);
+    }
+
+    return test_snr_db(reference, decoded, (size_t)TEST_TOTAL * channels);
+}
+
+static void test_snr(void)
+{
+    double mono = test_round_trip(1);
+    double stereo = test_round_trip(2);
+    printf("[adpcm] reference signal: %.1f dB mono, %.1f dB stereo\n", mono, stereo);
+    TEST_CHECK(mono >= TEST_MIN_SNR_DB);
+    TEST_CHECK(stereo >= TEST_MIN_SNR_DB);
+}
+
+/* Every frame carries the state it starts from, so decoding a frame with a
+ * fresh decoder (the one before it was lost) gives the same samples. */
+static void test_frame_independence(void)
+{
+    static int16_t reference[TEST_FRAME_COUNT * 3];
+    test_reference_signal(reference, TEST_FRAME_COUNT * 3, 1);
+
+    NetworkAdpcmState encoder;
+    NetworkAdpcmState continuous;
+    network_adpcm_state_reset(&encoder);
+    network_adpcm_state_reset(&continuous);
+
+    uint8_t packet[512];
+    int16_t expected[TEST_FRAME_COUNT];
+    int16_t resynced[TEST_FRAME_COUNT];
+    for (size_t frame = 0; frame < 3; ++frame) {
+        size_t written = network_adpcm_encode(&encoder, 1, reference + frame * TEST_FRAME_COUNT, TEST_FRAME_COUNT,
+                                              packet, sizeof(packet));
+        TEST_CHECK(written > 0);
+        TEST_CHECK(network_adpcm_decode(&continuous, 1, packet, written, TEST_FRAME_COUNT, expected, TEST_FRAME_COUNT) ==
+                   TEST_FRAME_COUNT);
+
+        NetworkAdpcmState fresh;
+        network_adpcm_state_reset(&fresh);
+        TEST_CHECK(network_adpcm_decode(&fresh, 1, packet, written, TEST_FRAME_COUNT, resynced, TEST_FRAME_COUNT) ==
+                   TEST_FRAME_COUNT);
+        TEST_CHECK(memcmp(expected, resynced, sizeof(expected)) == 0);
+    }
+}
+
+static void test_short_buffers(void)
+{
+    int16_t samples[TEST_FRAME_COUNT];
+    memset(samples, 0, sizeof(samples));
+    NetworkAdpcmState state;
+    network_adpcm_state_reset(&state);
+
+    uint8_t packet[512];
+    size_t needed = network_adpcm_encoded_size(TEST_FRAME_COUNT, 1);
+    TEST_CHECK(network_adpcm_encode(&state, 1, samples, TEST_FRAME_COUNT, packet, needed - 1) == 0);
+
+    size_t written = network_adpcm_encode(&state, 1, samples, TEST_FRAME_COUNT, packet, sizeof(packet));
+    TEST_CHECK(written == needed);
+    TEST_CHECK(network_adpcm_decode(&state, 1, packet, written - 1, TEST_FRAME_COUNT, samples, TEST_FRAME_COUNT) == 0);
+    TEST_CHECK(network_adpcm_decode(&state, 1, packet, written, TEST_FRAME_COUNT, samples, TEST_FRAME_COUNT - 1) == 0);
+}
+
+int main(void)
+{
+    test_snr();
+    test_frame_independence();
+    test_short_buffers();
+    return test_result("adpcm");
+}
@@ -0,0 +1,213 @@
+#include "engine/network.h"
+#include "engine/network_bitpack.h"
+#include "engine/player.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "test_common.h"
+
+#define TEST_PI 3.14159265358979323846
+
+static void test_bit_round_trip(void)
+{
+    static const unsigned widths[] = {1, 3, 8, 13, 32, 7, 16, 24, 2, 31};
+    uint8_t buffer[32];
+    NetworkBitWriter writer;
+    network_bit_writer_init(&writer, buffer, sizeof(buffer));
+
+    uint32_t values[sizeof(widths) / sizeof(widths[0])];
+    unsigned total_bits = 0;
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i) {
+        uint32_t mask = widths[i] == 32U ? 0xFFFFFFFFU : ((1U << widths[i]) - 1U);
+        values[i] = (0x9E3779B9U * (uint32_t)(i + 1U)) & mask;
+        network_bit_write(&writer, values[i], widths[i]);
+        total_bits += widths[i];
+    }
+    TEST_CHECK(!writer.overflow);
+    TEST_CHECK(network_bit_writer_bytes(&writer) == (total_bits + 7U) / 8U);
+
+    NetworkBitReader reader;
+    network_bit_reader_init(&reader, buffer, network_bit_writer_bytes(&writer));
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i) {
+        TEST_CHECK(network_bit_read(&reader, widths[i]) == values[i]);
+    }
+    TEST_CHECK(!reader.overflow);
+}
+
+static void test_bit_overflow(void)
+{
+    uint8_t buffer[2];
+    NetworkBitWriter writer;
+    network_bit_writer_init(&writer, buffer, sizeof(buffer));
+    network_bit_write(&writer, 0xABCU, 12);
+    TEST_CHECK(!writer.overflow);
+
+    /* 12 + 5 bits do not fit in two bytes: nothing is written */
+    network_bit_write(&writer, 0x1FU, 5);
+    TEST_CHECK(writer.overflow);
+    TEST_CHECK(writer.bit_position == 12U);
+    network_bit_write(&writer, 0xFU, 4);
+    TEST_CHECK(writer.bit_position == 16U);
+
+    NetworkBitReader reader;
+    network_bit_reader_init(&reader, buffer, sizeof(buffer));
+    TEST_CHECK(network_bit_read(&reader, 12) == 0xABCU);
+    TEST_CHECK(network_bit_read(&reader, 4) == 0xFU);
+    TEST_CHECK(!reader.overflow);
+
+    /* reading past the end flags the reader and keeps returning 0 */
+    TEST_CHECK(network_bit_read(&reader, 1) == 0U);
+    TEST_CHECK(reader.overflow);
+    TEST_CHECK(network_bit_read(&reader, 8) == 0U);
+
+    NetworkBitReader empty;
+    network_bit_reader_init(&empty, NULL, 16);
+    TEST_CHECK(network_bit_read(&empty, 1) == 0U);
+    TEST_CHECK(empty.overflow);
+}
+
+static void test_quantization_bounds(void)
+{
+    NetworkQuantization quant;
+    network_quantization_default(&quant);
+    TEST_CHECK(network_quantization_valid(&quant));
+
+    for (int axis = 0; axis < 3; ++axis) {
+        uint32_t max_value = (1U << quant.position_bits[axis]) - 1U;
+        float step = network_quantization_position_step(&quant, axis);
+        TEST_CHECK(step > 0.0f);
+
+        /* the bounds map to the ends of the range, and beyond them clamp */
+        TEST_CHECK(network_quantize_position(&quant, axis, quant.world_min[axis]) == 0U);
+        TEST_CHECK(network_quantize_position(&quant, axis, quant.world_min[axis] - 100.0f) == 0U);
+        TEST_CHECK(network_quantize_position(&quant, axis, quant.world_max[axis]) == max_value);
+        TEST_CHECK(network_quantize_position(&quant, axis, quant.world_max[axis] + 100.0f) == max_value);
+        TEST_CHECK(network_quantize_position(&quant, axis, NAN) == 0U);
+        TEST_CHECK(network_dequantize_position(&quant, axis, 0U) == quant.world_min[axis]);
+        TEST_CHECK_NEAR(network_dequantize_position(&quant, axis, max_value), quant.world_max[axis], 1e-3);
+        TEST_CHECK(network_dequantize_position(&quant, axis, max_value + 5U) ==
+                   network_dequantize_position(&quant, axis, max_value));
+
+        /* inside the range the round trip is within half a step (plus float
+         * rounding at these magnitudes) */
+        for (int i = 0; i <= 1000; ++i) {
+            float value = quant.world_min[axis] + (quant.world_max[axis] - quant.world_min[axis]) * ((float)i / 1000.0f);
+            float decoded = network_dequantize_position(&quant, axis, network_quantize_position(&quant, axis, value));
+            TEST_CHECK_NEAR(decoded, value, step * 0.5f + 1e-4f);
+        }
+    }
+
+    float position[3] = {12.345f, 1.7f, -250.5f};
+    float decoded[3];
+    uint8_t buffer[16];
+    NetworkBitWriter writer;
+    network_bit_writer_init(&writer, buffer, sizeof(buffer));
+    network_bit_write_position(&writer, &quant, position);
+    NetworkBitReader reader;
+    network_bit_reader_init(&reader, buffer, network_bit_writer_bytes(&writer));
+    network_bit_read_position(&reader, &quant, decoded);
+    for (int axis = 0; axis < 3; ++axis) {
+        TEST_CHECK_NEAR(decoded[axis], position[axis], network_quantization_position_step(&quant, axis));
+    }
+
+    uint8_t wire[NETWORK_QUANTIZATION_WIRE_SIZE];
+    NetworkQuantization parsed;
+    TEST_CHECK(network_quantization_write(&quant, wire, sizeof(wire)) == NETWORK_QUANTIZATION_WIRE_SIZE);
+    TEST_CHECK(network_quantization_read(&parsed, wire, sizeof(wire)));
+    TEST_CHECK(memcmp(&parsed, &quant, sizeof(quant)) == 0);
+    TEST_CHECK(!network_quantization_read(&parsed, wire, sizeof(wire) - 1U));
+
+    NetworkQuantization invalid = quant;
+    invalid.position_bits[1] = 0;
+    TEST_CHECK(!network_quantization_valid(&invalid));
+    invalid = quant;
+    invalid.position_bits[0] = 25;
+    TEST_CHECK(!network_quantization_valid(&invalid));
+    invalid = quant;
+    invalid.world_max[2] = invalid.world_min[2];
+    TEST_CHECK(!network_quantization_valid(&invalid));
+    invalid = quant;
+    invalid.yaw_bits = 17;
+    TEST_CHECK(!network_quantization_valid(&invalid));
+}
+
+/* A replicated position lands within PLAYER_COLLISION_EPSILON of the
+ * simulated one anywhere in the default world, so a client resolving
+ * collisions from it agrees with the server. The worst case is a value
+ * halfway between two steps; a bit budget too coarse for that fails here. */
+static void test_quantization_epsilon(void)
+{
+    NetworkQuantization quant;
+    network_quantization_default(&quant);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        float step = network_quantization_position_step(&quant, axis);
+        uint32_t max_value = (1U << quant.position_bits[axis]) - 1U;
+        float worst = 0.0f;
+        for (uint32_t i = 0; i < 4096U; ++i) {
+            uint32_t q = (uint32_t)(((uint64_t)i * max_value) / 4096U);
+            float base = network_dequantize_position(&quant, axis, q);
+            const float offsets[] = {0.0f, step * 0.25f, step * 0.5f, step * 0.75f};
+            for (size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); ++o) {
+                float value = base + offsets[o];
+                float decoded = network_dequantize_position(&quant, axis, network_quantize_position(&quant, axis, value));
+                float error = fabsf(decoded - value);
+                worst = error > worst ? error : worst;
+                TEST_CHECK(error < PLAYER_COLLISION_EPSILON);
+            }
+        }
+        printf("[bitpack] axis %d: step %.3f mm, worst round trip %.3f mm (epsilon %.3f mm)\n",
+               axis,
+               step * 1000.0f,
+               worst * 1000.0f,
+               PLAYER_COLLISION_EPSILON * 1000.0f);
+    }
+}
+
+static void test_yaw_wrap(void)
+{
+    NetworkQuantization quant;
+    network_quantization_default(&quant);
+    const uint32_t steps = 1U << quant.yaw_bits;
+    const double step = 2.0 * TEST_PI / (double)steps;
+
+    TEST_CHECK(network_quantize_yaw(&quant, 0.0f) == 0U);
+    TEST_CHECK(network_quantize_yaw(&quant, (float)(2.0 * TEST_PI)) == 0U);
+    /* just below a full turn rounds up to the turn and wraps to 0 */
+    TEST_CHECK(network_quantize_yaw(&quant, (float)(2.0 * TEST_PI - step * 0.25)) == 0U);
+    TEST_CHECK(network_quantize_yaw(&quant, (float)(-step)) == steps - 1U);
+    TEST_CHECK(network_quantize_yaw(&quant, (float)(7.0 * TEST_PI)) == steps / 2U);
+    TEST_CHECK(network_quantize_yaw(&quant, (float)(-TEST_PI / 2.0)) == steps * 3U / 4U);
+    TEST_CHECK(network_quantize_yaw(&quant, NAN) == 0U);
+    TEST_CHECK(network_quantize_yaw(&quant, INFINITY) == 0U);
+
+    for (int i = -720; i <= 720; ++i) {
+        double yaw = (double)i * TEST_PI / 180.0;
+        float decoded = network_dequantize_yaw(&quant, network_quantize_yaw(&quant, (float)yaw));
+        TEST_CHECK(decoded >= 0.0f && decoded < (float)(2.0 * TEST_PI));
+
+        double expected = fmod(yaw, 2.0 * TEST_PI);
+        if (expected < 0.0) {
+            expected += 2.0 * TEST_PI;
+        }
+        double error = fabs((double)decoded - expected);
+        if (error > TEST_PI) {
+            error = 2.0 * TEST_PI - error;
+        }
+        TEST_CHECK(error <= step * 0.5 + 1e-5);
+    }
+
+    TEST_CHECK(network_dequantize_yaw(&quant, steps) == 0.0f);
+}
+
+int main(void)
+{
+    test_bit_round_trip();
+    test_bit_overflow();
+    test_quantization_bounds();
+    test_quantization_epsilon();
+    test_yaw_wrap();
+    return test_result("bitpack");
+}
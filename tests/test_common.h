@@ -0,0 +1,29 @@
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+
+/* Minimal checks for the unit tests: a failed check is reported and counted,
+ * and the test returns test_result() from main so ctest sees the failure. */
+static int g_test_failures = 0;
+
+#define TEST_CHECK(condition)                                                         \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++g_test_failures;                                                        \
+        }                                                                             \
+    } while (0)
+
+#define TEST_CHECK_NEAR(actual, expected, tolerance) \
+    TEST_CHECK(fabs((double)(actual) - (double)(expected)) <= (double)(tolerance))
+
+static int test_result(const char *name)
+{
+    if (g_test_failures > 0) {
+        fprintf(stderr, "[%s] %d check(s) failed\n", name, g_test_failures);
+        return 1;
+    }
+    printf("[%s] ok\n", name);
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "enet.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "test_common.h"
+
+/* Reliable delivery through the enet stub's network simulator: both ends
+ * drop, duplicate and reorder datagrams, and every reliable packet must
+ * still arrive exactly once, the ordered ones in the order they were sent. */
+
+#define TEST_PORT 26950
+#define TEST_ORDERED 400U
+#define TEST_UNSEQUENCED 400U
+/* every TEST_LARGE_EVERY-th ordered packet is large enough to be fragmented */
+#define TEST_LARGE_EVERY 40U
+#define TEST_LARGE_SIZE 3000U
+#define TEST_SMALL_SIZE 32U
+/* service rounds of up to 1 ms each */
+#define TEST_TIMEOUT_ROUNDS 30000U
+/* rounds kept running after delivery, so late duplicates would show up */
+#define TEST_SETTLE_ROUNDS 300U
+
+#define TEST_TAG_ORDERED 0x4FU
+#define TEST_TAG_UNSEQUENCED 0x55U
+
+typedef struct TestReceiver {
+    uint32_t next_ordered;
+    uint32_t ordered_out_of_order;
+    uint32_t unsequenced_seen[TEST_UNSEQUENCED];
+    uint32_t corrupt;
+} TestReceiver;
+
+static size_t test_packet_size(uint8_t tag, uint32_t index)
+{
+    return (tag == TEST_TAG_ORDERED && index % TEST_LARGE_EVERY == 0U) ? TEST_LARGE_SIZE : TEST_SMALL_SIZE;
+}
+
+/* [tag][index u32] then bytes derived from both, so a packet reassembled
+ * from the wrong fragments or delivered twice is caught */
+static void test_fill_packet(uint8_t *data, size_t size, uint8_t tag, uint32_t index)
+{
+    data[0] = tag;
+    memcpy(data + 1, &index, sizeof(index));
+    for (size_t i = 5; i < size; ++i) {
+        data[i] = (uint8_t)(index * 31U + i * 7U + tag);
+    }
+}
+
+static void test_receive(TestReceiver *receiver, const ENetPacket *packet)
+{
+    if (packet->dataLength < 5) {
+        receiver->corrupt += 1;
+        return;
+    }
+
+    uint8_t tag = packet->data[0];
+    uint32_t index = 0;
+    memcpy(&index, packet->data + 1, sizeof(index));
+    if ((tag != TEST_TAG_ORDERED && tag != TEST_TAG_UNSEQUENCED) ||
+        index >= (tag == TEST_TAG_ORDERED ? TEST_ORDERED : TEST_UNSEQUENCED) ||
+        packet->dataLength != test_packet_size(tag, index)) {
+        receiver->corrupt += 1;
+        return;
+    }
+
+    uint8_t expected[TEST_LARGE_SIZE];
+    test_fill_packet(expected, packet->dataLength, tag, index);
+    if (memcmp(expected, packet->data, packet->dataLength) != 0) {
+        receiver->corrupt += 1;
+        return;
+    }
+
+    if (tag == TEST_TAG_ORDERED) {
+        if (index != receiver->next_ordered) {
+            receiver->ordered_out_of_order += 1;
+        }
+        receiver->next_ordered = index + 1U;
+    } else {
+        receiver->unsequenced_seen[index] += 1;
+    }
+}
+
+static int test_unsequenced_complete(const TestReceiver *receiver)
+{
+    for (uint32_t i = 0; i < TEST_UNSEQUENCED; ++i) {
+        if (receiver->unsequenced_seen[i] == 0U) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Pumps both hosts until the client's connection is up on both ends and
+ * returns the server's peer for it. */
+static ENetPeer *test_connect(ENetHost *server, ENetHost *client, ENetPeer *client_peer)
+{
+    ENetPeer *server_peer = NULL;
+    int client_connected = 0;
+    for (uint32_t round = 0; round < TEST_TIMEOUT_ROUNDS && (!server_peer || !client_connected); ++round) {
+        ENetEvent event;
+        while (enet_host_service(server, &event, 0) > 0) {
+            if (event.type == ENET_EVENT_TYPE_CONNECT) {
+                server_peer = event.peer;
+            }
+        }
+        while (enet_host_service(client, &event, 1) > 0) {
+            if (event.type == ENET_EVENT_TYPE_CONNECT && event.peer == client_peer) {
+                client_connected = 1;
+            }
+        }
+    }
+    return client_connected ? server_peer : NULL;
+}
+
+static void test_reliable_through_loss(void)
+{
+    ENetAddress address;
+    address.host = 0;
+    address.port = TEST_PORT;
+    ENetHost *server = enet_host_create(&address, 1, 1, 0, 0);
+    ENetHost *client = enet_host_create(NULL, 1, 1, 0, 0);
+    TEST_CHECK(server != NULL);
+    TEST_CHECK(client != NULL);
+    if (!server || !client) {
+        enet_host_destroy(client);
+        enet_host_destroy(server);
+        return;
+    }
+
+    address.host = 0x7F000001u;
+    ENetPeer *client_peer = enet_host_connect(client, &address, 1, 0);
+    TEST_CHECK(client_peer != NULL);
+    ENetPeer *server_peer = client_peer ? test_connect(server, client, client_peer) : NULL;
+    TEST_CHECK(server_peer != NULL);
+    if (!server_peer) {
+        enet_host_destroy(client);
+        enet_host_destroy(server);
+        return;
+    }
+
+    /* shape both directions so acks are lost and reordered too */
+    ENetSimulatorSettings settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.latencyMs = 10.0f;
+    settings.jitterMs = 5.0f;
+    settings.loss = 0.2f;
+    settings.lossBurst = 2.0f;
+    settings.duplicate = 0.05f;
+    settings.reorder = 0.1f;
+    settings.seed = 1986;
+    TEST_CHECK(enet_host_simulate(client, &settings) == 0);
+    settings.seed = 6891;
+    TEST_CHECK(enet_host_simulate(server, &settings) == 0);
+
+    TestReceiver receiver;
+    memset(&receiver, 0, sizeof(receiver));
+    uint32_t sent_ordered = 0;
+    uint32_t sent_unsequenced = 0;
+    uint8_t payload[TEST_LARGE_SIZE];
+
+    uint32_t rounds = 0;
+    uint32_t settle = 0;
+    for (; rounds < TEST_TIMEOUT_ROUNDS && settle < TEST_SETTLE_ROUNDS; ++rounds) {
+        /* interleave both streams; a full send queue is retried next round */
+        while (sent_ordered < TEST_ORDERED || sent_unsequenced < TEST_UNSEQUENCED) {
+            int unsequenced = sent_unsequenced < sent_ordered || sent_ordered == TEST_ORDERED;
+            uint8_t tag = unsequenced ? TEST_TAG_UNSEQUENCED : TEST_TAG_ORDERED;
+            uint32_t index = unsequenced ? sent_unsequenced : sent_ordered;
+            size_t size = test_packet_size(tag, index);
+            test_fill_packet(payload, size, tag, index);
+
+            enet_uint32 flags = ENET_PACKET_FLAG_RELIABLE | (unsequenced ? ENET_PACKET_FLAG_UNSEQUENCED : 0U);
+            ENetPacket *packet = enet_packet_create(payload, size, flags);
+            if (!packet || enet_peer_send(client_peer, 0, packet) != 0) {
+                enet_packet_destroy(packet);
+                break;
+            }
+            if (unsequenced) {
+                ++sent_unsequenced;
+            } else {
+                ++sent_ordered;
+            }
+        }
+
+        ENetEvent event;
+        while (enet_host_service(client, &event, 0) > 0) {
+            if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                enet_packet_destroy(event.packet);
+            }
+        }
+        while (enet_host_service(server, &event, 1) > 0) {
+            if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                test_receive(&receiver, event.packet);
+                enet_packet_destroy(event.packet);
+            }
+        }
+
+        if (settle > 0U || (receiver.next_ordered == TEST_ORDERED && test_unsequenced_complete(&receiver))) {
+            ++settle;
+        }
+    }
+
+    ENetSimulatorStats client_stats;
+    enet_host_simulator_stats(client, &client_stats);
+    printf("[reliable] %u ordered and %u unsequenced packets in %u service rounds, %llu of %llu client datagrams dropped\n",
+           TEST_ORDERED,
+           TEST_UNSEQUENCED,
+           rounds - settle,
+           (unsigned long long)client_stats.dropped,
+           (unsigned long long)client_stats.datagrams);
+
+    /* the loss actually happened, and was recovered from */
+    TEST_CHECK(client_stats.dropped > 0U);
+    TEST_CHECK(client_stats.duplicated > 0U);
+    TEST_CHECK(receiver.corrupt == 0U);
+    TEST_CHECK(settle == TEST_SETTLE_ROUNDS);
+    TEST_CHECK(receiver.next_ordered == TEST_ORDERED);
+    TEST_CHECK(receiver.ordered_out_of_order == 0U);
+    uint32_t missing = 0;
+    uint32_t duplicated = 0;
+    for (uint32_t i = 0; i < TEST_UNSEQUENCED; ++i) {
+        missing += receiver.unsequenced_seen[i] == 0U ? 1U : 0U;
+        duplicated += receiver.unsequenced_seen[i] > 1U ? 1U : 0U;
+    }
+    TEST_CHECK(missing == 0U);
+    TEST_CHECK(duplicated == 0U);
+
+    enet_host_destroy(client);
+    enet_host_destroy(server);
+}
+
+int main(void)
+{
+    if (enet_initialize() != 0) {
+        fprintf(stderr, "[reliable] enet_initialize failed\n");
+        return 1;
+    }
+    test_reliable_through_loss();
+    enet_deinitialize();
+    return test_result("reliable");
+}